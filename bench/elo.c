@@ -0,0 +1,162 @@
+/*
+ * Rate random games with ELO_ENGINE, and with the classic per pair Elo
+ * formula it replaces.  Both must agree on every single game, then the
+ * time each one took is reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "elo.h"
+#include "delta.h"
+
+#define K 25
+
+struct game {
+	unsigned length;
+	int elos[MAX_PLAYERS];
+	long deltas[MAX_PLAYERS];
+	int rankable[MAX_PLAYERS];
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Same generator on every platform, so that runs can be compared */
+static unsigned long seed = 1;
+
+static unsigned long next_random(void)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) & 0x7fffffff;
+}
+
+static void random_game(struct game *game)
+{
+	unsigned i;
+
+	game->length = 2 + next_random() % (MAX_PLAYERS - 1);
+	for (i = 0; i < game->length; i++) {
+		game->elos[i] = 900 + next_random() % 1200;
+		game->deltas[i] = next_random() % 8;
+		game->rankable[i] = next_random() % 10 != 0;
+	}
+}
+
+static double p(double delta)
+{
+	if (delta > 400.0)
+		delta = 400.0;
+	else if (delta < -400.0)
+		delta = -400.0;
+
+	return 1.0 / (1.0 + pow(10.0, -delta / 400.0));
+}
+
+/* Elos as computed before the table kernel */
+static void reference_rate_game(const struct game *game, int new_elos[])
+{
+	unsigned i, j;
+
+	for (i = 0; i < game->length; i++) {
+		int total = 0;
+
+		new_elos[i] = game->elos[i];
+		if (!game->rankable[i])
+			continue;
+
+		for (j = 0; j < game->length; j++) {
+			double W;
+
+			if (j == i || !game->rankable[j])
+				continue;
+
+			if (game->deltas[i] < game->deltas[j])
+				W = 0.0;
+			else if (game->deltas[i] == game->deltas[j])
+				W = 0.5;
+			else
+				W = 1.0;
+
+			total += (int)(K * (W - p(game->elos[i] - game->elos[j])));
+		}
+
+		new_elos[i] += total / (int)game->length;
+	}
+}
+
+static void engine_rate_game(const struct game *game, int new_elos[])
+{
+	void *ratings[MAX_PLAYERS];
+	unsigned i;
+
+	for (i = 0; i < game->length; i++) {
+		new_elos[i] = game->elos[i];
+		ratings[i] = &new_elos[i];
+	}
+
+	ELO_ENGINE.rate_game(&ELO_ENGINE, game->length, ratings, game->deltas, game->rankable);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long ngames = 1000000, i;
+	struct game *games;
+	int expected[MAX_PLAYERS], got[MAX_PLAYERS];
+	double start, reference, engine;
+	long checksum = 0;
+	unsigned j;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [<number of games>]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 2)
+		ngames = strtoul(argv[1], NULL, 10);
+
+	if (!(games = malloc(ngames * sizeof(*games))))
+		return perror("malloc(games)"), EXIT_FAILURE;
+	for (i = 0; i < ngames; i++)
+		random_game(&games[i]);
+
+	for (i = 0; i < ngames; i++) {
+		reference_rate_game(&games[i], expected);
+		engine_rate_game(&games[i], got);
+
+		for (j = 0; j < games[i].length; j++) {
+			if (expected[j] != got[j]) {
+				fprintf(stderr, "Game %lu, player %u: expected %d, got %d\n",
+				        i, j, expected[j], got[j]);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	start = now();
+	for (i = 0; i < ngames; i++) {
+		reference_rate_game(&games[i], expected);
+		checksum += expected[0];
+	}
+	reference = now() - start;
+
+	start = now();
+	for (i = 0; i < ngames; i++) {
+		engine_rate_game(&games[i], got);
+		checksum -= got[0];
+	}
+	engine = now() - start;
+
+	printf("%lu games, same elos (checksum %ld)\n", ngames, checksum);
+	printf("%-10s %10.0f games/s\n", "reference", ngames / reference);
+	printf("%-10s %10.0f games/s\n", ELO_ENGINE.name, ngames / engine);
+
+	free(games);
+	return EXIT_SUCCESS;
+}
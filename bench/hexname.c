@@ -0,0 +1,92 @@
+/*
+ * Encode random names to hexnames and decode them back, and report the
+ * time each conversion took.  Built as bench/hexname and
+ * bench/hexname-table, so that SSE2 and lookup tables conversions can
+ * be compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hexname.h"
+
+#define NNAMES 4096
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Same generator on every platform, so that runs can be compared */
+static unsigned long seed = 1;
+
+static unsigned long next_random(void)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) & 0x7fffffff;
+}
+
+/* Names of 1 to 15 printable characters, as most names are */
+static void random_name(char *name)
+{
+	unsigned len, i;
+
+	len = 1 + next_random() % (NAME_LENGTH - 2);
+	for (i = 0; i < len; i++)
+		name[i] = ' ' + next_random() % ('~' - ' ' + 1);
+	name[len] = '\0';
+}
+
+static char names[NNAMES][NAME_LENGTH];
+static char hexnames[NNAMES][HEXNAME_LENGTH];
+
+int main(int argc, char **argv)
+{
+	unsigned long nloops = 1000, i, checksum = 0;
+	char name[NAME_LENGTH];
+	double start, encode, decode;
+	unsigned j;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [<number of loops>]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (argc == 2)
+		nloops = strtoul(argv[1], NULL, 10);
+
+	for (j = 0; j < NNAMES; j++)
+		random_name(names[j]);
+
+	start = now();
+	for (i = 0; i < nloops; i++)
+		for (j = 0; j < NNAMES; j++)
+			name_to_hexname(names[j], hexnames[j]);
+	encode = now() - start;
+
+	start = now();
+	for (i = 0; i < nloops; i++) {
+		for (j = 0; j < NNAMES; j++) {
+			if (!decode_hexname(hexnames[j], name))
+				return fprintf(stderr, "%s: Cannot decode\n", hexnames[j]), EXIT_FAILURE;
+			checksum += (unsigned char)name[0];
+		}
+	}
+	decode = now() - start;
+
+	for (j = 0; j < NNAMES; j++) {
+		hexname_to_name(hexnames[j], name);
+		if (strcmp(name, names[j]) != 0)
+			return fprintf(stderr, "%s: Wrong round trip\n", names[j]), EXIT_FAILURE;
+	}
+
+	printf("%lu conversions, checksum %lu\n", nloops * NNAMES, checksum);
+	printf("encode %8.1f ns per name\n", encode * 1e9 / (nloops * NNAMES));
+	printf("decode %8.1f ns per name\n", decode * 1e9 / (nloops * NNAMES));
+
+	return EXIT_SUCCESS;
+}
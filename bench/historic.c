@@ -0,0 +1,182 @@
+/*
+ * Write players with long historics to the database, then read them
+ * back, and report the size of player files and the time it took.
+ * Only the player interface is used, so that the same benchmark can be
+ * built against older historic formats.  Files of the database are all
+ * expected to be player files.
+ *
+ * Run it on an empty database:
+ *
+ *	TEERANK_ROOT=$(mktemp -d) sh -c 'teerank-init && bench/historic'
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "player.h"
+#include "historic.h"
+
+#define NPLAYERS 200
+
+/* Five days of updates, every five minutes */
+#define NRECORDS 1440
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long seed = 1;
+
+static unsigned long next_random(void)
+{
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) & 0x7fffffff;
+}
+
+static char *get_name(unsigned i)
+{
+	static char hex[HEXNAME_LENGTH];
+	char name[NAME_LENGTH];
+
+	sprintf(name, "bench%u", i);
+	name_to_hexname(name, hex);
+	return hex;
+}
+
+/*
+ * New players already have a record at the current time, so records
+ * are appended after it, as updates would do.
+ */
+static int create_players(struct player *player)
+{
+	struct player_record rec;
+	time_t t = time(NULL);
+	int elo = 1500, rank = 1000;
+	unsigned i, j;
+
+	for (i = 0; i < NPLAYERS; i++) {
+		create_player(player, get_name(i));
+
+		for (j = 1; j <= NRECORDS; j++) {
+			elo += (int)(next_random() % 41) - 20;
+			rank += (int)(next_random() % 21) - 10;
+			if (rank < 1)
+				rank = 1;
+
+			init_player_record(&rec, elo, rank);
+			if (!append_record_at(&player->hist, &rec, t + j * 300))
+				return 0;
+		}
+
+		player->elo = elo;
+		player->rank = rank;
+		if (!write_player(player))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int read_players(struct player *player)
+{
+	unsigned i;
+
+	for (i = 0; i < NPLAYERS; i++) {
+		if (read_player(player, get_name(i)) != PLAYER_FOUND)
+			return 0;
+		if (!load_historic(&player->hist))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int read_summaries(void)
+{
+	struct player_summary ps;
+	unsigned i;
+
+	for (i = 0; i < NPLAYERS; i++)
+		if (read_player_summary(&ps, get_name(i)) != PLAYER_FOUND)
+			return 0;
+
+	return 1;
+}
+
+/* Total size of files in the given directory and its subdirectories */
+static unsigned long get_files_size(const char *path)
+{
+	char subpath[1024];
+	unsigned long size = 0;
+	struct dirent *dp;
+	struct stat st;
+	DIR *dir;
+
+	if (!(dir = opendir(path)))
+		return 0;
+
+	while ((dp = readdir(dir))) {
+		if (dp->d_name[0] == '.')
+			continue;
+
+		snprintf(subpath, sizeof(subpath), "%s/%s", path, dp->d_name);
+		if (stat(subpath, &st) == -1)
+			continue;
+
+		if (S_ISDIR(st.st_mode))
+			size += get_files_size(subpath);
+		else
+			size += st.st_size;
+	}
+
+	closedir(dir);
+	return size;
+}
+
+int main(int argc, char **argv)
+{
+	static struct player player;
+	double start, write, read, summary;
+	char path[1024];
+
+	load_config(1);
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	init_player(&player);
+
+	start = now();
+	if (!create_players(&player))
+		return EXIT_FAILURE;
+	write = now() - start;
+
+	start = now();
+	if (!read_players(&player))
+		return EXIT_FAILURE;
+	read = now() - start;
+
+	start = now();
+	if (!read_summaries())
+		return EXIT_FAILURE;
+	summary = now() - start;
+
+	snprintf(path, sizeof(path), "%s/players", config.root);
+	printf("%u players of %u records, %lu bytes per player\n",
+	       NPLAYERS, NRECORDS, get_files_size(path) / NPLAYERS);
+	printf("write    %8.1f us per player\n", write * 1e6 / NPLAYERS);
+	printf("read     %8.1f us per player\n", read * 1e6 / NPLAYERS);
+	printf("summary  %8.1f us per player\n", summary * 1e6 / NPLAYERS);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+/*
+ * Request the same page again and again from concurrent clients, and
+ * report the throughput and latencies.  Pages are requested either
+ * from teerank-httpd listening on the given port, each client keeping
+ * its connection alive, or from teerank.cgi spawned for every request.
+ *
+ *	teerank-httpd 8000 &
+ *	bench/load 8000 /pages/1.html 4 10000
+ *	PATH=.:$PATH bench/load cgi /pages/1.html 4 1000
+ *
+ * Clients are processes, sending their latencies back through a pipe.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define MAX_RESPONSE_SIZE (1 << 20)
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_to(long port)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		return perror("socket()"), -1;
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+		perror("connect()");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static long get_content_length(const char *headers)
+{
+	const char *line;
+
+	for (line = headers; (line = strstr(line, "\r\n")); ) {
+		line += 2;
+		if (!strncasecmp(line, "Content-Length:", 15))
+			return atol(line + 15);
+	}
+
+	return -1;
+}
+
+/* Send the request and read the whole response */
+static int request_page(int fd, const char *request)
+{
+	static char buf[MAX_RESPONSE_SIZE + 1];
+	size_t len = 0, request_len = strlen(request);
+	long content_length = -1;
+	char *end = NULL;
+	ssize_t ret;
+
+	if (write(fd, request, request_len) != (ssize_t)request_len)
+		return perror("write()"), 0;
+
+	while (!end || len < (size_t)(end - buf) + 4 + content_length) {
+		if (len == MAX_RESPONSE_SIZE)
+			return fprintf(stderr, "Response too big\n"), 0;
+
+		if ((ret = read(fd, buf + len, MAX_RESPONSE_SIZE - len)) == -1)
+			return perror("read()"), 0;
+		else if (ret == 0)
+			return fprintf(stderr, "Connection closed\n"), 0;
+
+		len += ret;
+		buf[len] = '\0';
+
+		if (!end && (end = strstr(buf, "\r\n\r\n"))) {
+			if (strncmp(buf, "HTTP/1.1 200", 12) != 0)
+				return fprintf(stderr, "%.*s\n", (int)(strchr(buf, '\r') - buf), buf), 0;
+			if ((content_length = get_content_length(buf)) == -1)
+				return fprintf(stderr, "No Content-Length\n"), 0;
+		}
+	}
+
+	return 1;
+}
+
+static int spawn_cgi(const char *path)
+{
+	int status, fd;
+	pid_t pid;
+
+	if ((pid = fork()) == -1)
+		return perror("fork()"), 0;
+
+	if (pid == 0) {
+		if ((fd = open("/dev/null", O_WRONLY)) == -1 || dup2(fd, STDOUT_FILENO) == -1)
+			_exit(EXIT_FAILURE);
+		setenv("DOCUMENT_URI", path, 1);
+		setenv("QUERY_STRING", "", 1);
+		setenv("SERVER_NAME", "localhost", 1);
+		execlp("teerank.cgi", "teerank.cgi", (char*)NULL);
+		perror("teerank.cgi");
+		_exit(EXIT_FAILURE);
+	}
+
+	if (waitpid(pid, &status, 0) == -1)
+		return perror("waitpid()"), 0;
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/* Make the given number of requests, writing each latency to "out" */
+static int client(long port, const char *path, unsigned long nrequests, int out)
+{
+	char request[1024];
+	double start, latency;
+	unsigned long i;
+	int fd = -1;
+
+	snprintf(request, sizeof(request),
+	         "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+
+	if (port && (fd = connect_to(port)) == -1)
+		return 0;
+
+	for (i = 0; i < nrequests; i++) {
+		start = now();
+		if (port && !request_page(fd, request))
+			return 0;
+		if (!port && !spawn_cgi(path))
+			return 0;
+		latency = now() - start;
+
+		if (write(out, &latency, sizeof(latency)) != sizeof(latency))
+			return perror("write(pipe)"), 0;
+	}
+
+	return 1;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long nclients = 4, nrequests = 1000, n, i;
+	double start, elapsed, *latencies;
+	int fds[2], status, ret = EXIT_SUCCESS;
+	char *end;
+	long port = 0;
+	ssize_t r;
+
+	if (argc < 3 || argc > 5) {
+		fprintf(stderr, "usage: %s <port>|cgi <path> [<clients> [<requests per client>]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (strcmp(argv[1], "cgi") != 0) {
+		port = strtol(argv[1], &end, 10);
+		if (*end || port <= 0 || port > 65535) {
+			fprintf(stderr, "%s: Invalid port\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc > 3)
+		nclients = strtoul(argv[3], NULL, 10);
+	if (argc > 4)
+		nrequests = strtoul(argv[4], NULL, 10);
+
+	n = nclients * nrequests;
+	if (n == 0)
+		return EXIT_SUCCESS;
+	if (!(latencies = malloc(n * sizeof(*latencies))))
+		return perror("malloc(latencies)"), EXIT_FAILURE;
+	if (pipe(fds) == -1)
+		return perror("pipe()"), EXIT_FAILURE;
+
+	start = now();
+	for (i = 0; i < nclients; i++) {
+		pid_t pid;
+
+		if ((pid = fork()) == -1)
+			return perror("fork()"), EXIT_FAILURE;
+		if (pid == 0) {
+			close(fds[0]);
+			_exit(client(port, argv[2], nrequests, fds[1]) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	close(fds[1]);
+
+	/* Latencies are written atomically, being smaller than PIPE_BUF */
+	for (i = 0; i < n; i++) {
+		do
+			r = read(fds[0], &latencies[i], sizeof(*latencies));
+		while (r == -1 && errno == EINTR);
+
+		if (r != sizeof(*latencies))
+			break;
+	}
+	elapsed = now() - start;
+
+	while (wait(&status) != -1)
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			ret = EXIT_FAILURE;
+
+	if (i != n) {
+		fprintf(stderr, "Only %lu requests over %lu succeeded\n", i, n);
+		return EXIT_FAILURE;
+	}
+
+	qsort(latencies, n, sizeof(*latencies), cmp_double);
+	printf("%s %s: %lu clients, %lu requests\n", argv[1], argv[2], nclients, n);
+	printf("%.0f req/s, p50 %.2fms, p90 %.2fms, p99 %.2fms\n",
+	       n / elapsed, latencies[n / 2] * 1e3,
+	       latencies[n * 9 / 10] * 1e3, latencies[n * 99 / 100] * 1e3);
+
+	free(latencies);
+	return ret;
+}
@@ -18,6 +18,7 @@
 #include "config.h"
 #include "network.h"
 #include "server.h"
+#include "commit.h"
 
 struct master {
 	char *node, *service;
@@ -230,5 +231,8 @@ int main(int argc, char **argv)
 	verbose("Over %u servers referenced by masters, %u are new\n",
 	        list.length, count_new);
 
+	if (!sync_commits())
+		return EXIT_FAILURE;
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,231 @@
+/*
+ * Stream every archived delta through several rating engines at once,
+ * entirely in memory, and report how well each engine predicted game
+ * outcomes.  The database is never modified, so rating changes can be
+ * evaluated anywhere a copy of the delta archive is available.
+ *
+ * Before rating a game, each engine predict the outcome of every pair
+ * of players with different score deltas.  Accuracy is the ratio of
+ * correctly predicted pairs, and the brier score is the mean squared
+ * error of the expected score (lower is better).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+#include "player.h"
+#include "delta.h"
+#include "elo.h"
+#include "rating.h"
+#include "archive.h"
+#include "dict.h"
+
+#define MAX_ENGINES 16
+
+struct backtest {
+	const struct rating_engine *engine;
+
+	/* Ratings of every players, indexed by their id */
+	char *ratings;
+
+	unsigned long npairs;
+	double correct;
+	double brier;
+
+	double elapsed;
+};
+
+static struct dict dict;
+static unsigned nplayers;
+
+static struct backtest backtests[MAX_ENGINES];
+static unsigned nbacktests;
+
+static void *get_rating(struct backtest *bt, unsigned id)
+{
+	return bt->ratings + id * bt->engine->rating_size;
+}
+
+/*
+ * Ratings buffers are grown along with the dictionary, so that they
+ * can always be indexed by player id.
+ */
+static unsigned get_player(const char *name)
+{
+	unsigned id, i;
+
+	if ((id = add_name(&dict, name)) == NO_ID)
+		exit(EXIT_FAILURE);
+	if (id < nplayers)
+		return id;
+
+	assert(id == nplayers);
+
+	for (i = 0; i < nbacktests; i++) {
+		struct backtest *bt = &backtests[i];
+
+		if (nplayers % 1024 == 0) {
+			size_t size = (nplayers + 1024) * bt->engine->rating_size;
+			char *tmp;
+
+			if (!(tmp = realloc(bt->ratings, size))) {
+				perror("realloc(ratings)");
+				exit(EXIT_FAILURE);
+			}
+			bt->ratings = tmp;
+		}
+
+		bt->engine->init_rating(bt->engine, get_rating(bt, id));
+	}
+
+	return nplayers++;
+}
+
+static void predict(
+	struct backtest *bt, struct delta *delta, void *ratings[])
+{
+	unsigned i, j;
+
+	for (i = 0; i < delta->length; i++) {
+		for (j = i + 1; j < delta->length; j++) {
+			double expected, actual;
+
+			if (delta->players[i].delta == delta->players[j].delta)
+				continue;
+
+			expected = bt->engine->expected_score(
+				bt->engine, ratings[i], ratings[j]);
+			actual = delta->players[i].delta > delta->players[j].delta;
+
+			if (expected == 0.5)
+				bt->correct += 0.5;
+			else if ((expected > 0.5) == (actual == 1.0))
+				bt->correct += 1.0;
+
+			bt->brier += (expected - actual) * (expected - actual);
+			bt->npairs++;
+		}
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int backtest_delta(struct delta *delta)
+{
+	unsigned ids[MAX_PLAYERS];
+	void *ratings[MAX_PLAYERS];
+	long deltas[MAX_PLAYERS] = { 0 };
+	int rankable[MAX_PLAYERS] = { 0 };
+	unsigned i, j;
+
+	for (i = 0; i < delta->length; i++) {
+		ids[i] = get_player(delta->players[i].name);
+		deltas[i] = delta->players[i].delta;
+		rankable[i] = 1;
+	}
+
+	if (!is_rankable_game(delta->elapsed, delta->length, delta->length))
+		return 0;
+
+	for (i = 0; i < nbacktests; i++) {
+		struct backtest *bt = &backtests[i];
+		double start;
+
+		for (j = 0; j < delta->length; j++)
+			ratings[j] = get_rating(bt, ids[j]);
+
+		predict(bt, delta, ratings);
+
+		start = now();
+		bt->engine->rate_game(bt->engine, delta->length, ratings, deltas, rankable);
+		bt->elapsed += now() - start;
+	}
+
+	return 1;
+}
+
+static void add_backtest(const char *name)
+{
+	const struct rating_engine *engine;
+
+	if (!(engine = get_rating_engine(name))) {
+		fprintf(stderr, "%s: Unknown rating engine\n", name);
+		exit(EXIT_FAILURE);
+	}
+
+	if (nbacktests == MAX_ENGINES) {
+		fprintf(stderr, "Cannot backtest more than %d engines\n", MAX_ENGINES);
+		exit(EXIT_FAILURE);
+	}
+
+	backtests[nbacktests++].engine = engine;
+}
+
+static void print_results(unsigned ngames)
+{
+	unsigned i;
+
+	printf("%u games, %u players\n\n", ngames, nplayers);
+	printf("%-16s %10s %10s %12s\n", "engine", "accuracy", "brier", "games/s");
+
+	for (i = 0; i < nbacktests; i++) {
+		struct backtest *bt = &backtests[i];
+		double accuracy = 0.0, brier = 0.0, throughput = 0.0;
+
+		if (bt->npairs) {
+			accuracy = bt->correct / bt->npairs;
+			brier = bt->brier / bt->npairs;
+		}
+		if (bt->elapsed > 0.0)
+			throughput = ngames / bt->elapsed;
+
+		printf("%-16s %10.4f %10.4f %12.0f\n",
+		       bt->engine->name, accuracy, brier, throughput);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct archive archive;
+	struct delta delta;
+	unsigned ngames = 0;
+	time_t time;
+	int i;
+
+	load_config(1);
+
+	if (argc == 1) {
+		const struct rating_engine **engine;
+
+		for (engine = RATING_ENGINES; *engine; engine++)
+			add_backtest((*engine)->name);
+	} else {
+		for (i = 1; i < argc; i++)
+			add_backtest(argv[i]);
+	}
+
+	if (!open_archive(&archive))
+		return EXIT_FAILURE;
+
+	init_dict(&dict);
+
+	while (next_archived_delta(&archive, &delta, &time))
+		if (delta.length && backtest_delta(&delta))
+			ngames++;
+
+	close_archive(&archive);
+
+	print_results(ngames);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+/*
+ * Aggregate old records of every player historics, so that historics
+ * don't grow forever.  Compaction loads whole historics, hence it is
+ * not done when updating players but is meant to be run once in a
+ * while, daily for instance.  Updates wait for it to be done.
+ *
+ * Players are compacted independently of each others, hence shards
+ * are walked by several processes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h"
+#include "player.h"
+
+struct compaction {
+	struct player player;
+	time_t now;
+};
+
+static int compact(const char *name, void *data)
+{
+	struct compaction *c = data;
+
+	if (read_player(&c->player, name) != PLAYER_FOUND)
+		return 1;
+
+	if (!compact_player(&c->player, c->now))
+		return 0;
+
+	if (c->player.is_modified & IS_MODIFIED_HISTORIC) {
+		if (!write_player(&c->player))
+			return 0;
+		verbose("Compacted %s\n", name);
+	}
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	static struct compaction c;
+
+	load_config(1);
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!lock_database())
+		return EXIT_FAILURE;
+
+	init_player(&c.player);
+	c.now = time(NULL);
+
+	if (!walk_players_in_parallel(compact, &c))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -2,34 +2,27 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
-#include <dirent.h>
 #include <limits.h>
 #include <errno.h>
 
 #include "config.h"
 #include "player.h"
-
-static int ignored;
-
-static void ignore_newest_player(void)
-{
-	ignored = 1;
-}
-
-static struct player_summary *new_player(
-	struct player_summary **_players, unsigned *_nplayers)
+#include "dict.h"
+#include "commit.h"
+#include "ranks.h"
+#include "generation.h"
+#include "trigrams.h"
+#include "prefixes.h"
+
+static struct rank_entry *new_player(
+	struct rank_entry **_players, unsigned *_nplayers)
 {
 	static const unsigned STEP = 1024 * 1024;
-	struct player_summary *players = *_players;
+	struct rank_entry *players = *_players;
 	unsigned nplayers = *_nplayers;
 
-	if (ignored) {
-		ignored = 0;
-		return &players[nplayers - 1];
-	}
-
 	if (nplayers % STEP == 0) {
-		struct player_summary *tmp;
+		struct rank_entry *tmp;
 
 		tmp = realloc(players, (nplayers + STEP) * sizeof(*players));
 		if (!tmp) {
@@ -46,97 +39,109 @@ static struct player_summary *new_player(
 	return &players[nplayers];
 }
 
-static struct player_summary *load_all_players(unsigned *nplayers)
-{
-	DIR *dir;
-	struct dirent *dp;
-	static char path[PATH_MAX];
-
-	struct player_summary *players = NULL;
+struct ranked_list {
+	struct rank_entry *players;
+	unsigned nplayers;
+};
 
-	assert(nplayers != NULL);
+static int load_player(const char *name, void *data)
+{
+	static struct player_summary ps;
+	struct ranked_list *list = data;
+	struct rank_entry *player;
+	unsigned id;
 
-	*nplayers = 0;
+	if (read_player_summary(&ps, name) != PLAYER_FOUND)
+		return 1;
+	if ((id = register_player(name)) == NO_ID)
+		return 1;
 
-	sprintf(path, "%s/players", config.root);
-	if (!(dir = opendir(path)))
-		perror(path), exit(EXIT_FAILURE);
+	player = new_player(&list->players, &list->nplayers);
+	set_rank_entry(player, id, ps.elo, ps.clan);
 
-	while ((dp = readdir(dir))) {
-		struct player_summary *player;
+	return 1;
+}
 
-		if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
-			continue;
-		if (!is_valid_hexname(dp->d_name))
-			continue;
+static struct rank_entry *load_all_players(unsigned *nplayers)
+{
+	struct ranked_list list = { NULL, 0 };
 
-		player = new_player(&players, nplayers);
-		if (read_player_summary(player, dp->d_name) != PLAYER_FOUND) {
-			ignore_newest_player();
-			continue;
-		}
-	}
+	assert(nplayers != NULL);
 
-	closedir(dir);
+	if (!walk_players(load_player, &list))
+		exit(EXIT_FAILURE);
 
-	return players;
+	*nplayers = list.nplayers;
+	return list.players;
 }
 
 static int cmp_players_elo(const void *p1, const void *p2)
 {
-	const struct player_summary *a = p1, *b = p2;
+	const struct rank_entry *a = p1, *b = p2;
 
 	/* We want them in reverse order */
 	return b->elo - a->elo;
 }
 
-#define _str(s) #s
-#define str(s) _str(s)
-
-#define TEST (HEXNAME_LENGTH - 1)
-
-static void write_ranks(struct player_summary *players, unsigned nplayers)
+/*
+ * Ranks are listed from the ranks file of the current generation, hence
+ * player files are updated before it is published, so that rank pages
+ * and player pages agree as soon as the new generation is visible.  The
+ * search indexes are published along with them.
+ */
+static void publish_ranks(struct rank_entry *players, unsigned nplayers)
 {
 	unsigned i;
-	FILE *file;
-	char path[PATH_MAX];
-
+	char name[HEXNAME_LENGTH];
+	struct trigrams_builder trigrams;
+	struct prefixes_builder prefixes;
+	struct generation gen;
 	struct player player;
+	char *path;
 
-	sprintf(path, "%s/ranks", config.root);
-	if (!(file = fopen(path, "w"))) {
-		perror(path);
+	if (!create_generation(&gen))
+		exit(EXIT_FAILURE);
+	if (!(path = generation_file(&gen, "ranks")))
+		exit(EXIT_FAILURE);
+	if (!write_ranks(path, players, nplayers))
 		exit(EXIT_FAILURE);
-	}
-
-	/* Print the number of players first... */
-	fprintf(file, "%u players\n", nplayers);
 
-	/* ...and print player's name, and then save player infos themself. */
+	/* Then save player infos themself */
 	init_player(&player);
+	init_trigrams_builder(&trigrams);
+	init_prefixes_builder(&prefixes);
 	for (i = 0; i < nplayers; i++) {
-		/*
-		 * Name is padded so each line is exactly
-		 * HEXNAME_LENGTH bytes.  This is done so that
-		 * seeking by a n * HEXNAME_LENGTH bytes does
-		 * end up on the nth name.
-		 */
-		fprintf(file, "%-*s\n", HEXNAME_LENGTH - 1, players[i].name);
-
-		if (read_player(&player, players[i].name) != PLAYER_FOUND)
+		if (!get_player_name(players[i].id, name))
+			continue;
+		if (!add_trigrams(&trigrams, name, i + 1))
+			exit(EXIT_FAILURE);
+		if (!add_prefix(&prefixes, name, i + 1))
+			exit(EXIT_FAILURE);
+		if (read_player(&player, name) != PLAYER_FOUND)
 			continue;
 
 		set_rank(&player, i + 1);
 		write_player(&player);
 	}
 
-	fclose(file);
+	if (!(path = generation_file(&gen, "trigrams")))
+		exit(EXIT_FAILURE);
+	if (!write_trigrams(&trigrams, path))
+		exit(EXIT_FAILURE);
+
+	if (!(path = generation_file(&gen, "prefixes")))
+		exit(EXIT_FAILURE);
+	if (!write_prefixes(&prefixes, path))
+		exit(EXIT_FAILURE);
+
+	if (!publish_generation(&gen))
+		exit(EXIT_FAILURE);
 }
 
 int main(int argc, char *argv[])
 {
 	unsigned nplayers;
-	struct player_summary *players;
+	struct rank_entry *players;
 
 	load_config(1);
 	if (argc != 1) {
@@ -144,10 +149,21 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (!lock_database())
+		return EXIT_FAILURE;
+
 	players = load_all_players(&nplayers);
+
+	/* Every player is registered by now, size the filter accordingly */
+	if (!rebuild_players_bloom())
+		return EXIT_FAILURE;
+
 	qsort(players, nplayers, sizeof(*players), cmp_players_elo);
 
-	write_ranks(players, nplayers);
+	publish_ranks(players, nplayers);
+
+	if (!sync_commits())
+		return EXIT_FAILURE;
 
 	return EXIT_SUCCESS;
 }
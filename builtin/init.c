@@ -6,6 +6,7 @@
 #include <errno.h>
 
 #include "config.h"
+#include "player.h"
 
 static char *get_path(const char *filename)
 {
@@ -63,12 +64,16 @@ static void set_database_version(unsigned version)
 
 int main(int argc, char *argv[])
 {
+	unsigned shard;
+
 	/* Since database may not exist, checking version is useless */
 	load_config(0);
 
 	create_dir("");
 	create_dir("servers");
 	create_dir("players");
+	for (shard = 0; shard < NSHARDS; shard++)
+		create_dir(get_shard_path(shard));
 	create_dir("clans");
 
 	set_database_version(DATABASE_VERSION);
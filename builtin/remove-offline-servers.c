@@ -73,7 +73,8 @@ int main(int argc, char **argv)
 	while ((dp = readdir(dir))) {
 		struct server_state state;
 
-		if (strcmp(".", dp->d_name) == 0 || strcmp("..", dp->d_name) == 0)
+		/* Skip ".", ".." and temporary files */
+		if (dp->d_name[0] == '.')
 			continue;
 
 		/* Just ignore server on error */
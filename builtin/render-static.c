@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "config.h"
+#include "cgi.h"
+#include "cache.h"
+#include "commit.h"
+#include "gzip.h"
+#include "hexname.h"
+#include "player.h"
+#include "ranks.h"
+#include "generation.h"
+
+/*
+ * Pages are rendered as if they were requested to the CGI, and the
+ * server name defaults silently since rank, player and clan pages do
+ * not print it.  Plain pages are asked for, they are compressed here.
+ */
+static const char *get_param(const char *name, void *data)
+{
+	const char *value;
+
+	if (!strcmp(name, "DOCUMENT_URI"))
+		return data;
+	if (!strcmp(name, "SERVER_PORT"))
+		return getenv(name);
+	if (strcmp(name, "SERVER_NAME"))
+		return NULL;
+
+	if (!(value = getenv(name)))
+		return "teerank.com";
+	return value;
+}
+
+static char *webroot_file(const char *uri)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s%s", config.webroot, uri) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", config.webroot);
+		return NULL;
+	}
+
+	return path;
+}
+
+/* Compare the rendered page with the one already in the webroot */
+static int is_unchanged(const char *path, const char *data, size_t size)
+{
+	char buf[4096];
+	const char *body;
+	size_t length, ret;
+	struct stat st;
+	FILE *file;
+
+	if (!(file = fopen(path, "r")))
+		return 0;
+
+	if (fstat(fileno(file), &st) == -1 || (size_t)st.st_size != size)
+		goto changed;
+
+	body = data;
+	length = size;
+
+	while ((ret = fread(buf, 1, sizeof(buf), file))) {
+		if (ret > length || memcmp(buf, body, ret))
+			goto changed;
+		body += ret;
+		length -= ret;
+	}
+
+	fclose(file);
+	return length == 0;
+
+changed:
+	fclose(file);
+	return 0;
+}
+
+static int write_file(const char *path, const char *data, size_t length)
+{
+	struct staged_file sf;
+	FILE *file;
+
+	verbose("Writing %s\n", path);
+
+	if (!(file = stage_file(&sf, path)))
+		return 0;
+
+	if (fwrite(data, 1, length, file) != length) {
+		perror(path);
+		discard_file(&sf);
+		return 0;
+	}
+
+	return commit_file(&sf);
+}
+
+/*
+ * Write a compressed copy next to the page, for nginx "gzip_static".
+ * It is only compressed again when the page changed.
+ */
+static int write_gzip_file(const char *path, const struct response *res, int changed)
+{
+	static FILE *out;
+	static char *data;
+	static size_t size;
+	char gzpath[PATH_MAX];
+
+	if (snprintf(gzpath, PATH_MAX, "%s.gz", path) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", path);
+		return 0;
+	}
+
+	if (!changed && access(gzpath, F_OK) == 0)
+		return 1;
+
+	if (!out && !(out = open_memstream(&data, &size)))
+		return perror("open_memstream()"), 0;
+
+	rewind(out);
+	if (!gzip(out, res->body, res->length))
+		return 0;
+	if (fflush(out) == EOF)
+		return perror(gzpath), 0;
+
+	return write_file(gzpath, data, size);
+}
+
+/* Render the given page and write it in the webroot, if it changed */
+static int render_file(const char *uri)
+{
+	struct response res;
+	char path[PATH_MAX], *tmp;
+	int changed;
+
+	if (!render_page(&res, get_param, (void*)uri) || res.status != 200) {
+		fprintf(stderr, "%s: %d %s\n", uri, res.status, reason_phrase(res.status));
+		return 0;
+	}
+
+	if (!(tmp = webroot_file(uri)))
+		return 0;
+	strcpy(path, tmp);
+
+	/*
+	 * The compressed copy is written first, so that it is written
+	 * again on the next run if writing the page fails.
+	 */
+	changed = !is_unchanged(path, res.body, res.length);
+	if (!write_gzip_file(path, &res, changed))
+		return 0;
+	if (changed && !write_file(path, res.body, res.length))
+		return 0;
+
+	return 1;
+}
+
+static int render_rank_page(unsigned pnum)
+{
+	char uri[64];
+
+	sprintf(uri, "/pages/%u.html", pnum);
+	return render_file(uri);
+}
+
+/*
+ * Pages past the last one are left over from the time there were
+ * more players, they would be served instead of a 404.
+ */
+static int remove_old_rank_pages(unsigned npages)
+{
+	static char path[PATH_MAX];
+	struct dirent *dp;
+	unsigned pnum;
+	char c;
+	DIR *dir;
+	int ret = 1;
+
+	snprintf(path, PATH_MAX, "%s/pages", config.webroot);
+	if (!(dir = opendir(path)))
+		return perror(path), 0;
+
+	while ((dp = readdir(dir))) {
+		/* Compressed copies are removed as well */
+		if (sscanf(dp->d_name, "%u.htm%c", &pnum, &c) != 2 || c != 'l')
+			continue;
+		if (pnum <= npages)
+			continue;
+
+		snprintf(path, PATH_MAX, "%s/pages/%s", config.webroot, dp->d_name);
+		verbose("Removing %s\n", path);
+		if (unlink(path) == -1 && errno != ENOENT) {
+			perror(path);
+			ret = 0;
+		}
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+static int render_player(const char *name, void *data)
+{
+	char uri[PATH_MAX];
+
+	snprintf(uri, sizeof(uri), "/players/%s.html", name);
+	return render_file(uri);
+}
+
+static int render_clans(unsigned worker, unsigned nworkers)
+{
+	static char path[PATH_MAX];
+	char uri[PATH_MAX];
+	struct dirent *dp;
+	unsigned i = 0;
+	DIR *dir;
+	int ret = 1;
+
+	if (snprintf(path, PATH_MAX, "%s/clans", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", config.root);
+		return 0;
+	}
+
+	if (!(dir = opendir(path)))
+		return perror(path), 0;
+
+	while ((dp = readdir(dir))) {
+		if (!is_valid_hexname(dp->d_name))
+			continue;
+		if (i++ % nworkers != worker)
+			continue;
+
+		snprintf(uri, sizeof(uri), "/clans/%s.html", dp->d_name);
+		if (!render_file(uri))
+			ret = 0;
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+/* Each worker renders one rank page every "nworkers" pages */
+static int render_static(
+	unsigned worker, unsigned nworkers, unsigned npages, int clans)
+{
+	unsigned pnum;
+	int ret = 1;
+
+	for (pnum = worker + 1; pnum <= npages; pnum += nworkers)
+		if (!render_rank_page(pnum))
+			ret = 0;
+
+	if (clans && !render_clans(worker, nworkers))
+		ret = 0;
+
+	if (!sync_commits())
+		ret = 0;
+
+	return ret;
+}
+
+static int render_in_parallel(unsigned npages, int clans)
+{
+	long nworkers;
+	unsigned i;
+	int status, ret = 1;
+
+	nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers < 1)
+		nworkers = 1;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < nworkers; i++) {
+		pid_t pid = fork();
+
+		if (pid == -1) {
+			perror("fork()");
+			ret = 0;
+			break;
+		} else if (pid == 0) {
+			if (!render_static(i, nworkers, npages, clans))
+				exit(EXIT_FAILURE);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	while (wait(&status) != -1)
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			ret = 0;
+
+	if (errno != ECHILD) {
+		perror("wait()");
+		ret = 0;
+	}
+
+	return ret;
+}
+
+static int create_directory(const char *name)
+{
+	char *path;
+
+	if (!(path = webroot_file(name)))
+		return 0;
+
+	if (mkdir(path, 0777) == -1 && errno != EEXIST)
+		return perror(path), 0;
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	int players = 0, clans = 0, ret = EXIT_SUCCESS;
+	unsigned nplayers, npages;
+	char *path;
+	int i;
+
+	load_config(1);
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "players"))
+			players = 1;
+		else if (!strcmp(argv[i], "clans"))
+			clans = 1;
+		else {
+			fprintf(stderr, "usage: %s [players] [clans]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!*config.webroot) {
+		fprintf(stderr, "TEERANK_WEBROOT is not set\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!create_directory("/pages"))
+		return EXIT_FAILURE;
+	if (players && !create_directory("/players"))
+		return EXIT_FAILURE;
+	if (clans && !create_directory("/clans"))
+		return EXIT_FAILURE;
+
+	/* Pages are written in the webroot, caching them would be useless */
+	is_page_cache_enabled = 0;
+
+	if (!(path = current_file("ranks"))) {
+		if (errno == ENOENT)
+			fprintf(stderr, "%s: Ranks have never been computed\n", config.root);
+		return EXIT_FAILURE;
+	}
+	if (!read_ranks_length(path, &nplayers))
+		return EXIT_FAILURE;
+
+	npages = nplayers / PLAYERS_PER_PAGE + 1;
+	if (!render_in_parallel(npages, clans))
+		ret = EXIT_FAILURE;
+	if (!remove_old_rank_pages(npages))
+		ret = EXIT_FAILURE;
+	if (players && !walk_players_in_parallel(render_player, NULL))
+		ret = EXIT_FAILURE;
+
+	return ret;
+}
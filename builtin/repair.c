@@ -1,6 +1,5 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <dirent.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
@@ -9,6 +8,8 @@
 #include "config.h"
 #include "player.h"
 #include "clan.h"
+#include "dict.h"
+#include "commit.h"
 
 struct clan_list {
 	unsigned length;
@@ -72,47 +73,41 @@ static int need_repair(struct clan *clan)
 	return !clan_equal(&tmp, clan);
 }
 
+static struct player player;
+
+static int add_player(const char *name, void *data)
+{
+	struct clan_list *clans = data;
+	struct clan *clan;
+
+	if (read_player(&player, name) != PLAYER_FOUND)
+		return 1;
+
+	/* Clan files refer to players by id */
+	if (register_player(player.name) == NO_ID)
+		return 1;
+
+	clan = get_clan(clans, player.clan);
+	if (clan)
+		add_member(clan, player.name);
+
+	return 1;
+}
+
 static const struct clan_list CLAN_LIST_ZERO;
 
 int main(int argc, char **argv)
 {
-	DIR *dir;
-	struct dirent *dp;
 	struct clan_list clans = CLAN_LIST_ZERO;
-	static char path[PATH_MAX];
 	unsigned i;
 	unsigned nrepair = 0;
-	struct player player;
 
 	load_config(1);
 
-	if (snprintf(path, PATH_MAX, "%s/players/", config.root) >= PATH_MAX) {
-		fprintf(stderr, "snprintf(path, %d): Too long\n", PATH_MAX);
-		return EXIT_FAILURE;
-	}
-
-	if (!(dir = opendir(path)))
-		return perror(path), EXIT_FAILURE;
-
 	/* Build clan list */
 	init_player(&player);
-	while ((dp = readdir(dir))) {
-		struct clan *clan;
-
-		if (!strcmp(dp->d_name, "..") || !strcmp(dp->d_name, "."))
-			continue;
-		if (!is_valid_hexname(dp->d_name))
-			continue;
-
-		if (read_player(&player, dp->d_name) != PLAYER_FOUND)
-			continue;
-
-		clan = get_clan(&clans, player.clan);
-		if (clan)
-			add_member(clan, player.name);
-	}
-
-	closedir(dir);
+	if (!walk_players(add_player, &clans))
+		return EXIT_FAILURE;
 
 	/* Update clan that are not up-to-date */
 	for (i = 0; i < clans.length; i++) {
@@ -125,5 +120,8 @@ int main(int argc, char **argv)
 
 	verbose("%u clans repaired\n", nrepair);
 
+	if (!sync_commits())
+		return EXIT_FAILURE;
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,384 @@
+/*
+ * Rate again every archived players from scratch, using the delta
+ * archive.  Every game is replayed in memory, and players are written
+ * back to the database only once at the end, by several processes.
+ *
+ * Games have to be replayed in order since each one depends on the
+ * elos computed by the previous ones, hence the replay itself is done
+ * by a single process.  It only works on compact in-memory data
+ * structures, so it is not the bottleneck: writing players is.
+ *
+ * Players that are not in the archive are left untouched.  Ranks
+ * recorded in historics are computed at the end of each update cycle
+ * among archived players only.  Run teerank-compute-ranks and
+ * teerank-repair after a replay to update ranks and clans.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "config.h"
+#include "player.h"
+#include "delta.h"
+#include "elo.h"
+#include "archive.h"
+#include "dict.h"
+#include "commit.h"
+
+struct replay_record {
+	time_t time;
+	struct player_record data;
+};
+
+/* Players are indexed by their id in the dictionary */
+struct replay_player {
+	char clan[HEXNAME_LENGTH];
+	int elo;
+
+	/* Last cycle the player has been active in */
+	unsigned cycle;
+
+	unsigned nrecords, length;
+	struct replay_record *records;
+};
+
+static struct dict dict;
+static struct replay_player *players;
+static unsigned nplayers;
+
+/* Players active during the current cycle */
+static unsigned *active;
+static unsigned nactive;
+
+static void *grow(void *ptr, unsigned length, size_t size)
+{
+	const unsigned STEP = 1024;
+
+	if (length % STEP == 0) {
+		ptr = realloc(ptr, (length + STEP) * size);
+		if (!ptr) {
+			perror("realloc()");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return ptr;
+}
+
+/*
+ * Elo can be anything, but in practice it is never far from
+ * DEFAULT_ELO.  Elos out of bounds are clamped, ranks of players with
+ * such elos are slightly wrong, which is fine.
+ */
+#define ELO_RANGE (1 << 16)
+
+/*
+ * A fenwick tree counting players for each elo value, so that the
+ * number of players with a higher elo can be computed in O(log(n)).
+ */
+static unsigned elo_counts[ELO_RANGE + 1];
+
+static unsigned elo_index(int elo)
+{
+	elo += ELO_RANGE / 2;
+
+	if (elo < 0)
+		return 1;
+	else if (elo >= ELO_RANGE)
+		return ELO_RANGE;
+	return elo + 1;
+}
+
+static void count_elo(int elo, int n)
+{
+	unsigned i;
+
+	for (i = elo_index(elo); i <= ELO_RANGE; i += i & -i)
+		elo_counts[i] += n;
+}
+
+static unsigned compute_rank(int elo)
+{
+	unsigned i, lower_or_equal = 0;
+
+	for (i = elo_index(elo); i > 0; i -= i & -i)
+		lower_or_equal += elo_counts[i];
+
+	return nplayers - lower_or_equal + 1;
+}
+
+static void mark_active(unsigned id, unsigned cycle)
+{
+	if (players[id].cycle == cycle)
+		return;
+
+	players[id].cycle = cycle;
+	active = grow(active, nactive, sizeof(*active));
+	active[nactive++] = id;
+}
+
+static void add_record(struct replay_player *player, time_t time)
+{
+	struct replay_record *rec;
+
+	if (player->nrecords == player->length) {
+		unsigned length = player->length ? player->length * 2 : 4;
+
+		rec = realloc(player->records, length * sizeof(*rec));
+		if (!rec) {
+			perror("realloc(records)");
+			exit(EXIT_FAILURE);
+		}
+
+		player->records = rec;
+		player->length = length;
+	}
+
+	rec = &player->records[player->nrecords++];
+	rec->time = time;
+	init_player_record(&rec->data, player->elo, UNRANKED);
+}
+
+/* Same as set_elo() */
+static void set_replay_elo(struct replay_player *player, int elo, time_t time)
+{
+	struct replay_record *last;
+
+	count_elo(player->elo, -1);
+	count_elo(elo, 1);
+	player->elo = elo;
+
+	last = &player->records[player->nrecords - 1];
+	if (last->data.rank == UNRANKED)
+		last->data.elo = elo;
+	else
+		add_record(player, time);
+}
+
+/*
+ * Same as create_player().  Players may be moved when a new one is
+ * added, hence the id is returned rather than a pointer.
+ */
+static unsigned get_player(const char *name, time_t time, unsigned cycle)
+{
+	struct replay_player *player;
+	unsigned id;
+
+	if ((id = add_name(&dict, name)) == NO_ID)
+		exit(EXIT_FAILURE);
+	if (id < nplayers)
+		return id;
+
+	players = grow(players, nplayers, sizeof(*players));
+	player = &players[nplayers++];
+
+	strcpy(player->clan, "00");
+	player->elo = DEFAULT_ELO;
+	player->cycle = 0;
+	player->nrecords = 0;
+	player->length = 0;
+	player->records = NULL;
+
+	count_elo(player->elo, 1);
+	add_record(player, time);
+	mark_active(id, cycle);
+
+	return id;
+}
+
+/* Same as compute-ranks, but only for players active during the cycle */
+static void end_cycle(void)
+{
+	unsigned i;
+
+	for (i = 0; i < nactive; i++) {
+		struct replay_player *player = &players[active[i]];
+		struct replay_record *last;
+
+		last = &player->records[player->nrecords - 1];
+		if (last->data.rank == UNRANKED)
+			last->data.rank = compute_rank(player->elo);
+	}
+
+	nactive = 0;
+}
+
+static void replay_delta(struct delta *delta, time_t time, unsigned cycle)
+{
+	unsigned game[MAX_PLAYERS];
+	int elos[MAX_PLAYERS];
+	void *ratings[MAX_PLAYERS];
+	long deltas[MAX_PLAYERS] = { 0 };
+	int rankable[MAX_PLAYERS] = { 0 };
+	unsigned i;
+
+	/* Every player must exist before any of them is accessed */
+	for (i = 0; i < delta->length; i++)
+		game[i] = get_player(delta->players[i].name, time, cycle);
+
+	for (i = 0; i < delta->length; i++) {
+		strcpy(players[game[i]].clan, delta->players[i].clan);
+
+		elos[i] = players[game[i]].elo;
+		ratings[i] = &elos[i];
+		deltas[i] = delta->players[i].delta;
+		rankable[i] = 1;
+	}
+
+	if (!is_rankable_game(delta->elapsed, delta->length, delta->length))
+		return;
+
+	ELO_ENGINE.rate_game(&ELO_ENGINE, delta->length, ratings, deltas, rankable);
+
+	for (i = 0; i < delta->length; i++) {
+		set_replay_elo(&players[game[i]], elos[i], time);
+		mark_active(game[i], cycle);
+	}
+}
+
+static void replay(struct archive *archive)
+{
+	struct delta delta;
+	unsigned cycle = 1, ncycles = 0, ndeltas = 0;
+	time_t time;
+
+	while (next_archived_delta(archive, &delta, &time)) {
+		if (delta.length == 0) {
+			end_cycle();
+			cycle++;
+			ncycles++;
+		} else {
+			replay_delta(&delta, time, cycle);
+			ndeltas++;
+		}
+	}
+
+	end_cycle();
+
+	verbose("%u deltas replayed over %u cycles, %u players rated\n",
+	        ndeltas, ncycles, nplayers);
+}
+
+static int write_replay_player(struct player *player, struct replay_player *rp)
+{
+	struct replay_record *last;
+	unsigned i;
+
+	last = &rp->records[rp->nrecords - 1];
+
+	strcpy(player->name, dict.names[rp - players]);
+	strcpy(player->clan, rp->clan);
+	player->elo = rp->elo;
+	player->rank = last->data.rank;
+
+	create_historic(&player->hist);
+	for (i = 0; i < rp->nrecords; i++)
+		if (!append_record_at(&player->hist, &rp->records[i].data,
+		                      rp->records[i].time))
+			return 0;
+
+	return write_player(player);
+}
+
+/*
+ * Each worker write one player every "nworkers" players.
+ */
+static int write_players(unsigned worker, unsigned nworkers)
+{
+	struct player player;
+	unsigned i;
+	int ret = 1;
+
+	init_player(&player);
+
+	for (i = worker; i < nplayers; i += nworkers)
+		if (!write_replay_player(&player, &players[i]))
+			ret = 0;
+
+	if (!sync_commits())
+		ret = 0;
+
+	return ret;
+}
+
+/*
+ * Players ids are given before forking, since workers would otherwise
+ * compete to register new players.
+ */
+static int register_players(void)
+{
+	unsigned i;
+
+	for (i = 0; i < nplayers; i++)
+		if (register_player(dict.names[i]) == NO_ID)
+			return 0;
+
+	return 1;
+}
+
+static int write_players_in_parallel(void)
+{
+	long nworkers;
+	unsigned i;
+	int status, ret = 1;
+
+	nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers < 1)
+		nworkers = 1;
+
+	verbose("Writing %u players with %ld workers\n", nplayers, nworkers);
+
+	for (i = 0; i < nworkers; i++) {
+		pid_t pid = fork();
+
+		if (pid == -1) {
+			perror("fork()");
+			ret = 0;
+			break;
+		} else if (pid == 0) {
+			exit(write_players(i, nworkers) ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	while (wait(&status) != -1)
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			ret = 0;
+
+	if (errno != ECHILD) {
+		perror("wait()");
+		ret = 0;
+	}
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct archive archive;
+
+	load_config(1);
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!open_archive(&archive))
+		return EXIT_FAILURE;
+
+	init_dict(&dict);
+	replay(&archive);
+	close_archive(&archive);
+
+	if (!register_players())
+		return EXIT_FAILURE;
+	if (!write_players_in_parallel())
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -9,6 +9,7 @@
 #include "config.h"
 #include "player.h"
 #include "clan.h"
+#include "commit.h"
 
 static const struct clan CLAN_ZERO;
 
@@ -73,6 +74,9 @@ int main(int argc, char *argv[])
 		clan_move_player(old, new, player);
 	}
 
+	if (!sync_commits())
+		return EXIT_FAILURE;
+
 	if (ret == EOF && !ferror(stdin))
 		return EXIT_SUCCESS;
 	else if (ferror(stdin))
@@ -10,47 +10,7 @@
 #include "player.h"
 #include "delta.h"
 #include "elo.h"
-
-/*
- * Given a game it does return wether or not this game fills the requirements
- * to be ranked.
- */
-static unsigned make_sens_to_rank(
-	int elapsed, struct player *players, unsigned length)
-{
-	unsigned i, rankable = 0;
-
-	assert(players != NULL);
-
-	/*
-	 * 30 minutes between each update is just too much and it increase
-	 * the chance of rating two different games.
-	 */
-	if (elapsed > 30 * 60) {
-		verbose("A game with %u players is unrankable because too"
-		        " much time have passed between two updates\n",
-		        length);
-		return 0;
-	}
-
-	/*
-	 * We don't rank games with less than 4 rankable players.  We believe
-	 * it is too much volatile to rank those kind of games.
-	 */
-	for (i = 0; i < length; i++)
-		if (players[i].is_rankable)
-			rankable++;
-	if (rankable < 4) {
-		verbose("A game with %u players is unrankable because only"
-		        " %u players can be ranked, 4 needed\n",
-		        length, rankable);
-		return 0;
-	}
-
-	verbose("A game with %u rankable players over %u will be ranked\n",
-	        rankable, length);
-	return 1;
-}
+#include "commit.h"
 
 static void merge_delta(struct player *player, struct player_delta *delta)
 {
@@ -71,6 +31,19 @@ static void merge_delta(struct player *player, struct player_delta *delta)
 	player->is_rankable = 1;
 }
 
+static unsigned count_rankable(struct player *players, unsigned length)
+{
+	unsigned i, rankable = 0;
+
+	assert(players != NULL);
+
+	for (i = 0; i < length; i++)
+		if (players[i].is_rankable)
+			rankable++;
+
+	return rankable;
+}
+
 int main(int argc, char **argv)
 {
 	struct delta delta;
@@ -83,6 +56,9 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	if (!lock_database())
+		return EXIT_FAILURE;
+
 	for (i = 0; i < MAX_PLAYERS; i++)
 		init_player(&players[i]);
 
@@ -110,7 +86,7 @@ int main(int argc, char **argv)
 		}
 
 		/* Compute their new elos */
-		if (make_sens_to_rank(delta.elapsed, players, length))
+		if (is_rankable_game(delta.elapsed, count_rankable(players, length), length))
 			update_elos(players, length);
 
 		/* Write the result only if something changed */
@@ -129,5 +105,8 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (!sync_commits())
+		return EXIT_FAILURE;
+
 	return EXIT_SUCCESS;
 }
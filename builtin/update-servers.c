@@ -20,6 +20,8 @@
 #include "config.h"
 #include "server.h"
 #include "player.h"
+#include "archive.h"
+#include "commit.h"
 
 static const uint8_t MSG_GETINFO[] = {
 	255, 255, 255, 255, 'g', 'i', 'e', '3'
@@ -257,6 +259,10 @@ static int handle_data(struct data *data, struct server *server)
 		remove_spectators(&new);
 		delta = delta_states(&server->state, &new, elapsed);
 		print_delta(&delta);
+
+		/* Archive failures are not fatal, update can still go on */
+		if (delta.length)
+			archive_delta(&delta, new.last_seen);
 	}
 
 	return 1;
@@ -347,7 +353,8 @@ static int fill_server_list(struct server_list *list)
 		char ip[IP_LENGTH + 1], port[PORT_LENGTH + 1];
 		struct server server;
 
-		if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+		/* Skip ".", ".." and temporary files */
+		if (dp->d_name[0] == '.')
 			continue;
 
 		count++;
@@ -433,8 +440,12 @@ int main(int argc, char **argv)
 
 	if (!init_sockets(&sockets))
 		return EXIT_FAILURE;
+	archive_cycle(time(NULL));
 	poll_servers(&list, &sockets);
 	close_sockets(&sockets);
 
+	if (!sync_commits())
+		return EXIT_FAILURE;
+
 	return EXIT_SUCCESS;
 }
@@ -7,3 +7,4 @@ teerank-add-new-servers
 teerank-remove-offline-servers 1
 teerank-update-servers | teerank-update-players | teerank-update-clans
 teerank-compute-ranks
+if [ -n "$TEERANK_WEBROOT" ]; then teerank-render-static; fi
@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "dict.h"
+#include "generation.h"
+
+int is_page_cache_enabled = 1;
+
+/*
+ * Entries are named after the hash of their key.  The key is stored at
+ * the start of the entry, followed by a nul byte, so that two pages
+ * with the same hash are never mixed up: the last one cached wins.
+ */
+int read_cached_page(const char *key, FILE *out)
+{
+	char buf[4096], name[32];
+	size_t length, ret;
+	char *path;
+	FILE *file;
+
+	assert(key != NULL);
+	assert(out != NULL);
+
+	if (!is_page_cache_enabled)
+		return 0;
+
+	length = strlen(key) + 1;
+	if (length > sizeof(buf))
+		return 0;
+
+	sprintf(name, "cache-%08x", hash_name(key));
+	if (!(path = current_file(name)))
+		return 0;
+	if (!(file = fopen(path, "r")))
+		return 0;
+
+	if (fread(buf, 1, length, file) != length || memcmp(buf, key, length))
+		goto miss;
+
+	while ((ret = fread(buf, 1, sizeof(buf), file)))
+		fwrite(buf, 1, ret, out);
+
+	if (ferror(file)) {
+		perror(path);
+		goto miss;
+	}
+
+	fclose(file);
+	return 1;
+
+miss:
+	fclose(file);
+	return 0;
+}
+
+/* Only unexpected errors are printed */
+static int is_cache_disabled(int err)
+{
+	return err == EACCES || err == EROFS || err == ENOENT;
+}
+
+void write_cached_page(const char *key, const char *data, size_t length)
+{
+	static char path[PATH_MAX], tmp[PATH_MAX];
+	char name[64];
+	char *ret;
+	FILE *file;
+
+	assert(key != NULL);
+	assert(data != NULL || length == 0);
+
+	if (!is_page_cache_enabled)
+		return;
+
+	sprintf(name, "cache-%08x", hash_name(key));
+	if (!(ret = current_file(name)))
+		return;
+	strcpy(path, ret);
+
+	/* Several processes may cache the same page at the same time */
+	sprintf(name, ".cache-%08x.%ld.tmp", hash_name(key), (long)getpid());
+	if (!(ret = current_file(name)))
+		return;
+	strcpy(tmp, ret);
+
+	if (!(file = fopen(tmp, "w"))) {
+		if (!is_cache_disabled(errno))
+			perror(tmp);
+		return;
+	}
+
+	if (fwrite(key, strlen(key) + 1, 1, file) != 1)
+		goto fail;
+	if (length && fwrite(data, length, 1, file) != 1)
+		goto fail;
+
+	if (fclose(file) == EOF) {
+		perror(tmp);
+		unlink(tmp);
+		return;
+	}
+
+	if (rename(tmp, path) == -1) {
+		if (!is_cache_disabled(errno))
+			perror(path);
+		unlink(tmp);
+	}
+
+	return;
+
+fail:
+	perror(tmp);
+	fclose(file);
+	unlink(tmp);
+}
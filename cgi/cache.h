@@ -0,0 +1,44 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+/**
+ * @file cache.h
+ *
+ * Rendered pages are cached in the current generation, next to the
+ * ranks they are computed from.  Publishing a new generation hence
+ * invalidates every cached page, and old entries are removed along
+ * with their generation.
+ *
+ * Entries are only written when the process can write in the
+ * generation directory, otherwise pages are just not cached.
+ */
+
+#include <stdio.h>
+
+/**
+ * Set to 0 to neither read nor write cached pages, for programs that
+ * store rendered pages on their own.
+ */
+extern int is_page_cache_enabled;
+
+/**
+ * Copy the cached content of the given page to the given stream.
+ *
+ * @param key Key identifying the page, like its route and arguments
+ * @param out Stream to copy the content to
+ *
+ * @return 1 if the page was cached, 0 otherwise
+ */
+int read_cached_page(const char *key, FILE *out);
+
+/**
+ * Cache the content of the given page.  Failures are silent, the page
+ * will be rendered again next time.
+ *
+ * @param key Key identifying the page
+ * @param data Content of the page
+ * @param length Length of the content
+ */
+void write_cached_page(const char *key, const char *data, size_t length);
+
+#endif /* CACHE_H */
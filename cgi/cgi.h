@@ -1,11 +1,73 @@
 #ifndef CGI_H
 #define CGI_H
 
+#include <stdio.h>
+#include <sys/uio.h>
+
 /* Used by pages */
 #define EXIT_NOT_FOUND 2
 
 void error(int code, char *fmt, ...);
 
+/*
+ * Pages are requested with CGI parameters: PATH_INFO or DOCUMENT_URI,
+ * QUERY_STRING, SERVER_NAME, SERVER_PORT, and optionally
+ * HTTP_IF_NONE_MATCH, HTTP_IF_MODIFIED_SINCE and HTTP_ACCEPT_ENCODING.  A function returns the
+ * value of the given parameter, or NULL when it is not set.
+ */
+typedef const char *(*get_param_func_t)(const char *name, void *data);
+
+/* Stream pages write their content to */
+extern FILE *page_out;
+
+struct response {
+	int status;
+	const char *content_type;
+
+	/* ETag and Last-Modified headers, NULL when the page has none */
+	const char *etag;
+	const char *last_modified;
+
+	/* "gzip" when the body is compressed, NULL otherwise */
+	const char *content_encoding;
+
+	/* Whether the body depends on Accept-Encoding */
+	int has_variants;
+
+	/* Valid until the next page is rendered */
+	const char *body;
+	size_t length;
+};
+
+/*
+ * Render the requested page.  Errors are rendered as well, and it
+ * returns 0 if the request itself was invalid, 1 otherwise.
+ */
+int render_page(struct response *res, get_param_func_t get_param, void *data);
+
+const char *reason_phrase(int code);
+
+/* Like writev(), but retry until everything is written */
+int writev_full(int fd, struct iovec *iov, int iovcnt);
+
+#define MAX_HEADERS_LENGTH 512
+
+/*
+ * Format headers of the given response, as expected from a CGI.
+ * Return the length of the headers.
+ */
+int format_cgi_headers(const struct response *res, char *buf, size_t size);
+
+/*
+ * Format ETag, Last-Modified, Content-Encoding and Vary headers of the
+ * given response, when it has them, each of them ending with "eol".
+ * Return the length of the headers.
+ */
+int format_page_headers(const struct response *res, char *buf, size_t size, const char *eol);
+
+/* Write headers and content of the given response with one writev() */
+int write_cgi_response(int fd, const struct response *res);
+
 #define MAX_DOMAIN_LENGTH 1024
 
 extern struct cgi_config {
@@ -20,6 +82,7 @@ int page_graph_main(int argc, char **argv);
 int page_about_main(int argc, char **argv);
 int page_player_main(int argc, char **argv);
 int page_search_main(int argc, char **argv);
+int page_suggest_main(int argc, char **argv);
 int page_rank_page_main(int argc, char **argv);
 int page_robots_main(int argc, char **argv);
 int page_sitemap_main(int argc, char **argv);
@@ -0,0 +1,481 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+
+#include "fastcgi.h"
+#include "cgi.h"
+
+/*
+ * See the FastCGI specification for the meaning of these constants.
+ * Only the responder role is implemented.
+ */
+#define FCGI_VERSION_1 1
+
+enum record_type {
+	FCGI_BEGIN_REQUEST = 1,
+	FCGI_ABORT_REQUEST,
+	FCGI_END_REQUEST,
+	FCGI_PARAMS,
+	FCGI_STDIN,
+	FCGI_STDOUT,
+	FCGI_STDERR,
+	FCGI_DATA,
+	FCGI_GET_VALUES,
+	FCGI_GET_VALUES_RESULT,
+	FCGI_UNKNOWN_TYPE
+};
+
+#define FCGI_RESPONDER 1
+#define FCGI_KEEP_CONN 1
+
+enum protocol_status {
+	FCGI_REQUEST_COMPLETE,
+	FCGI_CANT_MPX_CONN,
+	FCGI_OVERLOADED,
+	FCGI_UNKNOWN_ROLE
+};
+
+#define HEADER_SIZE 8
+#define MAX_CONTENT_LENGTH 65535
+#define MAX_PADDING_LENGTH 255
+
+struct record {
+	unsigned char type;
+	unsigned id;
+
+	size_t length;
+	unsigned char content[MAX_CONTENT_LENGTH + MAX_PADDING_LENGTH];
+};
+
+int fcgi_listen(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	assert(path != NULL);
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: Socket path too long\n", path);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return perror("socket()"), -1;
+
+	if (unlink(path) == -1 && errno != ENOENT)
+		goto fail;
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+		goto fail;
+	if (listen(fd, SOMAXCONN) == -1)
+		goto fail;
+
+	return fd;
+
+fail:
+	perror(path);
+	close(fd);
+	return -1;
+}
+
+int is_fcgi_socket(int fd)
+{
+	struct sockaddr_storage addr;
+	socklen_t length = sizeof(addr);
+
+	return getpeername(fd, (struct sockaddr*)&addr, &length) == -1
+		&& errno == ENOTCONN;
+}
+
+void init_fcgi_request(struct fcgi_request *req, int listen_fd)
+{
+	static const struct fcgi_request REQUEST_ZERO;
+
+	assert(req != NULL);
+
+	*req = REQUEST_ZERO;
+	req->listen_fd = listen_fd;
+	req->fd = -1;
+}
+
+static int read_full(int fd, void *buf, size_t size)
+{
+	unsigned char *ptr = buf;
+	ssize_t ret;
+
+	while (size) {
+		ret = read(fd, ptr, size);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		else if (ret == -1)
+			return perror("read(fastcgi)"), 0;
+		else if (ret == 0)
+			return 0;
+
+		ptr += ret;
+		size -= ret;
+	}
+
+	return 1;
+}
+
+static int read_record(int fd, struct record *rec)
+{
+	unsigned char header[HEADER_SIZE];
+
+	if (!read_full(fd, header, HEADER_SIZE))
+		return 0;
+
+	if (header[0] != FCGI_VERSION_1) {
+		fprintf(stderr, "fastcgi: Unsupported version %u\n", header[0]);
+		return 0;
+	}
+
+	rec->type = header[1];
+	rec->id = header[2] << 8 | header[3];
+	rec->length = header[4] << 8 | header[5];
+
+	return read_full(fd, rec->content, rec->length + header[6]);
+}
+
+static int write_record(
+	int fd, unsigned char type, unsigned id, const void *data, size_t length)
+{
+	unsigned char header[HEADER_SIZE];
+	struct iovec iov[2];
+
+	assert(length <= MAX_CONTENT_LENGTH);
+
+	header[0] = FCGI_VERSION_1;
+	header[1] = type;
+	header[2] = id >> 8;
+	header[3] = id & 0xff;
+	header[4] = length >> 8;
+	header[5] = length & 0xff;
+	header[6] = 0;
+	header[7] = 0;
+
+	iov[0].iov_base = header;
+	iov[0].iov_len = HEADER_SIZE;
+	iov[1].iov_base = (void*)data;
+	iov[1].iov_len = length;
+
+	if (!writev_full(fd, iov, 2))
+		return perror("write(fastcgi)"), 0;
+
+	return 1;
+}
+
+static int end_request(int fd, unsigned id, enum protocol_status status)
+{
+	unsigned char body[8] = { 0 };
+
+	body[4] = status;
+	return write_record(fd, FCGI_END_REQUEST, id, body, sizeof(body));
+}
+
+static unsigned char *put_pair(unsigned char *buf, const char *name, const char *value)
+{
+	size_t nlen = strlen(name), vlen = strlen(value);
+
+	assert(nlen < 128 && vlen < 128);
+
+	*buf++ = nlen;
+	*buf++ = vlen;
+	memcpy(buf, name, nlen);
+	memcpy(buf + nlen, value, vlen);
+
+	return buf + nlen + vlen;
+}
+
+/*
+ * Management records are not bound to any request.  Web servers may
+ * ask for our limits, which are always the same, so the names asked
+ * for are not even looked at.
+ */
+static int management_record(int fd, const struct record *rec)
+{
+	unsigned char buf[128], *end;
+
+	if (rec->type == FCGI_GET_VALUES) {
+		end = buf;
+		end = put_pair(end, "FCGI_MAX_CONNS", "1");
+		end = put_pair(end, "FCGI_MAX_REQS", "1");
+		end = put_pair(end, "FCGI_MPXS_CONNS", "0");
+		return write_record(fd, FCGI_GET_VALUES_RESULT, 0, buf, end - buf);
+	}
+
+	memset(buf, 0, 8);
+	buf[0] = rec->type;
+	return write_record(fd, FCGI_UNKNOWN_TYPE, 0, buf, 8);
+}
+
+static int begin_request(struct fcgi_request *req, const struct record *rec)
+{
+	unsigned role;
+
+	if (rec->length < 8) {
+		fprintf(stderr, "fastcgi: Truncated begin request record\n");
+		return 0;
+	}
+
+	/* Requests are not multiplexed */
+	if (req->id)
+		return end_request(req->fd, rec->id, FCGI_CANT_MPX_CONN);
+
+	role = rec->content[0] << 8 | rec->content[1];
+	if (role != FCGI_RESPONDER)
+		return end_request(req->fd, rec->id, FCGI_UNKNOWN_ROLE);
+
+	req->id = rec->id;
+	req->keep_conn = rec->content[2] & FCGI_KEEP_CONN;
+	req->params_length = 0;
+	req->pairs_length = 0;
+
+	return 1;
+}
+
+static int reserve(char **buf, size_t *size, size_t needed)
+{
+	size_t newsize;
+	char *tmp;
+
+	if (needed <= *size)
+		return 1;
+
+	newsize = *size ? *size : 1024;
+	while (newsize < needed)
+		newsize *= 2;
+
+	if (!(tmp = realloc(*buf, newsize)))
+		return perror("realloc(fastcgi)"), 0;
+
+	*buf = tmp;
+	*size = newsize;
+	return 1;
+}
+
+static const unsigned char *get_length(
+	const unsigned char *buf, const unsigned char *end, size_t *length)
+{
+	if (buf >= end)
+		return NULL;
+
+	if (!(*buf >> 7)) {
+		*length = *buf;
+		return buf + 1;
+	}
+
+	if (end - buf < 4)
+		return NULL;
+
+	*length = (size_t)(buf[0] & 0x7f) << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
+	return buf + 4;
+}
+
+/* Copy each name and value of raw params as nul terminated strings */
+static int parse_params(struct fcgi_request *req)
+{
+	const unsigned char *buf, *end;
+	size_t nlen, vlen;
+
+	buf = (unsigned char*)req->params;
+	end = buf + req->params_length;
+
+	while (buf < end) {
+		if (!(buf = get_length(buf, end, &nlen)))
+			goto invalid;
+		if (!(buf = get_length(buf, end, &vlen)))
+			goto invalid;
+		if (nlen > (size_t)(end - buf) || vlen > (size_t)(end - buf) - nlen)
+			goto invalid;
+
+		if (!reserve(&req->pairs, &req->pairs_size,
+		             req->pairs_length + nlen + vlen + 2))
+			return 0;
+
+		memcpy(req->pairs + req->pairs_length, buf, nlen);
+		req->pairs_length += nlen;
+		req->pairs[req->pairs_length++] = '\0';
+		buf += nlen;
+
+		memcpy(req->pairs + req->pairs_length, buf, vlen);
+		req->pairs_length += vlen;
+		req->pairs[req->pairs_length++] = '\0';
+		buf += vlen;
+	}
+
+	return 1;
+
+invalid:
+	fprintf(stderr, "fastcgi: Invalid name-value pair\n");
+	return 0;
+}
+
+/*
+ * Read records until the request parameters and its input are both
+ * complete.  Input is not used by any page, hence it is dropped.
+ */
+static int read_request(struct fcgi_request *req)
+{
+	static struct record rec;
+	int has_params = 0, has_stdin = 0;
+
+	req->id = 0;
+
+	while (read_record(req->fd, &rec)) {
+		if (rec.id == 0) {
+			if (!management_record(req->fd, &rec))
+				return 0;
+			continue;
+		}
+
+		if (rec.type == FCGI_BEGIN_REQUEST) {
+			if (!begin_request(req, &rec))
+				return 0;
+			continue;
+		}
+
+		/* Records of a request that have been refused or ended */
+		if (rec.id != req->id)
+			continue;
+
+		switch (rec.type) {
+		case FCGI_ABORT_REQUEST:
+			if (!end_request(req->fd, req->id, FCGI_REQUEST_COMPLETE))
+				return 0;
+			if (!req->keep_conn)
+				return 0;
+			req->id = 0;
+			has_params = has_stdin = 0;
+			break;
+
+		case FCGI_PARAMS:
+			if (rec.length == 0) {
+				if (!parse_params(req))
+					return 0;
+				has_params = 1;
+			} else {
+				if (!reserve(&req->params, &req->params_size,
+				             req->params_length + rec.length))
+					return 0;
+				memcpy(req->params + req->params_length, rec.content, rec.length);
+				req->params_length += rec.length;
+			}
+			break;
+
+		case FCGI_STDIN:
+			if (rec.length == 0)
+				has_stdin = 1;
+			break;
+		}
+
+		if (has_params && has_stdin)
+			return 1;
+	}
+
+	return 0;
+}
+
+int fcgi_accept(struct fcgi_request *req)
+{
+	assert(req != NULL);
+
+	for (;;) {
+		while (req->fd == -1) {
+			req->fd = accept(req->listen_fd, NULL, NULL);
+			if (req->fd == -1 && errno != EINTR && errno != ECONNABORTED)
+				return perror("accept()"), 0;
+		}
+
+		if (read_request(req))
+			return 1;
+
+		close(req->fd);
+		req->fd = -1;
+	}
+}
+
+const char *fcgi_getparam(const struct fcgi_request *req, const char *name)
+{
+	const char *pair, *end;
+
+	assert(req != NULL);
+	assert(name != NULL);
+
+	pair = req->pairs;
+	end = req->pairs + req->pairs_length;
+
+	while (pair < end) {
+		const char *value = pair + strlen(pair) + 1;
+
+		if (!strcmp(pair, name))
+			return value;
+
+		pair = value + strlen(value) + 1;
+	}
+
+	return NULL;
+}
+
+static void close_connection(struct fcgi_request *req)
+{
+	close(req->fd);
+	req->fd = -1;
+}
+
+int fcgi_write(struct fcgi_request *req, const void *data, size_t size)
+{
+	const unsigned char *ptr = data;
+	size_t length;
+
+	assert(req != NULL);
+	assert(data != NULL || size == 0);
+
+	if (req->fd == -1)
+		return 0;
+
+	/* An empty record would end the stream */
+	while (size) {
+		length = size < MAX_CONTENT_LENGTH ? size : MAX_CONTENT_LENGTH;
+
+		if (!write_record(req->fd, FCGI_STDOUT, req->id, ptr, length)) {
+			close_connection(req);
+			return 0;
+		}
+
+		ptr += length;
+		size -= length;
+	}
+
+	return 1;
+}
+
+int fcgi_finish(struct fcgi_request *req)
+{
+	assert(req != NULL);
+
+	if (req->fd == -1)
+		return 0;
+
+	if (!write_record(req->fd, FCGI_STDOUT, req->id, NULL, 0) ||
+	    !end_request(req->fd, req->id, FCGI_REQUEST_COMPLETE)) {
+		close_connection(req);
+		return 0;
+	}
+
+	req->id = 0;
+	if (!req->keep_conn)
+		close_connection(req);
+
+	return 1;
+}
@@ -0,0 +1,111 @@
+#ifndef FASTCGI_H
+#define FASTCGI_H
+
+/**
+ * @file fastcgi.h
+ *
+ * A minimal FastCGI responder, enough to serve requests from a web
+ * server like nginx.  Requests are served one at a time: connections
+ * are not multiplexed and request bodies are ignored.
+ *
+ *	struct fcgi_request req;
+ *
+ *	init_fcgi_request(&req, listen_fd);
+ *	while (fcgi_accept(&req)) {
+ *		path = fcgi_getparam(&req, "DOCUMENT_URI");
+ *		...
+ *		fcgi_write(&req, data, size);
+ *		fcgi_finish(&req);
+ *	}
+ */
+
+#include <stddef.h>
+
+struct fcgi_request {
+	int listen_fd;
+	int fd;
+
+	unsigned id;
+	int keep_conn;
+
+	/* Raw name-value pairs, as received */
+	char *params;
+	size_t params_length, params_size;
+
+	/* Name and value of each pair, both nul terminated */
+	char *pairs;
+	size_t pairs_length, pairs_size;
+};
+
+/**
+ * Create a Unix socket listening at the given path.  Any file already
+ * present at this path is removed first.
+ *
+ * @param path Path of the socket
+ *
+ * @return Listening socket, -1 on failure
+ */
+int fcgi_listen(const char *path);
+
+/**
+ * Check if the given file descriptor is a listening socket, which is
+ * how FastCGI process managers pass the socket to their children (on
+ * the standard input).
+ *
+ * @param fd File descriptor to check
+ *
+ * @return 1 if it is a listening socket, 0 otherwise
+ */
+int is_fcgi_socket(int fd);
+
+/**
+ * Initialize a request to be used with fcgi_accept().  Buffers are
+ * reused for every request accepted.
+ *
+ * @param req Request to initialize
+ * @param listen_fd Listening socket
+ */
+void init_fcgi_request(struct fcgi_request *req, int listen_fd);
+
+/**
+ * Wait for the next request, that is one whose parameters and input
+ * have been fully received.
+ *
+ * @param req Request, previous request must be finished
+ *
+ * @return 1 on success, 0 on failure
+ */
+int fcgi_accept(struct fcgi_request *req);
+
+/**
+ * Get the value of a parameter of the given request.
+ *
+ * @param req Request
+ * @param name Name of the parameter
+ *
+ * @return Value of the parameter, NULL if it is not set
+ */
+const char *fcgi_getparam(const struct fcgi_request *req, const char *name);
+
+/**
+ * Send data to the standard output of the given request.
+ *
+ * @param req Request
+ * @param data Data to send
+ * @param size Size of data
+ *
+ * @return 1 on success, 0 on failure
+ */
+int fcgi_write(struct fcgi_request *req, const void *data, size_t size);
+
+/**
+ * End the given request, and close the connection unless the web
+ * server asked to keep it open.
+ *
+ * @param req Request
+ *
+ * @return 1 on success, 0 on failure
+ */
+int fcgi_finish(struct fcgi_request *req);
+
+#endif /* FASTCGI_H */
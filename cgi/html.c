@@ -4,6 +4,7 @@
 #include <stdarg.h>
 
 #include "html.h"
+#include "cgi.h"
 
 #ifdef NDEBUG
 void html(const char *fmt, ...)
@@ -11,7 +12,7 @@ void html(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	vprintf(fmt, ap);
+	vfprintf(page_out, fmt, ap);
 	va_end(ap);
 }
 
@@ -20,7 +21,7 @@ void xml(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	vprintf(fmt, ap);
+	vfprintf(page_out, fmt, ap);
 	va_end(ap);
 }
 
@@ -29,7 +30,7 @@ void svg(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	vprintf(fmt, ap);
+	vfprintf(page_out, fmt, ap);
 	va_end(ap);
 }
 
@@ -38,7 +39,7 @@ void css(const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-	vprintf(fmt, ap);
+	vfprintf(page_out, fmt, ap);
 	va_end(ap);
 }
 
@@ -55,10 +56,10 @@ static void print(const char *fmt, va_list ap)
 	unsigned i;
 
 	for (i = 0; i < indent; i++)
-		putchar('\t');
+		fputc('\t', page_out);
 
-	vprintf(fmt, ap);
-	putchar('\n');
+	vfprintf(page_out, fmt, ap);
+	fputc('\n', page_out);
 }
 
 static void _xml(const char *fmt, va_list ap)
@@ -64,5 +64,6 @@ int page_clan_main(int argc, char **argv)
 	html_end_player_list();
 	html_footer();
 
+	free_clan(&clan);
 	return EXIT_SUCCESS;
 }
@@ -28,6 +28,12 @@
 
 typedef long (*to_long_t)(const void *data);
 
+/*
+ * Aggregated records also have a range of values, return 0 when the
+ * given data is not aggregated.
+ */
+typedef int (*to_range_t)(const void *data, long *min, long *max);
+
 static long elo_to_long(const void *data)
 {
 	return (long)((const struct player_record*)(data))->elo;
@@ -43,8 +49,40 @@ static long rank_to_long(const void *data)
 	return (long)rank;
 }
 
+static int elo_to_range(const void *data, long *min, long *max)
+{
+	const struct player_record *rec = data;
+
+	*min = rec->min_elo;
+	*max = rec->max_elo;
+	return rec->tier != RAW_RECORD;
+}
+
+static int rank_to_range(const void *data, long *min, long *max)
+{
+	const struct player_record *rec = data;
+
+	*min = rec->min_rank > LONG_MAX ? LONG_MAX : (long)rec->min_rank;
+	*max = rec->max_rank > LONG_MAX ? LONG_MAX : (long)rec->max_rank;
+	return rec->tier != RAW_RECORD;
+}
+
+/* Aggregated records cover a whole day or week, show that in labels */
+static const char *time_format(const void *data)
+{
+	switch (((const struct player_record*)(data))->tier) {
+	case DAILY_RECORD:
+		return "%d %b";
+	case WEEKLY_RECORD:
+		return "Week %W, %Y";
+	default:
+		return "%d %b %H:%M";
+	}
+}
+
 struct curve {
 	to_long_t to_long;
+	to_range_t to_range;
 	int reversed;
 	const char *color, *hover_color;
 	const char *name;
@@ -99,7 +137,8 @@ static long find_data(
 	assert(graph->first != NULL);
 
 	ret = to_long(record_data(graph->hist, graph->first));
-	for (rec = graph->first->next; rec; rec = rec->next) {
+	for (rec = next_record(graph->hist, graph->first); rec;
+	     rec = next_record(graph->hist, rec)) {
 		long data = to_long(record_data(graph->hist, rec));
 
 		if (cmp(data, ret))
@@ -179,9 +218,9 @@ static struct graph init_graph(struct historic *hist)
 
 	graph.hist = hist;
 
-	for (nrecords = 1, rec = hist->last;
-	     nrecords < MAX_POINTS && rec->prev;
-	     nrecords++, rec = rec->prev)
+	for (nrecords = 1, rec = last_record(hist);
+	     nrecords < MAX_POINTS && prev_record(hist, rec);
+	     nrecords++, rec = prev_record(hist, rec))
 		;
 
 	graph.nrecords = nrecords;
@@ -218,7 +257,7 @@ static void scale_curve(struct curve *curve, unsigned old_naxes, unsigned new_na
 }
 
 static void add_curve(
-	struct graph *graph, to_long_t to_long, int reversed,
+	struct graph *graph, to_long_t to_long, to_range_t to_range, int reversed,
 	const char *color, const char *hover_color, const char *name)
 {
 	struct curve *curve;
@@ -230,6 +269,7 @@ static void add_curve(
 	graph->ncurves++;
 
 	curve->to_long = to_long;
+	curve->to_range = to_range;
 	curve->reversed = reversed;
 	curve->color = color;
 	curve->hover_color = hover_color;
@@ -317,7 +357,8 @@ static float x_coord(
 	float range, value;
 
 	range = graph->nrecords - 1;
-	value = record - graph->first;
+	value = record_index(graph->hist, record)
+		- record_index(graph->hist, graph->first);
 
 	return pad_x(graph, percentage(range, value, 1));
 }
@@ -421,7 +462,7 @@ static void print_path(struct graph *graph, struct curve *curve)
 
 	/* No need to create a class for a single element */
 	svg("<path style=\"fill: none; stroke: %s; stroke-width: 3px;\" d=\"", curve->color);
-	for (rec = graph->first; rec; rec = rec->next) {
+	for (rec = graph->first; rec; rec = next_record(graph->hist, rec)) {
 		struct point p;
 		char c;
 
@@ -479,6 +520,7 @@ static const char *point_label_pos(
 	 * enforced to make it sure it is inside svg rendering area.
 	 */
 	if (p.x > 100.0 - X_MARGIN) {
+		struct record *prev = prev_record(graph->hist, record);
 		long prev_data;
 
 		if (p.y > 100.0 - Y_MARGIN)
@@ -486,16 +528,17 @@ static const char *point_label_pos(
 		else if (p.y < Y_MARGIN)
 			return bottom_left;
 
-		if (!record->prev)
+		if (!prev)
 			return bottom_left;
 
-		prev_data = curve->to_long(record_data(graph->hist, record->prev));
+		prev_data = curve->to_long(record_data(graph->hist, prev));
 
 		if (prev_data > data)
 			return bottom_left;
 		else
 			return top_left;
 	} else {
+		struct record *next = next_record(graph->hist, record);
 		long next_data;
 
 		if (p.y > 100.0 - Y_MARGIN)
@@ -503,10 +546,10 @@ static const char *point_label_pos(
 		else if (p.y < Y_MARGIN)
 			return bottom_right;
 
-		if (!record->next)
+		if (!next)
 			return bottom_right;
 
-		next_data = curve->to_long(record_data(graph->hist, record->next));
+		next_data = curve->to_long(record_data(graph->hist, next));
 
 		if (next_data > data)
 			return bottom_right;
@@ -529,7 +572,7 @@ static void print_zone(struct graph *graph, struct record *rec, struct point p)
 	if (rec == graph->first) {
 		zone_start = 0.0;
 		zone_width = pad_x(graph, 0.0) + gap / 2.0;
-	} else if (rec == graph->hist->last) {
+	} else if (rec == last_record(graph->hist)) {
 		zone_start = p.x - gap / 2.0;
 		zone_width = pad_x(graph, 100.0) + gap / 2.0;
 	} else {
@@ -542,12 +585,20 @@ static void print_zone(struct graph *graph, struct record *rec, struct point p)
 }
 
 static void print_label(
-	struct point p, long data, const char *label_pos, unsigned curve_index)
+	struct curve *curve, struct point p, const void *data,
+	const char *label_pos, unsigned curve_index)
 {
+	long min, max;
+
 	svg("<circle class=\"curve%u_hover\" cx=\"%.1f%%\" cy=\"%.1f%%\" r=\"4\"/>",
 	    curve_index, p.x, p.y);
-	svg("<text class=\"%s\" x=\"%.1f%%\" y=\"%.1f%%\">%ld</text>",
-	    label_pos, p.x, p.y, data);
+
+	if (curve->to_range(data, &min, &max))
+		svg("<text class=\"%s\" x=\"%.1f%%\" y=\"%.1f%%\">%ld (%ld - %ld)</text>",
+		    label_pos, p.x, p.y, curve->to_long(data), min, max);
+	else
+		svg("<text class=\"%s\" x=\"%.1f%%\" y=\"%.1f%%\">%ld</text>",
+		    label_pos, p.x, p.y, curve->to_long(data));
 }
 
 static void print_labels(struct graph *graph)
@@ -556,7 +607,7 @@ static void print_labels(struct graph *graph)
 	const char *label_pos;
 	unsigned i;
 
-	for (rec = graph->first; rec; rec = rec->next) {
+	for (rec = graph->first; rec; rec = next_record(graph->hist, rec)) {
 		char buf[128];
 		struct point p;
 		long data;
@@ -576,10 +627,11 @@ static void print_labels(struct graph *graph)
 			p = init_point(graph, curve, rec);
 			data = curve->to_long(record_data(graph->hist, rec));
 			label_pos = point_label_pos(graph, curve, rec, data, p);
-			print_label(p, data, label_pos, i);
+			print_label(curve, p, record_data(graph->hist, rec), label_pos, i);
 		}
 
-		strftime(buf, sizeof(buf), "%d %b %H:%M", gmtime(&rec->time));
+		strftime(buf, sizeof(buf), time_format(record_data(graph->hist, rec)),
+		         gmtime(&rec->time));
 
 		if (p.x > 88.0)
 			class = "right";
@@ -609,7 +661,7 @@ static void print_point(
 	 * Too much points in a curve reduce readability, above 24
 	 * points, don't draw them anymore.
 	 */
-	if (record == graph->hist->last || graph->nrecords <= 24)
+	if (record == last_record(graph->hist) || graph->nrecords <= 24)
 		svg("<circle class=\"curve%u\" cx=\"%.1f%%\" cy=\"%.1f%%\" r=\"4\"/>",
 		    curve - graph->curves, p.x, p.y);
 }
@@ -623,8 +675,8 @@ static void print_points(struct graph *graph, struct curve *curve)
 	svg("<!-- Points -->");
 	svg("<g>");
 
-	for (rec = graph->first; rec; rec = rec->next) {
-		if (rec->prev)
+	for (rec = graph->first; rec; rec = next_record(graph->hist, rec)) {
+		if (prev_record(graph->hist, rec))
 			svg("");
 		print_point(graph, curve, rec);
 	}
@@ -653,7 +705,7 @@ static void print_name(struct graph *graph, struct curve *curve)
 		x = 0.0;
 		class = "left";
 	} else {
-		rec = graph->hist->last;
+		rec = last_record(graph->hist);
 		x = 100.0;
 		class = "right";
 	}
@@ -814,7 +866,10 @@ end:
 
 int page_graph_main(int argc, char **argv)
 {
-	struct player player;
+	const struct historic_query query = { 0, 0, MAX_POINTS };
+	/* Historic buffers are kept for the next request */
+	static struct player player;
+	static int is_player_initialized;
 	char *name;
 	struct graph graph;
 	enum read_player_ret ret;
@@ -831,17 +886,20 @@ int page_graph_main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
-	init_player(&player);
+	if (!is_player_initialized) {
+		init_player(&player);
+		is_player_initialized = 1;
+	}
 
-	ret = read_player(&player, name);
+	ret = read_player_query(&player, name, &query);
 	if (ret == PLAYER_NOT_FOUND)
 		return EXIT_NOT_FOUND;
 	else if (ret == PLAYER_ERROR)
 		return EXIT_FAILURE;
 
 	graph = init_graph(&player.hist);
-	add_curve(&graph, elo_to_long, 0, "#970", "#725800", "Elo");
-	add_curve(&graph, rank_to_long, 1, "#aaa", "#888", "Rank");
+	add_curve(&graph, elo_to_long, elo_to_range, 0, "#970", "#725800", "Elo");
+	add_curve(&graph, rank_to_long, rank_to_range, 1, "#aaa", "#888", "Rank");
 	print_graph(&graph);
 
 	return EXIT_SUCCESS;
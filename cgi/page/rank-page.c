@@ -3,87 +3,91 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
-#include <dirent.h>
 #include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "cgi.h"
 #include "config.h"
 #include "html.h"
 #include "player.h"
+#include "ranks.h"
+#include "generation.h"
 
 struct page {
 	unsigned pnum, npages;
-	unsigned i;
+	unsigned i, length;
 
-	FILE *file;
+	struct rank_entry entries[PLAYERS_PER_PAGE];
 };
 
-#define PLAYERS_PER_PAGE 100
-
+/*
+ * Only entries of the given page are read from the ranks file of the
+ * current generation, see ranks.h.
+ */
 static int load_page(struct page *page, unsigned pnum)
 {
-	static char path[PATH_MAX];
-	unsigned nplayers, npages;
-	int ret;
-	FILE *file;
+	char *path;
+	unsigned npages;
+	uint32_t nplayers;
+	off_t offset;
+	ssize_t ret;
+	int fd;
 
 	assert(page != NULL);
 
-	ret = snprintf(path, PATH_MAX, "%s/ranks", config.root);
-	if (ret >= PATH_MAX) {
-		fprintf(stderr, "snprintf(path, %d): Too long\n", PATH_MAX);
+	if (!(path = current_file("ranks"))) {
+		if (errno == ENOENT)
+			fprintf(stderr, "%s: Ranks have never been computed\n", config.root);
 		return EXIT_FAILURE;
 	}
 
-	if (!(file = fopen(path, "r"))) {
+	if ((fd = open(path, O_RDONLY)) == -1) {
 		perror(path);
 		return EXIT_FAILURE;
 	}
 
 	/* First, read header */
-	if (fscanf(file, "%u players\n", &nplayers) != 1) {
+	if (read(fd, &nplayers, sizeof(nplayers)) != sizeof(nplayers)) {
 		fprintf(stderr, "%s: No header\n", path);
-		return EXIT_FAILURE;
+		goto fail;
 	}
 
 	npages = nplayers / PLAYERS_PER_PAGE + 1;
 	if (pnum > npages) {
 		fprintf(stderr, "Only %u pages available\n", npages);
+		close(fd);
 		return EXIT_NOT_FOUND;
 	}
 
-	if (fseek(file, HEXNAME_LENGTH * (pnum - 1) * PLAYERS_PER_PAGE, SEEK_CUR) == -1) {
-		perror("fseek()");
-		return EXIT_FAILURE;
+	offset = sizeof(nplayers) + (off_t)(pnum - 1) * sizeof(page->entries);
+	if ((ret = pread(fd, page->entries, sizeof(page->entries), offset)) == -1) {
+		perror(path);
+		goto fail;
 	}
 
+	close(fd);
+
 	page->npages = npages;
 	page->pnum = pnum;
-	page->file = file;
+	page->length = ret / sizeof(*page->entries);
 
 	return EXIT_SUCCESS;
-}
 
-static void free_page(struct page *page)
-{
-	fclose(page->file);
+fail:
+	close(fd);
+	return EXIT_FAILURE;
 }
 
 static struct player_summary *next_player(struct page *page)
 {
-	char name[HEXNAME_LENGTH];
-
-	while (page->i < PLAYERS_PER_PAGE) {
+	while (page->i < page->length) {
 		static struct player_summary player;
+		unsigned rank;
 
-		if (fscanf(page->file, " %s", name) != 1)
-			break;
-
-		page->i++;
-
-		if (!is_valid_hexname(name))
-			continue;
-		if (read_player_summary(&player, name) != PLAYER_FOUND)
+		rank = (page->pnum - 1) * PLAYERS_PER_PAGE + page->i + 1;
+		if (!get_rank_entry(&page->entries[page->i++], rank, &player))
 			continue;
 
 		return &player;
@@ -158,18 +162,20 @@ enum mode {
 	FULL_PAGE, ONLY_ROWS
 };
 
-static enum mode parse_mode(const char *str)
+static int parse_mode(const char *str, enum mode *mode)
 {
 	assert(str != NULL);
 
 	if (!strcmp(str, "full-page"))
-		return FULL_PAGE;
+		*mode = FULL_PAGE;
 	else if (!strcmp(str, "only-rows"))
-		return ONLY_ROWS;
+		*mode = ONLY_ROWS;
 	else {
 		fprintf(stderr, "First argument must be either \"full-page\" or \"only-rows\"\n");
-		exit(EXIT_FAILURE);
+		return EXIT_FAILURE;
 	}
+
+	return EXIT_SUCCESS;
 }
 
 static int parse_page_number(const char *str, unsigned *page_number)
@@ -211,7 +217,9 @@ int page_rank_page_main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
-	mode = parse_mode(argv[1]);
+	ret = parse_mode(argv[1], &mode);
+	if (ret != EXIT_SUCCESS)
+		return ret;
 
 	ret = parse_page_number(argv[2], &page_number);
 	if (ret != EXIT_SUCCESS)
@@ -235,7 +243,5 @@ int page_rank_page_main(int argc, char **argv)
 		html_footer();
 	}
 
-	free_page(&page);
-
 	return EXIT_SUCCESS;
 }
@@ -5,6 +5,6 @@
 
 int page_robots_main(int argc, char **argv)
 {
-	printf("Sitemap: http://%s/sitemap.xml\n", cgi_config.domain);
+	fprintf(page_out, "Sitemap: http://%s/sitemap.xml\n", cgi_config.domain);
 	return EXIT_SUCCESS;
 }
@@ -1,15 +1,21 @@
 #include <stdlib.h>
 #include <stdio.h>
-#include <dirent.h>
 #include <errno.h>
 #include <string.h>
 #include <limits.h>
 #include <assert.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "config.h"
 #include "html.h"
 #include "player.h"
+#include "ranks.h"
+#include "trigrams.h"
+#include "prefixes.h"
+#include "generation.h"
 
 /*
  * Too much results is meanless, so by limiting the number of results we can
@@ -18,44 +24,25 @@
 #define MAX_RESULTS 50
 
 /*
- * Result contains the player struct because we sort result by relevance and ELO,
- * so we need to store player's data at some point.
- *
- * Results are linked together, so that way, removing or adding a result is
- * almost a O(1).
+ * Results are ordered by relevance then by rank, which candidates come
+ * with, so comparing them never reads anything.  The rest of the
+ * summary is loaded once results are selected, when it is not given.
  */
 struct result {
-	char name[HEXNAME_LENGTH];
-	int relevance;
+	unsigned relevance;
 
 	int is_loaded;
 	struct player_summary player;
-
-	struct result *next, *prev;
 };
 
 /*
- * The pool just act as a storage for the element of the linked-list. Results
- * are sorted by their relevance.
- *
- * The pool does contain one extra result to avoid an extra copy when adding
- * a new result.  The adding process is as follow:
- *   - Get a temporary result (the extra result pointed by "free")
- *   - If it belongs to the list, just link it
- *   - If it does not, do nothing
- *
- * The list maintain a pointer to the last result so we can avoid searching
- * when the result's relevance is lower than last result relevance.  And also because
- * when the list is full and we want to add a new result, we then remove the
- * last one.
+ * Best results are kept in a heap whose root is the worst of them, so
+ * that a new candidate only has to be compared with the root to know
+ * if it is worth adding.
  */
-struct list {
+struct heap {
 	unsigned length;
-	struct result pool[MAX_RESULTS + 1];
-	struct result *free;
-
-	struct result *first;
-	struct result *last;
+	struct result results[MAX_RESULTS];
 };
 
 static void to_lowercase(char *src, char *dst)
@@ -72,17 +59,13 @@ static void to_lowercase(char *src, char *dst)
 
 /*
  * The higher the relevance is, the better the name match the query. A relevance of
- * zero means the result will be ignored.
+ * zero means the result will be ignored.  Both the name and the query
+ * are lowercased raw names.
  */
-static unsigned get_relevance(char *hex, char *query)
+static unsigned get_relevance(const char *name, const char *query)
 {
 	unsigned relevance;
-	char *tmp;
-	char name[NAME_LENGTH];
-
-	/* Lowercase the name to have case insensitive search */
-	hexname_to_name(hex, name);
-	to_lowercase(name, name);
+	const char *tmp;
 
 	if (!(tmp = strstr(name, query)))
 		return 0;
@@ -104,188 +87,306 @@ static unsigned get_relevance(char *hex, char *query)
 	return relevance;
 }
 
-static void init_list(struct list *list)
+/* Relevance of the given hexname, lowercased for case insensitive search */
+static unsigned get_hexname_relevance(const char *hex, const char *query)
 {
-	list->length = 0;
-	list->first = NULL;
-	list->last = NULL;
-	list->free = &list->pool[0];
+	char name[NAME_LENGTH];
+
+	hexname_to_name(hex, name);
+	to_lowercase(name, name);
+	return get_relevance(name, query);
 }
 
-static int is_empty(struct list *list)
+/* Most relevant first, then best ranked, unranked players coming last */
+static int cmp_results(const struct result *a, const struct result *b)
 {
-	return list->length == 0;
+	if (a->relevance < b->relevance)
+		return -1;
+	else if (a->relevance > b->relevance)
+		return 1;
+
+	if (a->player.rank == b->player.rank)
+		return 0;
+	else if (a->player.rank == UNRANKED)
+		return -1;
+	else if (b->player.rank == UNRANKED)
+		return 1;
+
+	return a->player.rank > b->player.rank ? -1 : 1;
 }
 
-static int is_full(struct list *list)
+static void swap_results(struct result *a, struct result *b)
 {
-	return list->length == MAX_RESULTS;
+	struct result tmp = *a;
+	*a = *b;
+	*b = tmp;
 }
 
-/*
- * Just use the list->free pointer and initialize it.
- */
-static struct result *new_result(struct list *list, unsigned relevance, char *name)
+static void sift_up(struct heap *heap, unsigned i)
+{
+	struct result *r = heap->results;
+
+	while (i > 0 && cmp_results(&r[i], &r[(i - 1) / 2]) < 0) {
+		swap_results(&r[i], &r[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+}
+
+static void sift_down(struct heap *heap, unsigned i)
 {
-	list->free->relevance = relevance;
-	strcpy(list->free->name, name);
-	list->free->is_loaded = 0;
-	return list->free;
+	struct result *r = heap->results;
+	unsigned child;
+
+	while ((child = 2 * i + 1) < heap->length) {
+		if (child + 1 < heap->length && cmp_results(&r[child + 1], &r[child]) < 0)
+			child++;
+		if (cmp_results(&r[child], &r[i]) >= 0)
+			break;
+
+		swap_results(&r[i], &r[child]);
+		i = child;
+	}
+}
+
+/* Whether a candidate with the given relevance and rank would be kept */
+static int is_worth_adding(struct heap *heap, unsigned relevance, unsigned rank)
+{
+	struct result result;
+
+	if (relevance == 0)
+		return 0;
+	if (heap->length < MAX_RESULTS)
+		return 1;
+
+	result.relevance = relevance;
+	result.player.rank = rank;
+	return cmp_results(&heap->results[0], &result) < 0;
 }
 
 /*
- * Insert 'result' before 'target'.  Remove the last result if the list is full.
- * If target is NULL, insert the result at the end of the list.
+ * The player is loaded later when its summary is not complete, which
+ * is told by is_loaded.
  */
-static void insert_before(struct list *list, struct result *target, struct result *result)
+static void add_result(
+	struct heap *heap, unsigned relevance,
+	const struct player_summary *player, int is_loaded)
 {
-	assert(list != NULL);
-	assert(result != NULL);
-
-	if (!target) {
-		if (is_empty(list)) {
-			/* First result in the list */
-			result->prev = NULL;
-			result->next = NULL;
-			list->first = result;
-			list->last = result;
-		} else {
-			/* Append the result */
-			result->prev = list->last;
-			result->next = NULL;
-			list->last->next = result;
-			list->last = result;
-		}
-	} else {
-		/* Insert before target */
-		result->prev = target->prev;
-		result->next = target;
-		target->prev = result;
-
-		if (target == list->first) {
-			list->first = result;
-			result->prev = NULL;
-		} else {
-			result->prev->next = result;
-		}
-	}
+	struct result *result;
 
-	/* Update the list->free pointer */
-	if (is_full(list)) {
-		list->free = list->last;
-		list->last = list->last->prev;
-		list->last->next = NULL;
-	} else {
-		list->length++;
-		list->free = &list->pool[list->length];
-	}
+	if (!is_worth_adding(heap, relevance, player->rank))
+		return;
+
+	if (heap->length < MAX_RESULTS)
+		result = &heap->results[heap->length++];
+	else
+		result = &heap->results[0];
+
+	result->relevance = relevance;
+	result->player = *player;
+	result->is_loaded = is_loaded;
+
+	if (result == &heap->results[0])
+		sift_down(heap, 0);
+	else
+		sift_up(heap, heap->length - 1);
 }
 
-static void try_load_result(struct result *result)
+static int cmp_sorted_results(const void *a, const void *b)
 {
-	if (!result->is_loaded) {
-		enum read_player_ret ret;
+	return cmp_results(b, a);
+}
 
-		ret = read_player_summary(&result->player, result->name);
+struct search {
+	struct heap *heap;
+	char query[NAME_LENGTH];
+};
 
-		if (ret == PLAYER_FOUND)
-			result->is_loaded = 1;
+/* Read the summary of the player of the given rank from the ranks file */
+static int read_ranked_player(
+	int fd, const char *path, unsigned rank, struct player_summary *player)
+{
+	struct rank_entry entry;
+	off_t offset;
+	ssize_t ret;
+
+	offset = sizeof(uint32_t) + (off_t)(rank - 1) * sizeof(entry);
+	if ((ret = pread(fd, &entry, sizeof(entry), offset)) != sizeof(entry)) {
+		if (ret == -1)
+			perror(path);
+		else
+			fprintf(stderr, "%s: No rank %u\n", path, rank);
+		return -1;
 	}
+
+	return get_rank_entry(&entry, rank, player);
 }
 
-static int cmp_results(struct result *a, struct result *b)
+/*
+ * Without any index, the rank of candidates comes from their file,
+ * read once before adding them.
+ */
+static int add_player(const char *name, void *data)
 {
-	if (a->relevance < b->relevance)
-		return -1;
-	else if (a->relevance > b->relevance)
+	static struct player_summary player;
+	struct search *search = data;
+	unsigned relevance;
+
+	relevance = get_hexname_relevance(name, search->query);
+	if (relevance == 0)
 		return 1;
 
-	try_load_result(a);
-	try_load_result(b);
+	if (read_player_summary(&player, name) == PLAYER_FOUND)
+		add_result(search->heap, relevance, &player, 1);
+	return 1;
+}
 
-	if (a->player.rank > b->player.rank)
-		return -1;
-	else if (a->player.rank < b->player.rank)
+/*
+ * Candidates given by the trigrams index are checked one by one, in
+ * the order of their rank.  Their summary comes from the ranks file of
+ * the same generation, so player files are never read.
+ */
+static int search_trigrams(struct search *search, const struct trigrams *trigrams)
+{
+	static struct player_summary player;
+	struct trigrams_query tq;
+	unsigned rank;
+	char *path;
+	int fd, ret;
+
+	if (!init_trigrams_query(trigrams, search->query, &tq))
 		return 1;
 
-	return 0;
+	if (!(path = current_file("ranks")))
+		return 0;
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return perror(path), 0;
+
+	while (next_candidate(&tq, &rank)) {
+		if ((ret = read_ranked_player(fd, path, rank, &player)) == -1) {
+			close(fd);
+			return 0;
+		} else if (ret == 0) {
+			continue;
+		}
+
+		add_result(
+			search->heap, get_hexname_relevance(player.name, search->query),
+			&player, 1);
+	}
+
+	close(fd);
+	return 1;
 }
 
-static void try_add_result(struct list *list, unsigned relevance, char *name)
+/*
+ * Queries shorter than a trigram go through every name of the prefixes
+ * index, which are already lowercased and come with their rank.  Only
+ * the name and the rank of candidates are known, the rest of their
+ * summary is loaded from the ranks file once they are selected.
+ */
+static void search_prefixes(struct search *search, const struct prefixes *prefixes)
 {
-	struct result *result, *r;
-
-	assert(list != NULL);
+	static struct player_summary player;
+	const struct prefix_entry *entry, *end;
+	char key[NAME_LENGTH], name[NAME_LENGTH];
+	unsigned relevance;
 
-	if (relevance == 0)
-		return;
+	key[sizeof(entry->key)] = '\0';
+	name[sizeof(entry->name)] = '\0';
 
-	result = new_result(list, relevance, name);
+	end = prefixes->entries + prefixes->length;
+	for (entry = prefixes->entries; entry < end; entry++) {
+		memcpy(key, entry->key, sizeof(entry->key));
+		relevance = get_relevance(key, search->query);
 
-	if (is_empty(list))
-		return insert_before(list, NULL, result);
+		if (!is_worth_adding(search->heap, relevance, entry->rank))
+			continue;
 
-	/*
-	 * We know the list is not empty and therefor list->last is set.
-	 * If the list is not full just add the result at the end.
-	 */
-	if (cmp_results(list->last, result) > 0) {
-		if (!is_full(list))
-			insert_before(list, NULL, result);
-		return;
+		memcpy(name, entry->name, sizeof(entry->name));
+		name_to_hexname(name, player.name);
+		player.rank = entry->rank;
+		add_result(search->heap, relevance, &player, 0);
 	}
-
-	/*
-	 * Insert the result in a sorted manner
-	 */
-	for (r = list->first; r; r = r->next)
-		if (cmp_results(r, result) < 0)
-			break;
-	insert_before(list, r, result);
 }
 
-static int search(char *query, struct list *list)
+/*
+ * Databases whose ranks have not been computed since the indexes exist
+ * need to go through every player.
+ */
+static int search(char *query, struct heap *heap)
 {
-	DIR *dir;
-	struct dirent *dp;
-	static char path[PATH_MAX];
-	char lowercase_query[NAME_LENGTH];
+	struct search search;
+	struct trigrams trigrams;
+	struct prefixes prefixes;
+	char *path;
+	int ret;
 
 	assert(strlen(query) < NAME_LENGTH);
 
-	if (snprintf(path, PATH_MAX, "%s/players", config.root) >= PATH_MAX) {
-		fprintf(stderr, "Path to teerank database too long\n");
-		return 0;
+	to_lowercase(query, search.query);
+	search.heap = heap;
+	heap->length = 0;
+
+	if (strlen(query) >= 3 && (path = current_file("trigrams"))) {
+		if (map_trigrams(&trigrams, path)) {
+			ret = search_trigrams(&search, &trigrams);
+			unmap_trigrams(&trigrams);
+			return ret;
+		} else if (errno != ENOENT) {
+			return 0;
+		}
 	}
 
-	if (!(dir = opendir(path))) {
-		fprintf(stderr, "opendir(%s): %s\n", path, strerror(errno));
-		return 0;
+	if ((path = current_file("prefixes"))) {
+		if (map_prefixes(&prefixes, path)) {
+			search_prefixes(&search, &prefixes);
+			unmap_prefixes(&prefixes);
+			return 1;
+		} else if (errno != ENOENT) {
+			return 0;
+		}
 	}
 
-	to_lowercase(query, lowercase_query);
-	init_list(list);
+	return walk_players(add_player, &search);
+}
 
-	while ((dp = readdir(dir))) {
-		unsigned relevance;
+/* Complete the summary of results that only have a name and a rank */
+static int load_results(struct heap *heap)
+{
+	struct result *result;
+	char *path = NULL;
+	int fd = -1, ret = 1;
+	unsigned i;
 
-		if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+	for (i = 0; i < heap->length; i++) {
+		result = &heap->results[i];
+		if (result->is_loaded)
 			continue;
 
-		relevance = get_relevance(dp->d_name, lowercase_query);
-		try_add_result(list, relevance, dp->d_name);
+		if (fd == -1) {
+			if (!(path = current_file("ranks")))
+				return 0;
+			if ((fd = open(path, O_RDONLY)) == -1)
+				return perror(path), 0;
+		}
+
+		/* Players whose name can't be found are not shown */
+		if ((ret = read_ranked_player(fd, path, result->player.rank, &result->player)) == -1)
+			break;
+		result->is_loaded = ret;
 	}
 
-	closedir(dir);
-	return 1;
+	if (fd != -1)
+		close(fd);
+	return ret != -1;
 }
 
-static struct list LIST_ZERO;
+static struct heap heap;
 
 int page_search_main(int argc, char **argv)
 {
-	struct list list = LIST_ZERO;
 	size_t length;
+	unsigned i;
 
 	if (argc != 2) {
 		fprintf(stderr, "usage: %s <query>\n", argv[0]);
@@ -293,26 +394,29 @@ int page_search_main(int argc, char **argv)
 	}
 
 	/* No need to search when the query is too long or empty */
+	heap.length = 0;
 	length = strlen(argv[1]);
 	if (length > 0 && length < NAME_LENGTH) {
-		if (!search(argv[1], &list))
+		if (!search(argv[1], &heap))
+			return EXIT_FAILURE;
+		if (!load_results(&heap))
 			return EXIT_FAILURE;
 	}
 
+	/* Only then sort results, from the best to the worst */
+	qsort(heap.results, heap.length, sizeof(*heap.results), cmp_sorted_results);
+
 	CUSTOM_TAB.name = "Search results";
 	CUSTOM_TAB.href = "";
 	html_header(&CUSTOM_TAB, "Search results", argv[1]);
 
-	if (list.length == 0) {
+	if (heap.length == 0) {
 		html("No players found");
 	} else {
-		struct result *result;
-
 		html_start_player_list();
-		for (result = list.first; result; result = result->next) {
-			try_load_result(result);
-			html_print_player(&result->player, 1);
-		}
+		for (i = 0; i < heap.length; i++)
+			if (heap.results[i].is_loaded)
+				html_print_player(&heap.results[i].player, 1);
 		html_end_player_list();
 	}
 
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+
+#include "cgi.h"
+#include "hexname.h"
+#include "prefixes.h"
+#include "generation.h"
+
+/* Enough to fill a drop-down list below the search field */
+#define MAX_SUGGESTIONS 10
+
+/*
+ * Length of the UTF-8 sequence starting the given string, 0 if it is
+ * not a valid one: overlong forms, surrogates and code points above
+ * U+10FFFF are not valid.
+ */
+static size_t utf8_length(const unsigned char *str, size_t length)
+{
+	unsigned char min = 0x80, max = 0xbf;
+	size_t n, i;
+
+	if (str[0] < 0x80)
+		return 1;
+	else if (str[0] >= 0xc2 && str[0] <= 0xdf)
+		n = 2;
+	else if (str[0] >= 0xe0 && str[0] <= 0xef)
+		n = 3;
+	else if (str[0] >= 0xf0 && str[0] <= 0xf4)
+		n = 4;
+	else
+		return 0;
+
+	if (str[0] == 0xe0)
+		min = 0xa0;
+	else if (str[0] == 0xed)
+		max = 0x9f;
+	else if (str[0] == 0xf0)
+		min = 0x90;
+	else if (str[0] == 0xf4)
+		max = 0x8f;
+
+	if (n > length || str[1] < min || str[1] > max)
+		return 0;
+	for (i = 2; i < n; i++)
+		if (str[i] < 0x80 || str[i] > 0xbf)
+			return 0;
+
+	return n;
+}
+
+/*
+ * Names are output as they are, except for what JSON strings can't
+ * hold.  Names can be in any encoding, bytes that are not valid UTF-8
+ * are replaced by U+FFFD.
+ */
+static void json_string(const char *str, size_t length)
+{
+	const unsigned char *s = (const unsigned char*)str;
+	size_t i, n;
+
+	/* Names are nul terminated when shorter than the given length */
+	for (n = 0; n < length && s[n]; n++)
+		;
+	length = n;
+
+	putc('"', page_out);
+	for (i = 0; i < length; i += n) {
+		unsigned char c = s[i];
+
+		n = 1;
+		if (c == '"' || c == '\\')
+			fprintf(page_out, "\\%c", c);
+		else if (c < 0x20 || c == 0x7f)
+			fprintf(page_out, "\\u%04x", c);
+		else if ((n = utf8_length(s + i, length - i)))
+			fwrite(s + i, 1, n, page_out);
+		else {
+			fputs("\\ufffd", page_out);
+			n = 1;
+		}
+	}
+	putc('"', page_out);
+}
+
+int page_suggest_main(int argc, char **argv)
+{
+	const struct prefix_entry *results[MAX_SUGGESTIONS];
+	struct prefixes prefixes;
+	char hexname[HEXNAME_LENGTH];
+	char name[NAME_LENGTH];
+	unsigned i, n = 0;
+	char *path;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <prefix>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!(path = current_file("prefixes")))
+		return EXIT_FAILURE;
+
+	/* The index comes with ranks, there is nothing to suggest before */
+	if (!map_prefixes(&prefixes, path)) {
+		if (errno != ENOENT)
+			return EXIT_FAILURE;
+		fputs("[]\n", page_out);
+		return EXIT_SUCCESS;
+	}
+
+	/* Suggesting the whole ranking is of no help */
+	if (*argv[1])
+		n = find_prefix(&prefixes, argv[1], results, MAX_SUGGESTIONS);
+
+	putc('[', page_out);
+	for (i = 0; i < n; i++) {
+		memcpy(name, results[i]->name, sizeof(results[i]->name));
+		name[sizeof(results[i]->name)] = '\0';
+		name_to_hexname(name, hexname);
+
+		if (i)
+			putc(',', page_out);
+		fputs("{\"name\":", page_out);
+		json_string(name, sizeof(results[i]->name));
+		fprintf(page_out, ",\"hexname\":\"%s\",\"rank\":%u}",
+		        hexname, (unsigned)results[i]->rank);
+	}
+	fputs("]\n", page_out);
+
+	unmap_prefixes(&prefixes);
+
+	return EXIT_SUCCESS;
+}
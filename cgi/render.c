@@ -0,0 +1,586 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "route.h"
+#include "cgi.h"
+#include "dict.h"
+#include "generation.h"
+#include "cache.h"
+#include "gzip.h"
+
+static const struct cgi_config CGI_CONFIG_DEFAULT = {
+	"teerank.com", "80"
+};
+
+struct cgi_config cgi_config;
+
+/*
+ * Pages are rendered in memory, so that nothing is sent when a page
+ * fails, and so that the length of the content is known before sending
+ * it.  The buffer is reused from one page to another.
+ */
+FILE *page_out;
+static char *page_data;
+static size_t page_size;
+
+/* Compressed pages are written here before replacing the page */
+static FILE *gzip_out;
+static char *gzip_data;
+static size_t gzip_size;
+
+/*
+ * Errors printed by a page are shown in place of the page when it
+ * fails.  Pages and the core print them on stderr, hence it is
+ * redirected to a temporary file while the page is generated.
+ */
+static FILE *page_errors;
+
+/*
+ * State of the page being rendered by render_page().  Errors jump back
+ * to it, so that long lived processes can render the next page.
+ */
+static get_param_func_t get_param_func;
+static void *get_param_data;
+static struct response *response;
+static jmp_buf request_end;
+static int is_rendering;
+
+const char *reason_phrase(int code)
+{
+	switch (code) {
+	case 200: return "OK";
+	case 304: return "Not Modified";
+	case 400: return "Bad Request";
+	case 404: return "Not Found";
+	case 414: return "Request-URI Too Long";
+	case 500: return "Internal Server Error";
+	default:  return "";
+	}
+}
+
+/* Discard page content and start an error page instead */
+static void start_error_page(int code)
+{
+	rewind(page_out);
+	fprintf(page_out, "<h1>%d %s</h1>\n", code, reason_phrase(code));
+
+	response->status = code;
+	response->content_type = "text/html";
+	response->etag = NULL;
+	response->last_modified = NULL;
+	response->content_encoding = NULL;
+	response->has_variants = 0;
+}
+
+static void end_page(void)
+{
+	if (fflush(page_out) == EOF) {
+		perror("fflush(page)");
+		page_size = 0;
+	}
+
+	response->body = page_data;
+	response->length = page_size;
+
+	/* Not modified pages have no content at all */
+	if (response->status == 304)
+		response->length = 0;
+}
+
+void error(int code, char *fmt, ...)
+{
+	va_list ap;
+
+	if (fmt) {
+		va_start(ap, fmt);
+		vfprintf(stderr, fmt, ap);
+		va_end(ap);
+	} else {
+		fprintf(stderr, "%d %s\n", code, reason_phrase(code));
+	}
+
+	if (!is_rendering)
+		exit(EXIT_FAILURE);
+
+	start_error_page(code);
+	if (fmt) {
+		va_start(ap, fmt);
+		vfprintf(page_out, fmt, ap);
+		va_end(ap);
+	}
+
+	longjmp(request_end, 1);
+}
+
+/* Show errors printed by the failed page, and log them as well */
+static void dump_errors(int code)
+{
+	char buf[4096];
+	size_t ret;
+
+	start_error_page(code);
+
+	rewind(page_errors);
+	while ((ret = fread(buf, 1, sizeof(buf), page_errors))) {
+		fwrite(buf, 1, ret, page_out);
+		fwrite(buf, 1, ret, stderr);
+	}
+}
+
+static const char *get_param(const char *name)
+{
+	return get_param_func(name, get_param_data);
+}
+
+static int page_argc(struct page *page)
+{
+	unsigned i;
+
+	for (i = 0; i < MAX_ARGS && page->args[i]; i++)
+		;
+
+	return i;
+}
+
+/*
+ * Pages are cached by arguments, and by domain since a few of them
+ * contain absolute URLs.  The ETag of their source, when they have
+ * one, is part of the key as well: player files are updated within a
+ * generation, and the body must stay the one the ETag was given for.
+ */
+static char *cache_key(struct page *page, int is_gzip)
+{
+	static char key[PATH_MAX];
+	size_t length = 0;
+	unsigned i;
+	int ret;
+
+	for (i = 0; i < MAX_ARGS && page->args[i]; i++) {
+		ret = snprintf(key + length, sizeof(key) - length, "%s ", page->args[i]);
+		if (ret < 0 || (size_t)ret >= sizeof(key) - length)
+			return NULL;
+		length += ret;
+	}
+
+	ret = snprintf(key + length, sizeof(key) - length, "@%s%s%s%s",
+	               cgi_config.domain, is_gzip ? " gzip" : "",
+	               response->etag ? " " : "", response->etag ? response->etag : "");
+	if (ret < 0 || (size_t)ret >= sizeof(key) - length)
+		return NULL;
+
+	return key;
+}
+
+/* Whether "gzip" is in the given Accept-Encoding, with a non-zero quality */
+static int accepts_gzip(const char *value)
+{
+	size_t length;
+
+	while (value && *value) {
+		value += strspn(value, " \t,");
+		length = strcspn(value, " \t,;");
+
+		if (length == 4 && !strncasecmp(value, "gzip", 4)) {
+			value += length + strspn(value + length, " \t");
+			if (*value != ';')
+				return 1;
+
+			value += 1 + strspn(value + 1, " \t");
+			if (strncasecmp(value, "q=", 2))
+				return 1;
+			return strtod(value + 2, NULL) > 0;
+		}
+
+		value += strcspn(value, ",");
+	}
+
+	return 0;
+}
+
+/* Replace the page by its compressed version */
+static int compress_page(void)
+{
+	if (fflush(page_out) == EOF)
+		return perror("fflush(page)"), 0;
+
+	rewind(gzip_out);
+	if (!gzip(gzip_out, page_data, page_size))
+		return 0;
+	if (fflush(gzip_out) == EOF)
+		return perror("fflush(gzip)"), 0;
+
+	rewind(page_out);
+	fwrite(gzip_data, 1, gzip_size, page_out);
+	return 1;
+}
+
+/*
+ * Source files are replaced rather than modified, hence a new inode or
+ * modification time means a new page.  The version is part of the ETag
+ * because pages may change with it.
+ */
+static int set_validators(struct page *page, int is_gzip)
+{
+	static char etag[64], last_modified[64];
+	struct stat st;
+	char *path;
+
+	if (!page->source || !(path = page->source(page)))
+		return 0;
+	if (stat(path, &st) == -1)
+		return 0;
+
+	sprintf(etag, "\"%lx-%lx-%d.%d%s\"",
+	        (unsigned long)st.st_ino, (unsigned long)st.st_mtime,
+	        TEERANK_VERSION, TEERANK_SUBVERSION, is_gzip ? "-gzip" : "");
+	strftime(last_modified, sizeof(last_modified),
+	         "%a, %d %b %Y %H:%M:%S GMT", gmtime(&st.st_mtime));
+
+	response->etag = etag;
+	response->last_modified = last_modified;
+	return 1;
+}
+
+/*
+ * If-Modified-Since is only used without If-None-Match, and like nginx
+ * does by default, it must exactly match our Last-Modified: clients
+ * send back what they received, so dates are not even parsed.
+ */
+static int is_not_modified(void)
+{
+	const char *tmp;
+
+	if ((tmp = get_param("HTTP_IF_NONE_MATCH")))
+		return !strcmp(tmp, "*") || strstr(tmp, response->etag);
+	if ((tmp = get_param("HTTP_IF_MODIFIED_SINCE")))
+		return !strcmp(tmp, response->last_modified);
+
+	return 0;
+}
+
+/*
+ * Cacheable pages are compressed once and then served from the cache,
+ * others are never compressed since it would be done on every request.
+ */
+static void generate(struct page *page)
+{
+	char *key = NULL;
+	int stderr_save;
+	int is_gzip;
+	int ret;
+
+	assert(page != NULL);
+
+	is_gzip = page->is_cacheable && accepts_gzip(get_param("HTTP_ACCEPT_ENCODING"));
+	response->has_variants = page->is_cacheable;
+
+	if (set_validators(page, is_gzip) && is_not_modified()) {
+		response->status = 304;
+		response->content_type = page->content_type;
+		return;
+	}
+
+	if (page->is_cacheable && (key = cache_key(page, is_gzip))) {
+		if (read_cached_page(key, page_out)) {
+			response->status = 200;
+			response->content_type = page->content_type;
+			response->content_encoding = is_gzip ? "gzip" : NULL;
+			return;
+		}
+		rewind(page_out);
+	}
+
+	verbose("Generating data with '%s'\n", page->args[0]);
+
+	/*
+	 * Errors of the previous page are dropped, and stderr is
+	 * replaced by the errors file until the page is generated.
+	 */
+	if (ftruncate(fileno(page_errors), 0) == -1)
+		error(500, "ftruncate(errors): %s\n", strerror(errno));
+	rewind(page_errors);
+
+	fflush(stderr);
+	if ((stderr_save = dup(STDERR_FILENO)) == -1)
+		error(500, "dup(err): %s\n", strerror(errno));
+	if (dup2(fileno(page_errors), STDERR_FILENO) == -1) {
+		close(stderr_save);
+		error(500, "dup2(err): %s\n", strerror(errno));
+	}
+
+	/* Run page generation */
+	ret = page->main(page_argc(page), page->args);
+
+	fflush(stderr);
+	if (dup2(stderr_save, STDERR_FILENO) == -1)
+		perror("dup2(err, save)");
+	close(stderr_save);
+
+	if (ret == EXIT_SUCCESS) {
+		response->status = 200;
+		response->content_type = page->content_type;
+
+		/* Fall back on the uncompressed page, with its own ETag */
+		if (is_gzip && !compress_page()) {
+			response->etag = NULL;
+			response->last_modified = NULL;
+			set_validators(page, 0);
+			return;
+		}
+
+		if (key) {
+			fflush(page_out);
+			write_cached_page(key, page_data, page_size);
+		}
+		if (is_gzip)
+			response->content_encoding = "gzip";
+	} else if (ret == EXIT_NOT_FOUND) {
+		dump_errors(404);
+	} else {
+		dump_errors(500);
+	}
+}
+
+static char *get_path(void)
+{
+	static char path[PATH_MAX];
+	const char *tmp;
+
+	if (!(tmp = get_param("PATH_INFO")) && !(tmp = get_param("DOCUMENT_URI")))
+		error(500, "PATH_INFO or DOCUMENT_URI not set\n");
+
+	/* Parameters cannot be modified so we have to copy them */
+	if (*stpncpy(path, tmp, PATH_MAX) != '\0')
+		error(414, NULL);
+
+	return path;
+}
+
+static char *get_query(void)
+{
+	static char query[PATH_MAX];
+	const char *tmp;
+
+	if (!(tmp = get_param("QUERY_STRING"))) {
+		*query = '\0';
+		return query;
+	}
+
+	/* Parameters cannot be modified so we have to copy them */
+	if (*stpncpy(query, tmp, PATH_MAX) != '\0')
+		error(414, NULL);
+
+	return query;
+}
+
+static void load_cgi_config(void)
+{
+	const char *tmp, *port = NULL;
+	int ret;
+
+	cgi_config = CGI_CONFIG_DEFAULT;
+
+	if ((tmp = get_param("SERVER_NAME")))
+		cgi_config.name = tmp;
+	if ((tmp = get_param("SERVER_PORT")))
+		cgi_config.port = tmp;
+
+	if (!cgi_config.name)
+		fprintf(stderr, "Warning, SERVER_NAME not set, defaulting to \"teerank.com\"\n");
+
+	if (strcmp(cgi_config.port, "80") != 0)
+		port = cgi_config.port;
+
+	ret = snprintf(
+		cgi_config.domain, MAX_DOMAIN_LENGTH, "%s%s%s",
+		cgi_config.name, port ? ":" : "", port ? port : "");
+
+	if (ret >= MAX_DOMAIN_LENGTH)
+		error(414, "%s: Server name too long", cgi_config.name);
+}
+
+/* Create buffers once, they are reused for every page */
+static int init_buffers(void)
+{
+	if (!page_out && !(page_out = open_memstream(&page_data, &page_size)))
+		return perror("open_memstream()"), 0;
+
+	if (!page_errors && !(page_errors = tmpfile()))
+		return perror("tmpfile()"), 0;
+
+	if (!gzip_out && !(gzip_out = open_memstream(&gzip_data, &gzip_size)))
+		return perror("open_memstream(gzip)"), 0;
+
+	return 1;
+}
+
+int render_page(struct response *res, get_param_func_t func, void *data)
+{
+	int ret = 1;
+
+	assert(res != NULL);
+	assert(func != NULL);
+
+	response = res;
+	get_param_func = func;
+	get_param_data = data;
+
+	res->status = 500;
+	res->content_type = "text/html";
+	res->etag = NULL;
+	res->last_modified = NULL;
+	res->content_encoding = NULL;
+	res->has_variants = 0;
+	res->body = "";
+	res->length = 0;
+
+	if (!init_buffers())
+		return 0;
+	rewind(page_out);
+
+	/*
+	 * Long lived processes render many pages, each of them must use
+	 * the latest ranks and see the latest players.
+	 */
+	unpin_generation();
+	reload_players_bloom();
+
+	is_rendering = 1;
+	if (!setjmp(request_end)) {
+		/*
+		 * A lot of page doesn't use cgi_config structure.  We
+		 * still load it because that way a mis-configuration are
+		 * catched as soon as possible.
+		 */
+		load_cgi_config();
+		generate(do_route(get_path(), get_query()));
+	} else {
+		ret = 0;
+	}
+	is_rendering = 0;
+
+	end_page();
+	return ret;
+}
+
+int writev_full(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t ret;
+
+	while (iovcnt) {
+		if ((ret = writev(fd, iov, iovcnt)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+
+		while (iovcnt && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt) {
+			iov->iov_base = (char*)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 1;
+}
+
+int format_page_headers(const struct response *res, char *buf, size_t size, const char *eol)
+{
+	int ret, length = 0;
+
+	assert(res != NULL);
+	assert(buf != NULL);
+	assert(eol != NULL);
+	assert(size > 0);
+
+	*buf = '\0';
+
+	if (res->etag) {
+		ret = snprintf(buf, size, "ETag: %s%sLast-Modified: %s%s",
+		               res->etag, eol, res->last_modified, eol);
+		assert(ret >= 0 && (size_t)ret < size);
+		length += ret;
+	}
+
+	if (res->content_encoding && res->status != 304) {
+		ret = snprintf(buf + length, size - length, "Content-Encoding: %s%s",
+		               res->content_encoding, eol);
+		assert(ret >= 0 && (size_t)ret < size - length);
+		length += ret;
+	}
+
+	if (res->has_variants) {
+		ret = snprintf(buf + length, size - length, "Vary: Accept-Encoding%s", eol);
+		assert(ret >= 0 && (size_t)ret < size - length);
+		length += ret;
+	}
+
+	return length;
+}
+
+int format_cgi_headers(const struct response *res, char *buf, size_t size)
+{
+	int ret, length;
+
+	assert(res != NULL);
+	assert(buf != NULL);
+
+	if (res->status == 200)
+		ret = snprintf(buf, size, "Content-Type: %s\n", res->content_type);
+	else if (res->status == 304)
+		ret = snprintf(buf, size, "Status: 304 %s\n", reason_phrase(304));
+	else
+		ret = snprintf(
+			buf, size, "Content-Type: %s\nStatus: %d %s\n",
+			res->content_type, res->status, reason_phrase(res->status));
+
+	assert(ret >= 0 && (size_t)ret < size);
+	length = ret;
+
+	length += format_page_headers(res, buf + length, size - length, "\n");
+
+	/* A 304 must not have a Content-Length, unless it is the full one */
+	if (res->status == 304)
+		ret = snprintf(buf + length, size - length, "\n");
+	else
+		ret = snprintf(buf + length, size - length, "Content-Length: %lu\n\n",
+		               (unsigned long)res->length);
+
+	assert(ret >= 0 && (size_t)ret < size - length);
+	return length + ret;
+}
+
+int write_cgi_response(int fd, const struct response *res)
+{
+	char headers[MAX_HEADERS_LENGTH];
+	struct iovec iov[2];
+
+	assert(res != NULL);
+
+	iov[0].iov_base = headers;
+	iov[0].iov_len = format_cgi_headers(res, headers, sizeof(headers));
+	iov[1].iov_base = (char*)res->body;
+	iov[1].iov_len = res->length;
+
+	if (!writev_full(fd, iov, 2))
+		return perror("writev(response)"), 0;
+
+	return 1;
+}
@@ -10,6 +10,8 @@
 #include "config.h"
 #include "route.h"
 #include "cgi.h"
+#include "player.h"
+#include "generation.h"
 
 struct arg {
 	char *name;
@@ -112,20 +114,31 @@ static void init_page_about(struct page *page, struct url *url)
 {
 }
 
+/* Filename without its extension, filenames like "..." have none */
+static char *get_basename(struct url *url)
+{
+	char *basename;
+
+	if (!(basename = strtok(url->filename, ".")))
+		error(404, NULL);
+
+	return basename;
+}
+
 static void init_page_rank_page(struct page *page, struct url *url)
 {
 	page->args[1] = "full-page";
-	page->args[2] = strtok(url->filename, ".");
+	page->args[2] = get_basename(url);
 }
 
 static void init_page_clan(struct page *page, struct url *url)
 {
-	page->args[1] = strtok(url->filename, ".");
+	page->args[1] = get_basename(url);
 }
 
 static void init_page_player(struct page *page, struct url *url)
 {
-	page->args[1] = strtok(url->filename, ".");
+	page->args[1] = get_basename(url);
 }
 
 static void init_page_graph(struct page *page, struct url *url)
@@ -145,6 +158,11 @@ static void init_page_search(struct page *page, struct url *url)
 	page->args[1] = url->args[0].val;
 }
 
+static void init_page_suggest(struct page *page, struct url *url)
+{
+	init_page_search(page, url);
+}
+
 static void init_page_robots(struct page *page, struct url *url)
 {
 }
@@ -153,32 +171,50 @@ static void init_page_sitemap(struct page *page, struct url *url)
 {
 }
 
-#define PAGE_HTML(filename, pagename) {                                 \
-	filename, { "teerank-page-" #pagename }, "text/html",           \
-	init_page_##pagename, page_##pagename##_main                    \
-}
-#define PAGE_TXT(filename, pagename) {                                  \
-	filename, { "teerank-page-" #pagename }, "text/plain",          \
-	init_page_##pagename, page_##pagename##_main                    \
+/*
+ * Ranks files are never modified, each generation has its own, so it
+ * changes whenever ranks are computed.
+ */
+static char *generation_source(struct page *page)
+{
+	return current_file("ranks");
 }
-#define PAGE_XML(filename, pagename) {                                  \
-	filename, { "teerank-page-" #pagename }, "text/xml",            \
-	init_page_##pagename, page_##pagename##_main                    \
+
+/* Player files are replaced whenever the player is updated */
+static char *player_source(struct page *page)
+{
+	if (!page->args[1] || !is_valid_hexname(page->args[1]))
+		return NULL;
+	return get_player_path(page->args[1]);
 }
-#define PAGE_SVG(filename, pagename) {                                  \
-	filename, { "teerank-page-" #pagename }, "image/svg+xml",       \
-	init_page_##pagename, page_##pagename##_main                    \
+
+#define PAGE(filename, pagename, content_type, is_cacheable, source) {  \
+	filename, { "teerank-page-" #pagename }, content_type,          \
+	is_cacheable, source, init_page_##pagename, page_##pagename##_main \
 }
+#define PAGE_HTML(filename, pagename) \
+	PAGE(filename, pagename, "text/html", 1, generation_source)
+#define PAGE_TXT(filename, pagename) \
+	PAGE(filename, pagename, "text/plain", 1, generation_source)
+#define PAGE_XML(filename, pagename) \
+	PAGE(filename, pagename, "text/xml", 1, generation_source)
 
 static const struct directory root = {
 	"", (struct page[]) {
 		PAGE_HTML("about.html", about),
-		PAGE_HTML("search", search),
+		/* There are too many possible queries to cache them */
+		PAGE("search", search, "text/html", 0, NULL),
 		PAGE_TXT("robots.txt", robots),
 		PAGE_XML("sitemap.xml", sitemap),
 		{ NULL }
 	}, (struct directory[]) {
 		{
+			/* Suggestions only change with ranks */
+			"search", (struct page[]) {
+				PAGE("suggest", suggest, "application/json", 0, generation_source),
+				{ NULL }
+			}, NULL
+		}, {
 			"pages", (struct page[]) {
 				PAGE_HTML(NULL, rank_page),
 				{ NULL }
@@ -190,12 +226,12 @@ static const struct directory root = {
 			}, NULL
 		}, {
 			"players", (struct page[]) {
-				PAGE_HTML(NULL, player),
+				PAGE(NULL, player, "text/html", 1, player_source),
 				{ NULL }
 			}, (struct directory[]) {
 				{
 					NULL, (struct page[]) {
-						PAGE_SVG("elo+rank.svg", graph),
+						PAGE("elo+rank.svg", graph, "image/svg+xml", 1, player_source),
 						{ NULL }
 					}, NULL
 				}
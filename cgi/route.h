@@ -7,6 +7,7 @@ struct url;
 struct page;
 typedef	void (*init_func_t)(struct page *page, struct url *url);
 typedef	 int (*page_func_t)(int argc, char **argv);
+typedef	char *(*source_func_t)(struct page *page);
 
 struct page {
 	char *name;
@@ -14,6 +15,15 @@ struct page {
 
 	const char *content_type;
 
+	/* Cacheable pages only depend on their arguments and the database */
+	int is_cacheable;
+
+	/*
+	 * Path of the file the page is built from, if any.  Its inode
+	 * and modification time are used as page validators.
+	 */
+	source_func_t source;
+
 	init_func_t init;
 	page_func_t main;
 };
@@ -0,0 +1,225 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "config.h"
+
+static char *get_path(void)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s/deltas", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+/*
+ * The archive is opened once for all with O_APPEND, and each entry is
+ * written with a single write() so that entries are never interleaved.
+ */
+static int write_entry(const void *buf, size_t size)
+{
+	static int fd = -1;
+	char *path;
+	ssize_t ret;
+
+	if (!(path = get_path()))
+		return 0;
+
+	if (fd == -1) {
+		fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0666);
+		if (fd == -1)
+			return perror(path), 0;
+	}
+
+	ret = write(fd, buf, size);
+	if (ret == -1)
+		return perror(path), 0;
+	else if (ret != size)
+		return fprintf(stderr, "%s: Entry partially written\n", path), 0;
+
+	return 1;
+}
+
+static void pack_name(const char *hex, char *buf)
+{
+	char name[NAME_LENGTH];
+
+	/* Unused bytes must be zeroed */
+	memset(name, 0, sizeof(name));
+	hexname_to_name(hex, name);
+	memcpy(buf, name, NAME_LENGTH - 1);
+}
+
+static void unpack_name(const char *buf, char *hex)
+{
+	char name[NAME_LENGTH];
+
+	memcpy(name, buf, NAME_LENGTH - 1);
+	name[NAME_LENGTH - 1] = '\0';
+	name_to_hexname(name, hex);
+}
+
+int archive_delta(struct delta *delta, time_t time)
+{
+	struct {
+		struct archive_header header;
+		struct archive_player players[MAX_PLAYERS];
+	} entry;
+	unsigned i;
+
+	assert(delta != NULL);
+	assert(delta->length <= MAX_PLAYERS);
+
+	memset(&entry, 0, sizeof(entry));
+
+	entry.header.time = time;
+	entry.header.elapsed = delta->elapsed;
+	entry.header.length = delta->length;
+
+	for (i = 0; i < delta->length; i++) {
+		struct archive_player *player = &entry.players[i];
+
+		pack_name(delta->players[i].name, player->name);
+		pack_name(delta->players[i].clan, player->clan);
+		player->score = delta->players[i].score;
+		player->delta = delta->players[i].delta;
+	}
+
+	return write_entry(&entry, sizeof(entry.header)
+	                   + delta->length * sizeof(*entry.players));
+}
+
+int archive_cycle(time_t time)
+{
+	struct archive_header header;
+
+	memset(&header, 0, sizeof(header));
+	header.time = time;
+
+	return write_entry(&header, sizeof(header));
+}
+
+int open_archive(struct archive *archive)
+{
+	struct stat st;
+	char *path;
+	void *map;
+	int fd;
+
+	assert(archive != NULL);
+
+	if (!(path = get_path()))
+		return 0;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return perror(path), 0;
+
+	if (fstat(fd, &st) == -1) {
+		perror(path);
+		close(fd);
+		return 0;
+	}
+
+	archive->map = NULL;
+	archive->size = st.st_size;
+	archive->offset = 0;
+
+	/* mmap() does not accept a zero length */
+	if (archive->size == 0) {
+		close(fd);
+		return 1;
+	}
+
+	map = mmap(NULL, archive->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return perror(path), 0;
+
+	/* We are going to read the whole archive sequentially */
+	posix_madvise(map, archive->size, POSIX_MADV_SEQUENTIAL);
+
+	archive->map = map;
+	return 1;
+}
+
+int next_archived_delta(struct archive *archive, struct delta *delta, time_t *time)
+{
+	struct archive_header header;
+	const char *ptr;
+	unsigned i;
+
+	assert(archive != NULL);
+	assert(delta != NULL);
+	assert(time != NULL);
+
+	if (archive->offset == archive->size)
+		return 0;
+
+	if (archive->size - archive->offset < sizeof(header))
+		goto truncated;
+
+	/* Entries are not aligned in the archive */
+	ptr = archive->map + archive->offset;
+	memcpy(&header, ptr, sizeof(header));
+	ptr += sizeof(header);
+
+	if (header.length > MAX_PLAYERS) {
+		fprintf(stderr, "%s: Entry at offset %lu has %u players, maximum is %u\n",
+		        get_path(), (unsigned long)archive->offset,
+		        (unsigned)header.length, MAX_PLAYERS);
+		return 0;
+	}
+
+	if (archive->size - archive->offset - sizeof(header)
+	    < header.length * sizeof(struct archive_player))
+		goto truncated;
+
+	*time = header.time;
+	delta->elapsed = header.elapsed;
+	delta->length = header.length;
+
+	for (i = 0; i < header.length; i++) {
+		struct archive_player player;
+
+		memcpy(&player, ptr, sizeof(player));
+		ptr += sizeof(player);
+
+		unpack_name(player.name, delta->players[i].name);
+		unpack_name(player.clan, delta->players[i].clan);
+		delta->players[i].score = player.score;
+		delta->players[i].delta = player.delta;
+	}
+
+	archive->offset = ptr - archive->map;
+	return 1;
+
+truncated:
+	fprintf(stderr, "%s: Truncated entry at offset %lu\n",
+	        get_path(), (unsigned long)archive->offset);
+	return 0;
+}
+
+void close_archive(struct archive *archive)
+{
+	assert(archive != NULL);
+
+	if (archive->map)
+		munmap((void*)archive->map, archive->size);
+
+	archive->map = NULL;
+	archive->size = 0;
+	archive->offset = 0;
+}
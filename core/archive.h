@@ -0,0 +1,105 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+/**
+ * @file archive.h
+ *
+ * Deltas are consumed once by teerank-update-players and then lost.
+ * To be able to rate players again from scratch (after an elo formula
+ * change or a corruption for instance), every delta is also appended
+ * to a binary archive, "$TEERANK_ROOT/deltas".
+ *
+ * The archive is a sequence of entries.  Each entry is a fixed size
+ * header followed by "length" fixed size players, hence the archive
+ * can be memory-mapped and walked without any parsing.  Entries with
+ * no players at all mark the beginning of a new update cycle.
+ *
+ * Integers are stored in host byte order: archives are not meant to be
+ * portable across architectures.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "delta.h"
+
+struct archive_header {
+	uint64_t time;
+	int32_t elapsed;
+	uint32_t length;
+};
+
+/*
+ * Names are stored as regular strings, not hex strings, which halve
+ * their size.  They are not nul terminated when they are 16 bytes long.
+ */
+struct archive_player {
+	char name[NAME_LENGTH - 1];
+	char clan[NAME_LENGTH - 1];
+	int32_t score;
+	int32_t delta;
+};
+
+/**
+ * Append the given delta to the archive.
+ *
+ * @param delta Delta to archive
+ * @param time Time at wich the delta have been computed
+ *
+ * @return 1 on success, 0 on failure
+ */
+int archive_delta(struct delta *delta, time_t time);
+
+/**
+ * Mark the beginning of a new update cycle in the archive.
+ *
+ * @param time Time at wich the update cycle started
+ *
+ * @return 1 on success, 0 on failure
+ */
+int archive_cycle(time_t time);
+
+/**
+ * @struct archive
+ *
+ * A read-only, memory-mapped, archive.
+ */
+struct archive {
+	const char *map;
+	size_t size;
+	size_t offset;
+};
+
+/**
+ * Map the archive in memory, ready to be walked with
+ * next_archived_delta().
+ *
+ * @param archive Archive to open
+ *
+ * @return 1 on success, 0 on failure
+ */
+int open_archive(struct archive *archive);
+
+/**
+ * Read the next delta in the archive.
+ *
+ * A delta with a length of 0 is a cycle marker.
+ *
+ * @param archive Archive to read the delta from
+ * @param delta Delta to be filled
+ * @param time Time at wich the delta have been computed
+ *
+ * @return 1 on success, 0 on end of archive or when the archive is
+ *         truncated
+ */
+int next_archived_delta(struct archive *archive, struct delta *delta, time_t *time);
+
+/**
+ * Unmap the given archive.
+ *
+ * @param archive Archive to close
+ */
+void close_archive(struct archive *archive);
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "bloom.h"
+
+/*
+ * About 1% of false positives with 10 bits per key and 7 hashes.  The
+ * number of bits is rounded up to a power of two, hence the actual
+ * rate is lower until the number of keys grows beyond the expected one.
+ */
+#define BITS_PER_KEY 10
+#define NHASHES 7
+#define MIN_BITS (1u << 16)
+#define MAX_BITS (1u << 31)
+
+#define HEADER_SIZE (2 * sizeof(uint32_t))
+
+/* Finalizer of MurmurHash3, used to derive a second hash */
+static uint32_t mix(uint32_t h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+/*
+ * Bit positions are given by double hashing, h1 + i * h2.  h2 is odd,
+ * so that positions are distinct given the power of two modulus.
+ */
+#define for_each_bit(bloom, hash, i, bit, h2)                           \
+	for (i = 0, h2 = mix(hash) | 1, bit = (hash) & ((bloom)->nbits - 1); \
+	     i < (bloom)->nhashes;                                          \
+	     i++, bit = ((hash) + i * h2) & ((bloom)->nbits - 1))
+
+static void set_header(struct bloom *bloom)
+{
+	memcpy(bloom->data, &bloom->nbits, sizeof(uint32_t));
+	memcpy(bloom->data + sizeof(uint32_t), &bloom->nhashes, sizeof(uint32_t));
+	bloom->bits = bloom->data + HEADER_SIZE;
+}
+
+/* Read and check the header at the start of the given data */
+static int read_header(const unsigned char *data, uint32_t *nbits,
+                       uint32_t *nhashes, const char *path)
+{
+	memcpy(nbits, data, sizeof(uint32_t));
+	memcpy(nhashes, data + sizeof(uint32_t), sizeof(uint32_t));
+
+	if (*nbits < 8 || (*nbits & (*nbits - 1)) || *nbits > MAX_BITS ||
+	    *nhashes == 0 || *nhashes > 32) {
+		fprintf(stderr, "%s: Invalid bloom filter header\n", path);
+		return 0;
+	}
+
+	return 1;
+}
+
+int create_bloom(struct bloom *bloom, unsigned nkeys)
+{
+	uint32_t nbits = MIN_BITS;
+
+	assert(bloom != NULL);
+
+	while (nbits < MAX_BITS && nbits / BITS_PER_KEY < nkeys)
+		nbits *= 2;
+
+	bloom->nbits = nbits;
+	bloom->nhashes = NHASHES;
+	bloom->size = HEADER_SIZE + nbits / 8;
+	bloom->is_mapped = 0;
+	bloom->is_writable = 1;
+
+	if (!(bloom->data = calloc(1, bloom->size)))
+		return perror("calloc(bloom)"), 0;
+
+	set_header(bloom);
+	return 1;
+}
+
+int map_bloom(struct bloom *bloom, const char *path, int writable)
+{
+	struct stat st;
+	void *map;
+	int fd, prot;
+
+	assert(bloom != NULL);
+	assert(path != NULL);
+
+	if ((fd = open(path, writable ? O_RDWR : O_RDONLY)) == -1) {
+		if (errno != ENOENT)
+			perror(path);
+		return 0;
+	}
+
+	if (fstat(fd, &st) == -1) {
+		perror(path);
+		close(fd);
+		return 0;
+	}
+
+	if ((size_t)st.st_size < HEADER_SIZE) {
+		fprintf(stderr, "%s: Truncated bloom filter\n", path);
+		close(fd);
+		return 0;
+	}
+
+	prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+	map = mmap(NULL, st.st_size, prot, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return perror(path), 0;
+
+	bloom->data = map;
+	bloom->size = st.st_size;
+	bloom->is_mapped = 1;
+	bloom->is_writable = writable;
+	bloom->dev = st.st_dev;
+	bloom->ino = st.st_ino;
+	bloom->mtime = st.st_mtime;
+
+	if (!read_header(bloom->data, &bloom->nbits, &bloom->nhashes, path))
+		goto fail;
+
+	if (bloom->size != HEADER_SIZE + bloom->nbits / 8) {
+		fprintf(stderr, "%s: Truncated bloom filter\n", path);
+		goto fail;
+	}
+
+	bloom->bits = bloom->data + HEADER_SIZE;
+	return 1;
+
+fail:
+	free_bloom(bloom);
+	return 0;
+}
+
+void free_bloom(struct bloom *bloom)
+{
+	assert(bloom != NULL);
+
+	if (bloom->is_mapped)
+		munmap(bloom->data, bloom->size);
+	else
+		free(bloom->data);
+
+	bloom->data = NULL;
+	bloom->bits = NULL;
+	bloom->size = 0;
+	bloom->is_mapped = 0;
+	bloom->is_writable = 0;
+}
+
+void add_bloom(struct bloom *bloom, uint32_t hash)
+{
+	uint32_t i, bit, h2;
+
+	assert(bloom != NULL);
+	assert(bloom->is_writable);
+
+	for_each_bit(bloom, hash, i, bit, h2)
+		if (!(bloom->bits[bit / 8] & (1 << (bit % 8))))
+			bloom->bits[bit / 8] |= 1 << (bit % 8);
+}
+
+int test_bloom(const struct bloom *bloom, uint32_t hash)
+{
+	uint32_t i, bit, h2;
+
+	assert(bloom != NULL);
+
+	for_each_bit(bloom, hash, i, bit, h2)
+		if (!(bloom->bits[bit / 8] & (1 << (bit % 8))))
+			return 0;
+
+	return 1;
+}
+
+int write_bloom(const struct bloom *bloom, const char *path)
+{
+	static char tmp[PATH_MAX];
+	size_t size;
+	ssize_t ret;
+	int fd;
+
+	assert(bloom != NULL);
+	assert(path != NULL);
+
+	if (snprintf(tmp, PATH_MAX, "%s.tmp", path) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", path);
+		return 0;
+	}
+
+	if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+		return perror(tmp), 0;
+
+	for (size = 0; size < bloom->size; size += ret) {
+		ret = write(fd, bloom->data + size, bloom->size - size);
+		if (ret == -1 && errno == EINTR)
+			ret = 0;
+		else if (ret == -1)
+			goto fail;
+	}
+
+	if (close(fd) == -1)
+		return perror(tmp), 0;
+
+	if (rename(tmp, path) == -1) {
+		fprintf(stderr, "rename(%s, %s): %s\n", tmp, path, strerror(errno));
+		return 0;
+	}
+
+	return 1;
+
+fail:
+	perror(tmp);
+	close(fd);
+	return 0;
+}
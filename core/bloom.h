@@ -0,0 +1,103 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+/**
+ * @file bloom.h
+ *
+ * Bloom filters answer whether a key may belong to a set, using a few
+ * bits per key.  False positives happen, false negatives never do, so
+ * a negative answer can be trusted and spare an expensive lookup.
+ *
+ * Keys are given as a 32 bits hash, from which every bit position is
+ * derived.  Filters are stored in files made of the number of bits and
+ * the number of hashes, both as native uint32_t, followed by the bits.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+struct bloom {
+	uint32_t nbits;
+	uint32_t nhashes;
+
+	/* Header followed by the bits, mapped or allocated */
+	unsigned char *data;
+	size_t size;
+	int is_mapped;
+	int is_writable;
+
+	/* File the filter is mapped from, as it was when mapped */
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+
+	unsigned char *bits;
+};
+
+/**
+ * Allocate an empty filter sized for the given number of keys.
+ *
+ * @param bloom Filter to initialize
+ * @param nkeys Expected number of keys
+ *
+ * @return 1 on success, 0 on failure
+ */
+int create_bloom(struct bloom *bloom, unsigned nkeys);
+
+/**
+ * Map the filter stored in the given file.  The mapping is shared, so
+ * that keys added by writers are seen by every process mapping the
+ * file.  When writable, keys added with add_bloom() are written to the
+ * file, and concurrent writers must be serialized by the caller.
+ *
+ * If the file does not exist, nothing is printed and errno is set to
+ * ENOENT, so that the caller can handle that case.
+ *
+ * @param bloom Filter to initialize
+ * @param path Path of the filter file
+ * @param writable Whether add_bloom() can be used on the filter
+ *
+ * @return 1 on success, 0 on failure
+ */
+int map_bloom(struct bloom *bloom, const char *path, int writable);
+
+/**
+ * Free or unmap the given filter.
+ *
+ * @param bloom Filter to free
+ */
+void free_bloom(struct bloom *bloom);
+
+/**
+ * Add a key to the filter.  Only bytes whose bits are not already set
+ * are written, so that mapped pages are not dirtied for nothing.
+ *
+ * @param bloom Filter
+ * @param hash Hash of the key
+ */
+void add_bloom(struct bloom *bloom, uint32_t hash);
+
+/**
+ * Check if the given key may have been added to the filter.
+ *
+ * @param bloom Filter
+ * @param hash Hash of the key
+ *
+ * @return 0 if the key has never been added, 1 if it may have been
+ */
+int test_bloom(const struct bloom *bloom, uint32_t hash);
+
+/**
+ * Write the filter in a temporary file and rename it to the given
+ * path, so that readers see either the old or the new filter.
+ *
+ * @param bloom Filter to write
+ * @param path Path of the filter file
+ *
+ * @return 1 on success, 0 on failure
+ */
+int write_bloom(const struct bloom *bloom, const char *path);
+
+#endif /* BLOOM_H */
@@ -7,6 +7,9 @@
 
 #include "config.h"
 #include "clan.h"
+#include "scanner.h"
+#include "dict.h"
+#include "commit.h"
 
 static char *clan_path(const char *clan)
 {
@@ -53,10 +56,10 @@ static const struct clan CLAN_ZERO;
 
 int read_clan(struct clan *clan, char *cname)
 {
+	static struct scanner sc;
 	char *path;
 	char pname[HEXNAME_LENGTH];
-	FILE *file;
-	int ret;
+	unsigned id;
 
 	assert(clan != NULL);
 	assert(is_valid_hexname(cname));
@@ -67,42 +70,42 @@ int read_clan(struct clan *clan, char *cname)
 
 	*clan = CLAN_ZERO;
 
-	if (!(file = fopen(path, "r"))) {
+	if (!open_scanner(&sc, path)) {
 		if (errno == ENOENT) {
 			clan->length = 0;
 			clan->members = NULL;
 			strcpy(clan->name, cname);
 			return 1;
 		} else {
-			perror(path);
 			return 0;
 		}
 	}
 
-	/* Ignore failure for now... */
-	while ((ret = fscanf(file, " %s", pname)) == 1)
-		add_member(clan, pname);
+	/* Members are stored by id */
+	while (!scan_eof(&sc)) {
+		if (!scan_unsigned(&sc, &id)) {
+			fprintf(stderr, "%s: Cannot match player id\n", path);
+			goto fail;
+		}
 
-	if (ferror(file)) {
-		perror(path);
-		goto fail;
-	} else if (ret == 0) {
-		fprintf(stderr, "%s: Cannot match player name\n", path);
-		goto fail;
+		if (!get_player_name(id, pname))
+			goto fail;
+		if (!add_member(clan, pname))
+			goto fail;
 	}
 
 	strcpy(clan->name, cname);
-	fclose(file);
 	return 1;
 
 fail:
-	fclose(file);
+	free_clan(clan);
 	return 0;
 }
 
 int write_clan(const struct clan *clan)
 {
-	unsigned i;
+	static struct staged_file sf;
+	unsigned i, id;
 	char *path;
 	FILE *file;
 
@@ -111,18 +114,20 @@ int write_clan(const struct clan *clan)
 
 	if (!(path = clan_path(clan->name)))
 		return 0;
-
-	if (!(file = fopen(path, "w"))) {
-		perror(path);
+	if (!(file = stage_file(&sf, path)))
 		return 0;
-	}
 
-	for (i = 0; i < clan->length; i++)
-		fprintf(file, "%s\n", clan->members[i].name);
+	for (i = 0; i < clan->length; i++) {
+		if ((id = get_player_id(clan->members[i].name)) == NO_ID) {
+			fprintf(stderr, "%s: %s: Player has no id\n", path, clan->members[i].name);
+			discard_file(&sf);
+			return 0;
+		}
 
-	fclose(file);
+		fprintf(file, "%u\n", id);
+	}
 
-	return 1;
+	return commit_file(&sf);
 }
 
 void free_clan(struct clan *clan)
@@ -205,6 +210,8 @@ int add_member_inline(char *clan, char *player)
 {
 	char *path;
 	FILE *file;
+	unsigned id;
+	int ret;
 
 	assert(clan != NULL);
 	assert(player != NULL);
@@ -213,10 +220,15 @@ int add_member_inline(char *clan, char *player)
 	if (!(path = clan_path(clan)))
 		return 0;
 
+	if ((id = get_player_id(player)) == NO_ID)
+		return fprintf(stderr, "%s: %s: Player has no id\n", path, player), 0;
+
 	if (!(file = fopen(path, "a")))
 		return perror(path), 0;
-	fprintf(file, "%s\n", player);
+	fprintf(file, "%u\n", id);
+
+	ret = commit_append(file, path);
 	fclose(file);
 
-	return 1;
+	return ret;
 }
@@ -0,0 +1,246 @@
+/* For syncfs() */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "commit.h"
+#include "config.h"
+
+enum durability {
+	DURABILITY_UNKNOWN, DURABILITY_NONE, DURABILITY_BATCH, DURABILITY_STRICT
+};
+
+/* Like an invalid database version, an invalid durability is fatal */
+static enum durability get_durability(void)
+{
+	static enum durability durability = DURABILITY_UNKNOWN;
+
+	if (durability != DURABILITY_UNKNOWN)
+		return durability;
+
+	if (!strcmp(config.durability, "none"))
+		durability = DURABILITY_NONE;
+	else if (!strcmp(config.durability, "batch"))
+		durability = DURABILITY_BATCH;
+	else if (!strcmp(config.durability, "strict"))
+		durability = DURABILITY_STRICT;
+	else {
+		fprintf(stderr, "%s: Unknown durability, expected none, batch or strict\n",
+		        config.durability);
+		exit(EXIT_FAILURE);
+	}
+
+	return durability;
+}
+
+/* Whether files have been committed since the last sync, in batch mode */
+static int has_commits;
+
+/* Length of the directory part of the given path, without the slash */
+static size_t dirname_length(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+
+	assert(slash != NULL);
+	return slash - path;
+}
+
+static int sync_dir(const char *path)
+{
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return perror(path), 0;
+
+	if (fsync(fd) == -1) {
+		perror(path);
+		close(fd);
+		return 0;
+	}
+
+	close(fd);
+	return 1;
+}
+
+/* Sync the directory holding the given file */
+static int sync_parent(const char *path)
+{
+	static char dir[PATH_MAX];
+	size_t length;
+
+	length = dirname_length(path);
+	memcpy(dir, path, length);
+	dir[length] = '\0';
+
+	return sync_dir(dir);
+}
+
+/*
+ * Temporary files are hidden, so that programs listing directories
+ * skip them along with "." and "..".  Several processes may stage the
+ * same file, each of them has its own temporary file.
+ */
+FILE *stage_file(struct staged_file *sf, const char *path)
+{
+	size_t length;
+	int ret;
+
+	assert(sf != NULL);
+	assert(path != NULL);
+
+	sf->file = NULL;
+	get_durability();
+
+	length = dirname_length(path);
+	ret = snprintf(sf->tmp, PATH_MAX, "%.*s/.%s.%ld.tmp",
+	               (int)length, path, path + length + 1, (long)getpid());
+	if (ret >= PATH_MAX || strlen(path) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", path);
+		return NULL;
+	}
+	strcpy(sf->path, path);
+
+	if (!(sf->file = fopen(sf->tmp, "w")))
+		return perror(sf->tmp), NULL;
+
+	return sf->file;
+}
+
+void discard_file(struct staged_file *sf)
+{
+	assert(sf != NULL);
+
+	if (!sf->file)
+		return;
+
+	fclose(sf->file);
+	sf->file = NULL;
+	unlink(sf->tmp);
+}
+
+int commit_file(struct staged_file *sf)
+{
+	enum durability durability = get_durability();
+	FILE *file;
+
+	assert(sf != NULL);
+	assert(sf->file != NULL);
+
+	file = sf->file;
+	sf->file = NULL;
+
+	if (fflush(file) == EOF || ferror(file)) {
+		perror(sf->tmp);
+		goto fail;
+	}
+
+	if (durability == DURABILITY_STRICT && fsync(fileno(file)) == -1) {
+		perror(sf->tmp);
+		goto fail;
+	}
+
+	if (fclose(file) == EOF) {
+		file = NULL;
+		perror(sf->tmp);
+		goto fail;
+	}
+	file = NULL;
+
+	if (!commit_rename(sf->tmp, sf->path))
+		goto fail;
+
+	return 1;
+
+fail:
+	if (file)
+		fclose(file);
+	unlink(sf->tmp);
+	return 0;
+}
+
+int commit_rename(const char *tmp, const char *path)
+{
+	enum durability durability = get_durability();
+
+	assert(tmp != NULL);
+	assert(path != NULL);
+
+	if (rename(tmp, path) == -1) {
+		fprintf(stderr, "rename(%s, %s): %s\n", tmp, path, strerror(errno));
+		return 0;
+	}
+
+	if (durability == DURABILITY_STRICT)
+		return sync_parent(path);
+	if (durability == DURABILITY_BATCH)
+		has_commits = 1;
+	return 1;
+}
+
+int commit_append(FILE *file, const char *path)
+{
+	enum durability durability = get_durability();
+
+	assert(file != NULL);
+	assert(path != NULL);
+
+	if (fflush(file) == EOF || ferror(file))
+		return perror(path), 0;
+
+	if (durability == DURABILITY_STRICT && fsync(fileno(file)) == -1)
+		return perror(path), 0;
+	if (durability == DURABILITY_BATCH)
+		has_commits = 1;
+
+	return 1;
+}
+
+/*
+ * Syncing the whole filesystem of the database at once writes file
+ * data and directories in a single pass, new files included, which is
+ * much faster than syncing each of them.  Other systems than Linux only
+ * have sync().
+ */
+static int sync_root(void)
+{
+#ifdef __linux__
+	int fd;
+
+	if ((fd = open(config.root, O_RDONLY)) == -1)
+		return perror(config.root), 0;
+
+	if (syncfs(fd) == -1) {
+		perror(config.root);
+		close(fd);
+		return 0;
+	}
+
+	close(fd);
+	return 1;
+#else
+	sync();
+	return 1;
+#endif
+}
+
+int sync_commits(void)
+{
+	if (!has_commits)
+		return 1;
+
+	has_commits = 0;
+	if (!sync_root())
+		return 0;
+
+	verbose("Database synced\n");
+	return 1;
+}
@@ -0,0 +1,105 @@
+#ifndef COMMIT_H
+#define COMMIT_H
+
+/**
+ * @file commit.h
+ *
+ * Replace database files atomically, so that readers and crashes never
+ * see a truncated file.  The new content is written to a temporary
+ * file in the same directory, which is then renamed over the old file.
+ *
+ * How much of it survives a power loss depends on the durability set
+ * with TEERANK_DURABILITY:
+ *
+ * - "none": files are never synced, the system flush them whenever it
+ *   wants.  After a crash a file may be empty.
+ *
+ * - "batch": the filesystem of the database is synced once by
+ *   sync_commits(), at the end of the update cycle, file data and
+ *   directories alike.  After a crash a file holds either its old or
+ *   its new content, or is missing if it was new.
+ *
+ * - "strict": every file is synced before being renamed, and its
+ *   directory after.  A file is durable once commit_file() returns.
+ *
+ *	struct staged_file sf;
+ *
+ *	if (!(file = stage_file(&sf, path)))
+ *		return 0;
+ *	fprintf(file, ...);
+ *	if (!commit_file(&sf))
+ *		return 0;
+ *	...
+ *	sync_commits();
+ */
+
+#include <stdio.h>
+#include <limits.h>
+
+struct staged_file {
+	FILE *file;
+	char path[PATH_MAX];
+	char tmp[PATH_MAX];
+};
+
+/**
+ * Create a temporary file to stage the new content of the given file.
+ *
+ * @param sf Staged file to initialize
+ * @param path Path of the file to replace
+ *
+ * @return Stream to write the new content to, NULL on failure
+ */
+FILE *stage_file(struct staged_file *sf, const char *path);
+
+/**
+ * Close the temporary file and rename it over the staged one.  On
+ * failure, the temporary file is removed and the old file is left
+ * untouched.
+ *
+ * @param sf Staged file
+ *
+ * @return 1 on success, 0 on failure
+ */
+int commit_file(struct staged_file *sf);
+
+/**
+ * Close and remove the temporary file, leaving the old file untouched.
+ *
+ * @param sf Staged file
+ */
+void discard_file(struct staged_file *sf);
+
+/**
+ * Rename the given file over another one, with the same durability as
+ * commit_file().  Useful for files that cannot be written with stdio,
+ * like symlinks.
+ *
+ * @param tmp Path of the new file
+ * @param path Path of the file to replace
+ *
+ * @return 1 on success, 0 on failure
+ */
+int commit_rename(const char *tmp, const char *path);
+
+/**
+ * Make sure data appended to the given file is as durable as a commit.
+ * The stream is not closed.
+ *
+ * @param file Stream data has been appended to
+ * @param path Path of the file
+ *
+ * @return 1 on success, 0 on failure
+ */
+int commit_append(FILE *file, const char *path);
+
+/**
+ * Sync files committed since the last call, and their directories, when
+ * durability is "batch".  Programs writing files must call it before
+ * exiting successfully.
+ *
+ * @return 1 on success, 0 on failure
+ */
+int sync_commits(void);
+
+#endif /* COMMIT_H */
@@ -3,8 +3,11 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 #include "config.h"
+#include "scanner.h"
 
 struct config config = {
 #define STRING(envname, value, fname) \
@@ -22,49 +25,31 @@ struct config config = {
  */
 static int get_version(void)
 {
+	static struct scanner sc;
 	char path[PATH_MAX];
-	FILE *file = NULL;
-	int ret;
 	int version;
 
-	ret = snprintf(path, PATH_MAX, "%s/version", config.root);
-	if (ret >= PATH_MAX) {
+	if (snprintf(path, PATH_MAX, "%s/version", config.root) >= PATH_MAX) {
 		fprintf(stderr, "%s: Too long\n", config.root);
-		goto fail;
+		exit(EXIT_FAILURE);
 	}
 
-	file = fopen(path, "r");
-	if (!file) {
+	if (!open_scanner(&sc, path)) {
 		/*
 		 * First databases did not have version file at all.
 		 * Hence it is like version 0.
 		 */
 		if (errno == ENOENT)
 			return 0;
-
-		perror(path);
-		goto fail;
+		exit(EXIT_FAILURE);
 	}
 
-	errno = 0;
-	ret = fscanf(file, "%d", &version);
-
-	if (ret == EOF && errno != 0) {
-		perror(path);
-		goto fail;
-	} else if (ret == EOF || ret == 0) {
+	if (!scan_int(&sc, &version)) {
 		fprintf(stderr, "%s: Cannot match database version number\n", path);
-		goto fail;
+		exit(EXIT_FAILURE);
 	}
 
-	fclose(file);
-
 	return version;
-
-fail:
-	if (file)
-		fclose(file);
-	exit(EXIT_FAILURE);
 }
 
 void load_config(int check_version)
@@ -105,3 +90,43 @@ void verbose(const char *fmt, ...)
 		va_end(ap);
 	}
 }
+
+/*
+ * The lock is held on a file of its own, kept open until the program
+ * exits, which is when the system releases the lock.
+ */
+int lock_database(void)
+{
+	static int fd = -1;
+	struct flock lock = { 0 };
+	char path[PATH_MAX];
+
+	if (fd != -1)
+		return 1;
+
+	if (snprintf(path, PATH_MAX, "%s/lock", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return 0;
+	}
+
+	if ((fd = open(path, O_RDWR | O_CREAT, 0644)) == -1)
+		return perror(path), 0;
+
+	lock.l_type = F_WRLCK;
+	lock.l_whence = SEEK_SET;
+
+	if (fcntl(fd, F_SETLK, &lock) == 0)
+		return 1;
+
+	verbose("%s: Waiting for other programs to be done\n", path);
+	while (fcntl(fd, F_SETLKW, &lock) == -1) {
+		if (errno != EINTR) {
+			perror(path);
+			close(fd);
+			fd = -1;
+			return 0;
+		}
+	}
+
+	return 1;
+}
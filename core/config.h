@@ -30,4 +30,14 @@ void load_config(int check_version);
 
 void verbose(const char *fmt, ...);
 
+/**
+ * Wait for other programs writing players to exit, and keep them
+ * waiting until this one exits.  Players are read, modified and
+ * written back, so two programs doing it at the same time would lose
+ * each other changes.
+ *
+ * @return 1 on success, 0 on failure
+ */
+int lock_database(void);
+
 #endif /* CONFIG_H */
@@ -0,0 +1,30 @@
+#include "crc32.h"
+
+static unsigned long table[256];
+
+static void init_table(void)
+{
+	unsigned long c;
+	unsigned i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = c & 1 ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+		table[i] = c;
+	}
+}
+
+unsigned long crc32(unsigned long crc, const void *buf, size_t size)
+{
+	const unsigned char *p = buf;
+
+	if (!table[1])
+		init_table();
+
+	crc = ~crc & 0xffffffffUL;
+	while (size--)
+		crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return ~crc & 0xffffffffUL;
+}
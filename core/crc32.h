@@ -0,0 +1,18 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+
+/**
+ * Update the CRC-32 (as used by gzip and PNG) of a stream of bytes with
+ * the given buffer.  The CRC of an empty stream is 0.
+ *
+ * @param crc CRC of previous bytes
+ * @param buf Buffer holding the next bytes
+ * @param size Size of the buffer
+ *
+ * @return Updated CRC
+ */
+unsigned long crc32(unsigned long crc, const void *buf, size_t size);
+
+#endif /* CRC32_H */
@@ -9,3 +9,5 @@
  */
 STRING("TEERANK_ROOT", ".teerank", root)
 BOOL("TEERANK_VERBOSE", 0, verbose)
+STRING("TEERANK_DURABILITY", "batch", durability)
+STRING("TEERANK_WEBROOT", "", webroot)
@@ -3,51 +3,45 @@
 #include <assert.h>
 #include <errno.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "delta.h"
+#include "scanner.h"
 
 int scan_delta(struct delta *delta)
 {
+	static struct scanner sc;
 	unsigned i;
-	int ret;
 
 	assert(delta != NULL);
 
-	errno = 0;
-	ret = scanf(" %u %d", &delta->length, &delta->elapsed);
-	if (ret == EOF && errno == 0)
+	if (!sc.path)
+		open_stream_scanner(&sc, STDIN_FILENO, "<stdin>");
+
+	if (scan_eof(&sc))
 		return 0;
-	else if (ret == EOF && errno != 0)
-		return perror("<stdin>"), 0;
-	else if (ret == 0)
+
+	if (!scan_unsigned(&sc, &delta->length))
 		return fprintf(stderr, "<stdin>: Cannot match delta length\n"), 0;
-	else if (ret == 1)
+	if (!scan_int(&sc, &delta->elapsed))
 		return fprintf(stderr, "<stdin>: Cannot match delta elapsed time\n"), 0;
+	if (delta->length > MAX_PLAYERS)
+		return fprintf(stderr, "<stdin>: Delta length greater than %d\n", MAX_PLAYERS), 0;
 
 	for (i = 0; i < delta->length; i++) {
-		errno = 0;
-		ret = scanf(" %s %s %ld %ld",
-		            delta->players[i].name,
-		            delta->players[i].clan,
-		            &delta->players[i].score,
-		            &delta->players[i].delta);
-		if (ret == EOF && errno == 0)
+		struct player_delta *player = &delta->players[i];
+
+		if (scan_eof(&sc))
 			return fprintf(stderr, "<stdin>: Expected %u players, found %u\n", delta->length, i), 0;
-		else if (ret == EOF && errno != 0)
-			return perror("<stdin>"), 0;
-		else if (ret == 0)
+
+		if (!scan_hexname(&sc, player->name))
 			return fprintf(stderr, "<stdin>: Cannot match player name\n"), 0;
-		else if (ret == 1)
+		if (!scan_hexname(&sc, player->clan))
 			return fprintf(stderr, "<stdin>: Cannot match player clan\n"), 0;
-		else if (ret == 2)
+		if (!scan_long(&sc, &player->score))
 			return fprintf(stderr, "<stdin>: Cannot match player score\n"), 0;
-		else if (ret == 3)
+		if (!scan_long(&sc, &player->delta))
 			return fprintf(stderr, "<stdin>: Cannot match player delta\n"), 0;
-
-		if (!is_valid_hexname(delta->players[i].name))
-			return fprintf(stderr, "<stdin>: %s: Not a valid player name\n", delta->players[i].name), 0;
-		if (!is_valid_hexname(delta->players[i].clan))
-			return fprintf(stderr, "<stdin>: %s: Not a valid player clan\n", delta->players[i].clan), 0;
 	}
 
 	return 1;
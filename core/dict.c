@@ -0,0 +1,466 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "dict.h"
+#include "bloom.h"
+#include "config.h"
+
+void init_dict(struct dict *dict)
+{
+	static const struct dict DICT_ZERO;
+
+	assert(dict != NULL);
+
+	*dict = DICT_ZERO;
+}
+
+void free_dict(struct dict *dict)
+{
+	assert(dict != NULL);
+
+	free(dict->names);
+	free(dict->next);
+	free(dict->buckets);
+
+	init_dict(dict);
+}
+
+/* FNV-1a */
+unsigned hash_name(const char *name)
+{
+	unsigned h = 2166136261u;
+
+	for (; *name; name++)
+		h = (h ^ (unsigned char)*name) * 16777619u;
+
+	return h;
+}
+
+unsigned get_id(const struct dict *dict, const char *name)
+{
+	unsigned i;
+
+	assert(dict != NULL);
+	assert(name != NULL);
+
+	if (!dict->nbuckets)
+		return NO_ID;
+
+	i = dict->buckets[hash_name(name) % dict->nbuckets];
+	for (; i; i = dict->next[i - 1])
+		if (!strcmp(dict->names[i - 1], name))
+			return i - 1;
+
+	return NO_ID;
+}
+
+static void link_name(struct dict *dict, unsigned id)
+{
+	unsigned *bucket;
+
+	bucket = &dict->buckets[hash_name(dict->names[id]) % dict->nbuckets];
+	dict->next[id] = *bucket;
+	*bucket = id + 1;
+}
+
+/*
+ * Keep at most one name per bucket on average, so that lookups stay
+ * in constant time.
+ */
+static int grow_dict(struct dict *dict)
+{
+	unsigned length, i;
+	void *tmp;
+
+	length = dict->nbuckets ? dict->nbuckets * 2 : 1024;
+
+	if (!(tmp = realloc(dict->names, length * sizeof(*dict->names))))
+		return perror("realloc(names)"), 0;
+	dict->names = tmp;
+
+	if (!(tmp = realloc(dict->next, length * sizeof(*dict->next))))
+		return perror("realloc(next)"), 0;
+	dict->next = tmp;
+
+	if (!(tmp = calloc(length, sizeof(*dict->buckets))))
+		return perror("calloc(buckets)"), 0;
+	free(dict->buckets);
+	dict->buckets = tmp;
+	dict->nbuckets = length;
+
+	for (i = 0; i < dict->length; i++)
+		link_name(dict, i);
+
+	return 1;
+}
+
+unsigned add_name(struct dict *dict, const char *name)
+{
+	unsigned id;
+
+	assert(dict != NULL);
+	assert(name != NULL);
+	assert(strlen(name) < HEXNAME_LENGTH);
+
+	if ((id = get_id(dict, name)) != NO_ID)
+		return id;
+
+	if (dict->length == dict->nbuckets)
+		if (!grow_dict(dict))
+			return NO_ID;
+
+	id = dict->length++;
+	strcpy(dict->names[id], name);
+	link_name(dict, id);
+
+	return id;
+}
+
+/*
+ * The players dictionary is stored in the "names" file, each entry
+ * being the raw name of the player padded with nul bytes.  The id of a
+ * player is the position of its entry, so that the name of a player
+ * can be read without loading the whole file.  Entries are only
+ * appended, and a lock is held while doing so.
+ */
+#define ENTRY_SIZE (NAME_LENGTH - 1)
+
+static struct dict players;
+static int players_fd = -1;
+
+static char *names_path(void)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s/names", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+/*
+ * A bloom filter of every registered player is stored in the "bloom"
+ * file, so that players that do not exist can be told without any
+ * filesystem lookup.  It is rebuilt by rebuild_players_bloom() and
+ * updated in place by register_player(), both with the lock held.
+ * Every process maps the same pages, so that keys set in place are
+ * seen without mapping the file again.
+ */
+static struct bloom bloom;
+static enum {
+	BLOOM_UNLOADED, BLOOM_LOADED, BLOOM_UNAVAILABLE
+} bloom_state;
+
+static char *bloom_path(void)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s/bloom", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+/*
+ * Readers open the file read-only and do not create it, so that they
+ * can run without write permissions.  A missing file is an empty
+ * dictionary.
+ */
+static int open_names(int writable)
+{
+	static int is_writable;
+	char *path;
+	int fd;
+
+	if (players_fd != -1 && (is_writable || !writable))
+		return 1;
+
+	if (!(path = names_path()))
+		return 0;
+
+	if (writable)
+		fd = open(path, O_RDWR | O_CREAT, 0666);
+	else
+		fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		if (errno != ENOENT || writable)
+			perror(path);
+		return 0;
+	}
+
+	if (players_fd != -1)
+		close(players_fd);
+
+	players_fd = fd;
+	is_writable = writable;
+	return 1;
+}
+
+/* Load entries added since the last call */
+static int load_players(void)
+{
+	static char buf[ENTRY_SIZE * 1024];
+	off_t offset;
+	ssize_t ret;
+
+	offset = (off_t)players.length * ENTRY_SIZE;
+
+	while ((ret = pread(players_fd, buf, sizeof(buf), offset)) > 0) {
+		ssize_t i;
+
+		/* Ignore an entry being written */
+		for (i = 0; i + ENTRY_SIZE <= ret; i += ENTRY_SIZE) {
+			char name[NAME_LENGTH], hex[HEXNAME_LENGTH];
+			unsigned length = players.length;
+
+			memcpy(name, buf + i, ENTRY_SIZE);
+			name[ENTRY_SIZE] = '\0';
+			name_to_hexname(name, hex);
+
+			if (add_name(&players, hex) != length) {
+				fprintf(stderr, "%s: Duplicated entry %u\n", names_path(), length);
+				return 0;
+			}
+		}
+
+		if ((size_t)ret < sizeof(buf))
+			break;
+		offset += ret;
+	}
+
+	if (ret == -1)
+		return perror(names_path()), 0;
+
+	return 1;
+}
+
+static int lock_names(short type)
+{
+	struct flock lock = { 0 };
+
+	lock.l_type = type;
+	lock.l_whence = SEEK_SET;
+
+	while (fcntl(players_fd, F_SETLKW, &lock) == -1)
+		if (errno != EINTR)
+			return perror(names_path()), 0;
+
+	return 1;
+}
+
+unsigned get_player_id(const char *name)
+{
+	unsigned id;
+
+	assert(name != NULL);
+
+	if ((id = get_id(&players, name)) != NO_ID)
+		return id;
+
+	if (!open_names(0) || !load_players())
+		return NO_ID;
+
+	return get_id(&players, name);
+}
+
+/*
+ * Map the filter for writing, unless the mapped one already is and has
+ * not been replaced since by rebuild_players_bloom().  Then adding a
+ * key is only a matter of setting bits in memory.  Without any filter,
+ * there is nothing to update.
+ */
+static int map_writable_bloom(void)
+{
+	struct stat st;
+	char *path;
+
+	if (!(path = bloom_path()))
+		return 0;
+
+	if (stat(path, &st) == -1) {
+		unload_players_bloom();
+		if (errno != ENOENT)
+			return perror(path), 0;
+
+		bloom_state = BLOOM_UNAVAILABLE;
+		return 1;
+	}
+
+	if (bloom_state == BLOOM_LOADED && bloom.is_writable &&
+	    bloom.dev == st.st_dev && bloom.ino == st.st_ino)
+		return 1;
+
+	unload_players_bloom();
+	if (!map_bloom(&bloom, path, 1)) {
+		if (errno != ENOENT)
+			return 0;
+
+		bloom_state = BLOOM_UNAVAILABLE;
+		return 1;
+	}
+
+	bloom_state = BLOOM_LOADED;
+	return 1;
+}
+
+unsigned register_player(const char *name)
+{
+	char buf[NAME_LENGTH];
+	unsigned id;
+	ssize_t ret;
+
+	assert(name != NULL);
+	assert(is_valid_hexname(name));
+
+	if ((id = get_id(&players, name)) != NO_ID)
+		return id;
+
+	if (!open_names(1) || !lock_names(F_WRLCK))
+		return NO_ID;
+
+	if (!load_players())
+		goto fail;
+	if ((id = get_id(&players, name)) != NO_ID)
+		goto unlock;
+
+	/* Set before the player file is created, not to miss it */
+	if (!map_writable_bloom())
+		goto fail;
+	if (bloom_state == BLOOM_LOADED)
+		add_bloom(&bloom, hash_name(name));
+
+	memset(buf, 0, sizeof(buf));
+	hexname_to_name(name, buf);
+
+	id = players.length;
+	ret = pwrite(players_fd, buf, ENTRY_SIZE, (off_t)id * ENTRY_SIZE);
+	if (ret != ENTRY_SIZE) {
+		if (ret == -1)
+			perror(names_path());
+		else
+			fprintf(stderr, "%s: Entry partially written\n", names_path());
+		goto fail;
+	}
+
+	if (add_name(&players, name) != id)
+		goto fail;
+
+unlock:
+	lock_names(F_UNLCK);
+	return id;
+
+fail:
+	lock_names(F_UNLCK);
+	return NO_ID;
+}
+
+int get_player_name(unsigned id, char *name)
+{
+	char buf[NAME_LENGTH];
+	ssize_t ret;
+
+	assert(name != NULL);
+
+	if (id < players.length) {
+		strcpy(name, players.names[id]);
+		return 1;
+	}
+
+	if (!open_names(0)) {
+		fprintf(stderr, "%s: No player with id %u\n", names_path(), id);
+		return 0;
+	}
+
+	ret = pread(players_fd, buf, ENTRY_SIZE, (off_t)id * ENTRY_SIZE);
+	if (ret == -1)
+		return perror(names_path()), 0;
+	else if (ret != ENTRY_SIZE)
+		return fprintf(stderr, "%s: No player with id %u\n", names_path(), id), 0;
+
+	buf[ENTRY_SIZE] = '\0';
+	name_to_hexname(buf, name);
+	return 1;
+}
+
+int may_be_player(const char *name)
+{
+	char *path;
+
+	assert(name != NULL);
+
+	if (bloom_state == BLOOM_UNLOADED) {
+		bloom_state = BLOOM_UNAVAILABLE;
+		if ((path = bloom_path()) && map_bloom(&bloom, path, 0))
+			bloom_state = BLOOM_LOADED;
+	}
+
+	if (bloom_state == BLOOM_UNAVAILABLE)
+		return 1;
+
+	return test_bloom(&bloom, hash_name(name));
+}
+
+void unload_players_bloom(void)
+{
+	if (bloom_state == BLOOM_LOADED)
+		free_bloom(&bloom);
+	bloom_state = BLOOM_UNLOADED;
+}
+
+void reload_players_bloom(void)
+{
+	struct stat st;
+	char *path;
+
+	if (bloom_state == BLOOM_UNLOADED)
+		return;
+
+	if (bloom_state == BLOOM_UNAVAILABLE ||
+	    !(path = bloom_path()) || stat(path, &st) == -1 ||
+	    bloom.dev != st.st_dev || bloom.ino != st.st_ino ||
+	    bloom.mtime != st.st_mtime)
+		unload_players_bloom();
+}
+
+int rebuild_players_bloom(void)
+{
+	struct bloom new;
+	unsigned id;
+	char *path;
+	int ret = 0;
+
+	if (!open_names(1) || !lock_names(F_WRLCK))
+		return 0;
+
+	if (!load_players())
+		goto unlock;
+	if (!create_bloom(&new, players.length))
+		goto unlock;
+
+	for (id = 0; id < players.length; id++)
+		add_bloom(&new, hash_name(players.names[id]));
+
+	if ((path = bloom_path()) && write_bloom(&new, path))
+		ret = 1;
+
+	free_bloom(&new);
+
+	/* Our own filter will be mapped again on the next probe */
+	unload_players_bloom();
+
+unlock:
+	lock_names(F_UNLCK);
+	return ret;
+}
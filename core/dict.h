@@ -0,0 +1,151 @@
+#ifndef DICT_H
+#define DICT_H
+
+/**
+ * @file dict.h
+ *
+ * A dictionary assign to each distinct player name a dense id, starting
+ * from 0.  Ids can then be used as indices of arrays holding players
+ * data, instead of using names.
+ */
+
+#include "player.h"
+
+/**
+ * @def NO_ID
+ *
+ * Value used to mark the absence of id.
+ */
+#define NO_ID UINT_MAX
+
+struct dict {
+	unsigned length;
+	char (*names)[HEXNAME_LENGTH];
+
+	/* Ids + 1 of the next name in the same bucket, 0 at the end */
+	unsigned *next;
+
+	unsigned nbuckets;
+	unsigned *buckets;
+};
+
+/**
+ * Hash a player name, see FNV-1a.
+ *
+ * @param name Player name
+ *
+ * @return Hash of the given name
+ */
+unsigned hash_name(const char *name);
+
+/**
+ * Initialize an empty dictionary.  No memory is allocated until the
+ * first name is added.
+ *
+ * @param dict Dictionary to initialize
+ */
+void init_dict(struct dict *dict);
+
+/**
+ * Free memory holded by the given dictionary and reset it.
+ *
+ * @param dict Dictionary to free
+ */
+void free_dict(struct dict *dict);
+
+/**
+ * Get the id of the given name.
+ *
+ * @param dict Dictionary to search the name in
+ * @param name Name to get the id of
+ *
+ * @return Id of the given name, NO_ID if name is not in the dictionary
+ */
+unsigned get_id(const struct dict *dict, const char *name);
+
+/**
+ * Get the id of the given name, adding it to the dictionary if needed.
+ *
+ * @param dict Dictionary to add the name in
+ * @param name Name to add
+ *
+ * @return Id of the given name, NO_ID on failure
+ */
+unsigned add_name(struct dict *dict, const char *name);
+
+/*
+ * Every player of the database is given a persistent id by the players
+ * dictionary.  Ids are dense and never change, hence they are used
+ * instead of names in ranks and clan files.
+ */
+
+/**
+ * Get the persistent id of the given player.  Players added by other
+ * processes are taken into account.
+ *
+ * @param name Player name
+ *
+ * @return Id of the given player, NO_ID if the player does not have one
+ */
+unsigned get_player_id(const char *name);
+
+/**
+ * Get the persistent id of the given player, giving it a new one if
+ * needed.
+ *
+ * @param name Player name
+ *
+ * @return Id of the given player, NO_ID on failure
+ */
+unsigned register_player(const char *name);
+
+/**
+ * Get the name of the player with the given id.  Unlike
+ * get_player_id(), it does not need to load the whole dictionary.
+ *
+ * @param id Player id
+ * @param name Buffer of HEXNAME_LENGTH bytes to store the player name
+ *
+ * @return 1 on success, 0 on failure
+ */
+int get_player_name(unsigned id, char *name);
+
+/**
+ * Check if the given player may exist, using the bloom filter of
+ * registered players.  Every player file belongs to a registered
+ * player, hence a negative answer means that no player file exists
+ * and it can be trusted without looking at the filesystem.
+ *
+ * Players registered by other processes after the first call may be
+ * missed, that is fine for short lived readers, and the only process
+ * creating players is the one updating them.  Long lived readers must
+ * call reload_players_bloom() from time to time.
+ *
+ * @param name Player name
+ *
+ * @return 0 if the player does not exist, 1 if it may exist
+ */
+int may_be_player(const char *name);
+
+/**
+ * Forget the bloom filter, so that the next call to may_be_player()
+ * maps it again and sees players registered in the meantime.
+ */
+void unload_players_bloom(void);
+
+/**
+ * Forget the bloom filter only if its file has been replaced or
+ * modified since it was mapped, which costs a single stat().
+ */
+void reload_players_bloom(void);
+
+/**
+ * Rebuild the bloom filter of registered players, sized for their
+ * current number, so that false positives stay rare as the database
+ * grows.
+ *
+ * @return 1 on success, 0 on failure
+ */
+int rebuild_players_bloom(void);
+
+#endif /* DICT_H */
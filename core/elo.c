@@ -8,35 +8,61 @@
 #include "delta.h"
 #include "config.h"
 
+/* p() clamps delta to [-MAX_ELO_DIFF, MAX_ELO_DIFF] */
+#define MAX_ELO_DIFF 400
+
 /* p() func as defined by Elo. */
 static double p(double delta)
 {
-	if (delta > 400.0)
-		delta = 400.0;
-	else if (delta < -400.0)
-		delta = -400.0;
+	if (delta > MAX_ELO_DIFF)
+		delta = MAX_ELO_DIFF;
+	else if (delta < -MAX_ELO_DIFF)
+		delta = -MAX_ELO_DIFF;
 
 	return 1.0 / (1.0 + pow(10.0, -delta / 400.0));
 }
 
-/* Classic Elo formula for two players */
-static int compute_elo_delta(struct player *player, struct player *opponent)
+/*
+ * Since Elo differences are integers and p() clamps them, the classic
+ * Elo formula for two players can only yield 3 * 801 distinct values:
+ * one per outcome (loss, draw, win) and per clamped Elo difference.
+ *
+ * Hence we compute them once for all, using the exact same arithmetic
+ * (and integer truncation) than evaluating the formula for each pair
+ * would.  That way updating a game does not need any call to pow(),
+ * only table lookups.
+ */
+struct elo_data {
+	unsigned K;
+
+	int initialized;
+	int deltas[3][2 * MAX_ELO_DIFF + 1];
+};
+
+static void init_elo_deltas(struct elo_data *data)
 {
-	static const unsigned K = 25;
-	double W;
+	const unsigned K = data->K;
+	int diff;
+
+	if (data->initialized)
+		return;
 
-	assert(player != NULL);
-	assert(opponent != NULL);
-	assert(player != opponent);
+	for (diff = -MAX_ELO_DIFF; diff <= MAX_ELO_DIFF; diff++) {
+		data->deltas[0][diff + MAX_ELO_DIFF] = K * (0.0 - p(diff));
+		data->deltas[1][diff + MAX_ELO_DIFF] = K * (0.5 - p(diff));
+		data->deltas[2][diff + MAX_ELO_DIFF] = K * (1.0 - p(diff));
+	}
 
-	if (player->delta->delta < opponent->delta->delta)
-		W = 0.0;
-	else if (player->delta->delta == opponent->delta->delta)
-		W = 0.5;
-	else
-		W = 1.0;
+	data->initialized = 1;
+}
 
-	return K * (W - p(player->elo - opponent->elo));
+static int clamp_diff(int diff)
+{
+	if (diff > MAX_ELO_DIFF)
+		return MAX_ELO_DIFF;
+	else if (diff < -MAX_ELO_DIFF)
+		return -MAX_ELO_DIFF;
+	return diff;
 }
 
 /*
@@ -47,23 +73,109 @@ static int compute_elo_delta(struct player *player, struct player *opponent)
  * To get the new Elo for a player, we match this player against every
  * other players and we make the average of every Elo deltas.  The Elo
  * delta is then added to the player's Elo points.
+ *
+ * Matching a player against himself always yield a draw with an Elo
+ * difference of zero, hence a delta of zero.  So the inner loop does
+ * not need any special case and is branch-free, which let the compiler
+ * vectorize it.
  */
-int compute_new_elo(struct player *player, struct player *players, unsigned length)
+static void compute_elos(
+	struct elo_data *data, unsigned length, const int elos[],
+	const long deltas[], const int rankable[], int new_elos[])
+{
+	unsigned i, j;
+
+	init_elo_deltas(data);
+
+	for (i = 0; i < length; i++) {
+		int total = 0;
+
+		for (j = 0; j < length; j++) {
+			int outcome, diff;
+
+			/* 0 for a loss, 1 for a draw, 2 for a win */
+			outcome = (deltas[i] > deltas[j]) + (deltas[i] >= deltas[j]);
+			diff = clamp_diff(elos[i] - elos[j]) + MAX_ELO_DIFF;
+
+			total += data->deltas[outcome][diff] & -(rankable[j] != 0);
+		}
+
+		new_elos[i] = elos[i] + total / (int)length;
+	}
+}
+
+static void elo_init_rating(const struct rating_engine *engine, void *rating)
+{
+	*(int*)rating = DEFAULT_ELO;
+}
+
+static double elo_expected_score(
+	const struct rating_engine *engine,
+	const void *player, const void *opponent)
+{
+	return p(*(const int*)player - *(const int*)opponent);
+}
+
+static void elo_rate_game(
+	const struct rating_engine *engine, unsigned length,
+	void *ratings[], const long deltas[], const int rankable[])
 {
+	int elos[MAX_PLAYERS] = { 0 }, new_elos[MAX_PLAYERS];
 	unsigned i;
-	int total = 0;
 
-	assert(player != NULL);
-	assert(players != NULL);
+	assert(ratings != NULL);
+	assert(deltas != NULL);
+	assert(rankable != NULL);
 	assert(length <= MAX_PLAYERS);
 
 	for (i = 0; i < length; i++)
-		if (&players[i] != player && players[i].is_rankable)
-			total += compute_elo_delta(player, &players[i]);
+		elos[i] = *(int*)ratings[i];
 
-	total = total / (int)length;
+	compute_elos(engine->data, length, elos, deltas, rankable, new_elos);
 
-	return player->elo + total;
+	for (i = 0; i < length; i++)
+		if (rankable[i])
+			*(int*)ratings[i] = new_elos[i];
+}
+
+#define ELO(name, data) {                                               \
+	name, sizeof(int), elo_init_rating, elo_expected_score,         \
+	elo_rate_game, data                                             \
+}
+
+static struct elo_data K25 = { 25 }, K16 = { 16 }, K32 = { 32 };
+
+const struct rating_engine ELO_ENGINE = ELO("elo", &K25);
+const struct rating_engine ELO_K16_ENGINE = ELO("elo-k16", &K16);
+const struct rating_engine ELO_K32_ENGINE = ELO("elo-k32", &K32);
+
+int is_rankable_game(int elapsed, unsigned rankable, unsigned length)
+{
+	/*
+	 * 30 minutes between each update is just too much and it increase
+	 * the chance of rating two different games.
+	 */
+	if (elapsed > 30 * 60) {
+		verbose("A game with %u players is unrankable because too"
+		        " much time have passed between two updates\n",
+		        length);
+		return 0;
+	}
+
+	/*
+	 * We don't rank games with less than 4 rankable players.  We believe
+	 * it is too much volatile to rank those kind of games.
+	 */
+	if (rankable < 4) {
+		verbose("A game with %u players is unrankable because only"
+		        " %u players can be ranked, 4 needed\n",
+		        length, rankable);
+		return 0;
+	}
+
+	verbose("A game with %u rankable players over %u will be ranked\n",
+	        rankable, length);
+	return 1;
 }
 
 static void print_elo_change(struct player *player, int elo)
@@ -78,24 +190,33 @@ static void print_elo_change(struct player *player, int elo)
 void update_elos(struct player *players, unsigned length)
 {
 	int elos[MAX_PLAYERS];
+	void *ratings[MAX_PLAYERS];
+	long deltas[MAX_PLAYERS] = { 0 };
+	int rankable[MAX_PLAYERS] = { 0 };
 	unsigned i;
 
 	assert(players != NULL);
 	assert(length <= MAX_PLAYERS);
 
 	/*
-	 * Do it in two steps so that newly computed elos values do not
-	 * interfer with the computing of the next ones.
+	 * Gather everything needed in contiguous arrays first, then
+	 * rate the whole game in one go so that newly computed elos
+	 * values do not interfer with the computing of the next ones.
 	 */
 
+	for (i = 0; i < length; i++) {
+		elos[i] = players[i].elo;
+		ratings[i] = &elos[i];
+		deltas[i] = players[i].delta->delta;
+		rankable[i] = players[i].is_rankable;
+	}
+
+	ELO_ENGINE.rate_game(&ELO_ENGINE, length, ratings, deltas, rankable);
+
 	for (i = 0; i < length; i++) {
 		if (players[i].is_rankable) {
-			elos[i] = compute_new_elo(&players[i], players, length);
 			print_elo_change(&players[i], elos[i]);
+			set_elo(&players[i], elos[i]);
 		}
 	}
-
-	for (i = 0; i < length; i++)
-		if (players[i].is_rankable)
-			set_elo(&players[i], elos[i]);
 }
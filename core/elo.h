@@ -2,12 +2,28 @@
 #define ELO_H
 
 #include "player.h"
+#include "rating.h"
 
 /* Number of elo points new players start with */
 static const int DEFAULT_ELO = 1500;
 
 /*
- * Update elo's point of each rankable player.
+ * Given a game it does return wether or not this game fills the
+ * requirements to be ranked.
+ */
+int is_rankable_game(int elapsed, unsigned rankable, unsigned length);
+
+/*
+ * Elo rating engine used for the database, rating are "int".  Only
+ * rankable players are taken into account as opponents.
+ */
+extern const struct rating_engine ELO_ENGINE;
+
+/* Same as ELO_ENGINE but with different K factors, for backtesting */
+extern const struct rating_engine ELO_K16_ENGINE, ELO_K32_ENGINE;
+
+/*
+ * Update elo's point of each rankable player using ELO_ENGINE.
  */
 void update_elos(struct player *players, unsigned length);
 
@@ -0,0 +1,255 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "generation.h"
+#include "commit.h"
+#include "config.h"
+
+static char *root_file(const char *filename)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s/%s", config.root, filename) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+/*
+ * The "current" symlink is relative, "generations/<number>", so that
+ * the database can be moved around.
+ */
+static int read_current(char *target)
+{
+	char *path;
+	ssize_t ret;
+
+	if (!(path = root_file("current")))
+		return 0;
+
+	if ((ret = readlink(path, target, PATH_MAX - 1)) == -1) {
+		if (errno != ENOENT)
+			perror(path);
+		return 0;
+	}
+
+	target[ret] = '\0';
+	return 1;
+}
+
+/* Number of the current generation, 0 if there is none */
+static int get_current_number(unsigned *number)
+{
+	char target[PATH_MAX];
+
+	if (!read_current(target)) {
+		*number = 0;
+		return errno == ENOENT;
+	}
+
+	if (sscanf(target, "generations/%u", number) != 1) {
+		fprintf(stderr, "%s/current: %s: Invalid generation\n", config.root, target);
+		return 0;
+	}
+
+	return 1;
+}
+
+static char *generation_path(unsigned number)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s/generations/%u",
+	             config.root, number) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+/* Remove the given generation with its files, if it exists */
+static int remove_generation(unsigned number)
+{
+	static char path[PATH_MAX];
+	struct dirent *dp;
+	char *dirpath;
+	DIR *dir;
+	int ret = 1;
+
+	if (!(dirpath = generation_path(number)))
+		return 0;
+
+	if (!(dir = opendir(dirpath))) {
+		if (errno == ENOENT)
+			return 1;
+		return perror(dirpath), 0;
+	}
+
+	while ((dp = readdir(dir))) {
+		if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+			continue;
+
+		if (snprintf(path, PATH_MAX, "%s/%s", dirpath, dp->d_name) >= PATH_MAX) {
+			fprintf(stderr, "%s: Too long\n", dirpath);
+			ret = 0;
+		} else if (unlink(path) == -1) {
+			perror(path);
+			ret = 0;
+		}
+	}
+
+	closedir(dir);
+
+	/*
+	 * A reader may have just cached a page in it, the generation will
+	 * then be removed along with the next old one.
+	 */
+	if (ret && rmdir(dirpath) == -1 && errno != ENOTEMPTY && errno != EEXIST)
+		return perror(dirpath), 0;
+
+	return ret;
+}
+
+int create_generation(struct generation *gen)
+{
+	unsigned current;
+	char *path;
+
+	assert(gen != NULL);
+
+	if (!get_current_number(&current))
+		return 0;
+
+	gen->number = current + 1;
+
+	/* Leftovers of a generation that has never been published */
+	if (!remove_generation(gen->number))
+		return 0;
+
+	if (!(path = root_file("generations")))
+		return 0;
+	if (mkdir(path, 0777) == -1 && errno != EEXIST)
+		return perror(path), 0;
+
+	if (!(path = generation_path(gen->number)))
+		return 0;
+	if (mkdir(path, 0777) == -1)
+		return perror(path), 0;
+
+	strcpy(gen->path, path);
+	return 1;
+}
+
+char *generation_file(const struct generation *gen, const char *filename)
+{
+	static char path[PATH_MAX];
+
+	assert(gen != NULL);
+	assert(filename != NULL);
+
+	if (snprintf(path, PATH_MAX, "%s/%s", gen->path, filename) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", gen->path);
+		return NULL;
+	}
+
+	return path;
+}
+
+/* Remove every generation older than the given one */
+static int remove_old_generations(unsigned oldest)
+{
+	struct dirent *dp;
+	char *path;
+	DIR *dir;
+	int ret = 1;
+
+	if (!(path = root_file("generations")))
+		return 0;
+	if (!(dir = opendir(path)))
+		return perror(path), 0;
+
+	while ((dp = readdir(dir))) {
+		char *end;
+		unsigned long number;
+
+		number = strtoul(dp->d_name, &end, 10);
+		if (*dp->d_name == '\0' || *end != '\0' || number >= oldest)
+			continue;
+
+		if (!remove_generation(number))
+			ret = 0;
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+int publish_generation(struct generation *gen)
+{
+	static char tmp[PATH_MAX], target[PATH_MAX];
+	char *path;
+
+	assert(gen != NULL);
+
+	/* Files must be durable before they are made current */
+	if (!sync_commits())
+		return 0;
+
+	sprintf(target, "generations/%u", gen->number);
+
+	if (!(path = root_file(".current.tmp")))
+		return 0;
+	strcpy(tmp, path);
+
+	if (unlink(tmp) == -1 && errno != ENOENT)
+		return perror(tmp), 0;
+	if (symlink(target, tmp) == -1)
+		return perror(tmp), 0;
+
+	if (!(path = root_file("current")))
+		return 0;
+	if (!commit_rename(tmp, path))
+		return 0;
+
+	if (gen->number > 1)
+		return remove_old_generations(gen->number - 1);
+	return 1;
+}
+
+/*
+ * Generation pinned by the current process, relative to the root.
+ */
+static char pinned[PATH_MAX];
+
+char *current_file(const char *filename)
+{
+	static char path[PATH_MAX];
+
+	assert(filename != NULL);
+
+	if (!*pinned && !read_current(pinned))
+		return NULL;
+
+	if (snprintf(path, PATH_MAX, "%s/%s/%s",
+	             config.root, pinned, filename) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+void unpin_generation(void)
+{
+	*pinned = '\0';
+}
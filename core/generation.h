@@ -0,0 +1,75 @@
+#ifndef GENERATION_H
+#define GENERATION_H
+
+/**
+ * @file generation.h
+ *
+ * Files computed from the whole database, like ranks, are published
+ * as immutable generations: each one is built in a new directory of
+ * "generations", and the "current" symlink is then atomically flipped
+ * to it.  Readers resolve the symlink once and read every file from
+ * the same generation, so they never see a half written one and never
+ * block writers.
+ *
+ * The previous generation is kept when publishing a new one, so that
+ * readers that just pinned it can finish their work.
+ */
+
+#include <limits.h>
+
+struct generation {
+	unsigned number;
+	char path[PATH_MAX];
+};
+
+/**
+ * Create the directory of a new generation, numbered after the current
+ * one.
+ *
+ * @param gen Generation to initialize
+ *
+ * @return 1 on success, 0 on failure
+ */
+int create_generation(struct generation *gen);
+
+/**
+ * Get the path of a file in the given generation.
+ *
+ * @param gen Generation
+ * @param filename Name of the file
+ *
+ * @return A static buffer holding the path, NULL on failure
+ */
+char *generation_file(const struct generation *gen, const char *filename);
+
+/**
+ * Sync files of the given generation, make it current, and remove
+ * generations older than the previous one.
+ *
+ * @param gen Generation to publish
+ *
+ * @return 1 on success, 0 on failure
+ */
+int publish_generation(struct generation *gen);
+
+/**
+ * Get the path of a file in the current generation.  The current
+ * generation is resolved on the first call only, and that same
+ * generation is used until unpin_generation() is called.
+ *
+ * If there is no generation yet, nothing is printed, NULL is returned
+ * and errno is set to ENOENT.
+ *
+ * @param filename Name of the file
+ *
+ * @return A static buffer holding the path, NULL on failure
+ */
+char *current_file(const char *filename);
+
+/**
+ * Forget the pinned generation, so that the next call to
+ * current_file() resolves the current generation again.
+ */
+void unpin_generation(void);
+
+#endif /* GENERATION_H */
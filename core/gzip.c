@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "gzip.h"
+#include "crc32.h"
+
+#define WINDOW_SIZE 32768
+#define WINDOW_MASK (WINDOW_SIZE - 1)
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+
+/* Longer chains find longer matches, but take more time */
+#define MAX_CHAIN 64
+
+#define END_OF_BLOCK 256
+
+static const unsigned short length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* Bits are packed starting from the least significant bit of bytes */
+struct bitstream {
+	FILE *out;
+	unsigned long bits;
+	unsigned nbits;
+};
+
+static void put_bits(struct bitstream *bs, unsigned long value, unsigned nbits)
+{
+	assert(nbits <= 16);
+
+	bs->bits |= value << bs->nbits;
+	bs->nbits += nbits;
+
+	while (bs->nbits >= 8) {
+		putc(bs->bits & 0xff, bs->out);
+		bs->bits >>= 8;
+		bs->nbits -= 8;
+	}
+}
+
+static void flush_bits(struct bitstream *bs)
+{
+	if (bs->nbits)
+		putc(bs->bits & 0xff, bs->out);
+
+	bs->bits = 0;
+	bs->nbits = 0;
+}
+
+/* Huffman codes are packed starting from their most significant bit */
+static void put_code(struct bitstream *bs, unsigned code, unsigned nbits)
+{
+	unsigned reversed = 0, i;
+
+	for (i = 0; i < nbits; i++) {
+		reversed = reversed << 1 | (code & 1);
+		code >>= 1;
+	}
+
+	put_bits(bs, reversed, nbits);
+}
+
+/* Fixed literal/length codes, see RFC 1951 section 3.2.6 */
+static void put_symbol(struct bitstream *bs, unsigned symbol)
+{
+	if (symbol < 144)
+		put_code(bs, 0x30 + symbol, 8);
+	else if (symbol < 256)
+		put_code(bs, 0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		put_code(bs, symbol - 256, 7);
+	else
+		put_code(bs, 0xc0 + symbol - 280, 8);
+}
+
+static void put_match(struct bitstream *bs, unsigned length, unsigned dist)
+{
+	unsigned i;
+
+	assert(length >= MIN_MATCH && length <= MAX_MATCH);
+	assert(dist >= 1 && dist <= WINDOW_SIZE);
+
+	for (i = 28; length_base[i] > length; i--)
+		;
+	put_symbol(bs, 257 + i);
+	put_bits(bs, length - length_base[i], length_extra[i]);
+
+	for (i = 29; dist_base[i] > dist; i--)
+		;
+	put_code(bs, i, 5);
+	put_bits(bs, dist - dist_base[i], dist_extra[i]);
+}
+
+/*
+ * Positions of the last string starting with the same three bytes, and
+ * for each position in the window, the previous one.  -1 ends chains.
+ */
+static long head[HASH_SIZE];
+static long prev[WINDOW_SIZE];
+
+static unsigned hash(const unsigned char *p)
+{
+	return ((unsigned)p[0] << 10 ^ (unsigned)p[1] << 5 ^ p[2]) & (HASH_SIZE - 1);
+}
+
+static void insert(const unsigned char *data, size_t length, size_t pos)
+{
+	unsigned h;
+
+	if (pos + MIN_MATCH > length)
+		return;
+
+	h = hash(data + pos);
+	prev[pos & WINDOW_MASK] = head[h];
+	head[h] = pos;
+}
+
+/* Find the longest match in the window, return its length */
+static unsigned longest_match(
+	const unsigned char *data, size_t length, size_t pos, unsigned *dist)
+{
+	unsigned best = 0, max, n, chain = MAX_CHAIN;
+	long cand;
+
+	if (pos + MIN_MATCH > length)
+		return 0;
+
+	max = length - pos < MAX_MATCH ? length - pos : MAX_MATCH;
+	cand = head[hash(data + pos)];
+
+	while (cand != -1 && pos - cand <= WINDOW_SIZE && chain--) {
+		if (data[cand + best] == data[pos + best]) {
+			for (n = 0; n < max && data[cand + n] == data[pos + n]; n++)
+				;
+
+			if (n > best) {
+				best = n;
+				*dist = pos - cand;
+				if (n == max)
+					break;
+			}
+		}
+
+		cand = prev[cand & WINDOW_MASK];
+	}
+
+	return best >= MIN_MATCH ? best : 0;
+}
+
+static void put_le32(FILE *out, unsigned long value)
+{
+	putc(value & 0xff, out);
+	putc(value >> 8 & 0xff, out);
+	putc(value >> 16 & 0xff, out);
+	putc(value >> 24 & 0xff, out);
+}
+
+int gzip(FILE *out, const void *data, size_t length)
+{
+	/* No file name, no modification time, unix */
+	static const unsigned char header[10] = {
+		0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3
+	};
+
+	const unsigned char *in = data;
+	struct bitstream bs;
+	unsigned n, dist;
+	size_t pos, end;
+	unsigned i;
+
+	assert(out != NULL);
+	assert(data != NULL || length == 0);
+
+	for (i = 0; i < HASH_SIZE; i++)
+		head[i] = -1;
+
+	fwrite(header, sizeof(header), 1, out);
+
+	bs.out = out;
+	bs.bits = 0;
+	bs.nbits = 0;
+
+	/* A single final block, with fixed Huffman codes */
+	put_bits(&bs, 1, 1);
+	put_bits(&bs, 1, 2);
+
+	for (pos = 0; pos < length; ) {
+		if ((n = longest_match(in, length, pos, &dist))) {
+			put_match(&bs, n, dist);
+			for (end = pos + n; pos < end; pos++)
+				insert(in, length, pos);
+		} else {
+			put_symbol(&bs, in[pos]);
+			insert(in, length, pos);
+			pos++;
+		}
+	}
+
+	put_symbol(&bs, END_OF_BLOCK);
+	flush_bits(&bs);
+
+	put_le32(out, crc32(0, data, length));
+	put_le32(out, length & 0xffffffffUL);
+
+	if (ferror(out))
+		return perror("gzip"), 0;
+
+	return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+/**
+ * @file gzip.h
+ *
+ * A small deflate compressor, writing the gzip format (RFC 1951 and
+ * RFC 1952).  Repeated strings are found with hash chains, then coded
+ * with the fixed Huffman codes, in a single block.  Compression is not
+ * as good as zlib's, but pages are full of repeated markup, and it is
+ * fast enough for them to be compressed once per generation.
+ */
+
+#include <stdio.h>
+
+/**
+ * Compress the given data to the given stream, in the gzip format.
+ *
+ * @param out Stream to write compressed data to
+ * @param data Data to compress
+ * @param length Length of the data
+ *
+ * @return 1 on success, 0 on failure
+ */
+int gzip(FILE *out, const void *data, size_t length);
+
+#endif /* GZIP_H */
@@ -0,0 +1,216 @@
+#include <string.h>
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hexname.h"
+
+/*
+ * Hex strings are at most 32 characters long, that is 16 bytes once
+ * decoded including the terminating nul byte.  Conversions are done on
+ * fixed size blocks of that length, so that they can be vectorized.
+ */
+#define MAX_HEXNAME_LENGTH (HEXNAME_LENGTH - 1)
+#define BLOCK_SIZE (MAX_HEXNAME_LENGTH / 2)
+
+#ifdef __SSE2__
+
+/*
+ * Both halves of each byte are converted to their digit in parallel,
+ * then interleaved.
+ */
+static void encode_block(const unsigned char *name, char *hex)
+{
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+	__m128i bytes, hi, lo;
+
+	bytes = _mm_loadu_si128((const __m128i*)name);
+	hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+	lo = _mm_and_si128(bytes, mask);
+
+	hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), gap));
+	lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), gap));
+
+	_mm_storeu_si128((__m128i*)hex, _mm_unpacklo_epi8(hi, lo));
+	_mm_storeu_si128((__m128i*)(hex + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+/* Return the value of each digit, with 0xff for invalid digits */
+static __m128i digit_values(__m128i c)
+{
+	const __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+	const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	const __m128i alpha = _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10));
+	__m128i is_digit, is_alpha;
+
+	/* Characters above 127 are negative, hence out of both ranges */
+	is_digit = _mm_and_si128(
+		_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	is_alpha = _mm_and_si128(
+		_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+		_mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+	return _mm_or_si128(
+		_mm_or_si128(_mm_and_si128(is_digit, digit), _mm_and_si128(is_alpha, alpha)),
+		_mm_andnot_si128(_mm_or_si128(is_digit, is_alpha), _mm_set1_epi8(-1)));
+}
+
+/*
+ * Each pair of digits is seen as a 16 bits word, the first digit being
+ * the low byte.  Words are combined then packed back to bytes.
+ */
+static __m128i combine_digits(__m128i values)
+{
+	__m128i hi, lo;
+
+	hi = _mm_and_si128(values, _mm_set1_epi16(0x00ff));
+	lo = _mm_srli_epi16(values, 8);
+
+	return _mm_or_si128(_mm_slli_epi16(hi, 4), lo);
+}
+
+static int decode_block(const char *hex, unsigned char *name)
+{
+	__m128i a, b, invalid;
+
+	a = digit_values(_mm_loadu_si128((const __m128i*)hex));
+	b = digit_values(_mm_loadu_si128((const __m128i*)(hex + 16)));
+
+	invalid = _mm_or_si128(a, b);
+	if (_mm_movemask_epi8(invalid))
+		return 0;
+
+	_mm_storeu_si128((__m128i*)name, _mm_packus_epi16(combine_digits(a), combine_digits(b)));
+	return 1;
+}
+
+#else
+
+static const char HEXDIGITS[16] = "0123456789abcdef";
+
+/* Value of each hexadecimal digit, X for any other character */
+#define X 16
+static const unsigned char HEXVALUES[256] = {
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,
+	X, 10, 11, 12, 13, 14, 15, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, 10, 11, 12, 13, 14, 15, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+};
+#undef X
+
+static void encode_block(const unsigned char *name, char *hex)
+{
+	unsigned i;
+
+	for (i = 0; i < BLOCK_SIZE; i++) {
+		hex[2 * i] = HEXDIGITS[name[i] >> 4];
+		hex[2 * i + 1] = HEXDIGITS[name[i] & 0x0f];
+	}
+}
+
+static int decode_block(const char *hex, unsigned char *name)
+{
+	unsigned i;
+
+	for (i = 0; i < BLOCK_SIZE; i++) {
+		unsigned hi = HEXVALUES[(unsigned char)hex[2 * i]];
+		unsigned lo = HEXVALUES[(unsigned char)hex[2 * i + 1]];
+
+		if ((hi | lo) > 0x0f)
+			return 0;
+		name[i] = hi << 4 | lo;
+	}
+
+	return 1;
+}
+
+#endif
+
+/*
+ * A valid hex string is an even number of digits, no pair being "00"
+ * but the last one.  It is decoded padded with '0', so that the first
+ * nul byte must be the one given by the last pair.
+ */
+int decode_hexname(const char *hex, char *name)
+{
+	char buf[MAX_HEXNAME_LENGTH];
+	unsigned char block[BLOCK_SIZE];
+	size_t len;
+
+	assert(hex != NULL);
+	assert(name != NULL);
+
+	for (len = 0; len < MAX_HEXNAME_LENGTH && hex[len]; len++)
+		;
+
+	if (hex[len] || len < 2 || len % 2)
+		return 0;
+
+	memcpy(buf, hex, len);
+	memset(buf + len, '0', MAX_HEXNAME_LENGTH - len);
+
+	if (!decode_block(buf, block))
+		return 0;
+	if (block[len / 2 - 1] != '\0' || strlen((char*)block) != len / 2 - 1)
+		return 0;
+
+	memcpy(name, block, len / 2);
+	return 1;
+}
+
+int is_valid_hexname(const char *hex)
+{
+	char name[NAME_LENGTH];
+
+	return decode_hexname(hex, name);
+}
+
+void hexname_to_name(const char *hex, char *name)
+{
+	assert(hex != NULL);
+	assert(name != NULL);
+	assert(hex != name);
+
+	if (!decode_hexname(hex, name))
+		*name = '\0';
+}
+
+void name_to_hexname(const char *name, char *hex)
+{
+	unsigned char block[BLOCK_SIZE];
+	char buf[MAX_HEXNAME_LENGTH];
+	size_t len;
+
+	assert(name != NULL);
+	assert(hex != NULL);
+	assert(name != hex);
+
+	/* Longer names are truncated */
+	for (len = 0; len < BLOCK_SIZE - 1 && name[len]; len++)
+		;
+
+	memcpy(block, name, len);
+	memset(block + len, 0, BLOCK_SIZE - len);
+
+	encode_block(block, buf);
+	memcpy(hex, buf, 2 * len + 2);
+	hex[2 * len + 2] = '\0';
+}
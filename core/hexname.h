@@ -0,0 +1,73 @@
+#ifndef HEXNAME_H
+#define HEXNAME_H
+
+/**
+ * @file hexname.h
+ *
+ * Names are stored in the database as hex strings, so that they can be
+ * used as filenames whatever their encoding is.
+ */
+
+/**
+ * @def NAME_LENGTH
+ *
+ * Teeworlds names cannot have more than 16 characters, including terminating
+ * nul byte.  Name under this form are standard, regular string of whatever
+ * encoding.
+ */
+#define NAME_LENGTH 17
+
+/**
+ * @def HEXNAME_LENGTH
+ *
+ * Hex string represent a regular string on a different form, with only
+ * hexadecimal characters (0-9, a-f).  A pair of two following characters
+ * define a byte of the represented string.
+ *
+ * They are used to convert any string to a valid filename.  In our case only
+ * teeworlds name will be converted to hex string, hence a hex string is twice
+ * as long as a regular string, plus one extra byte for the terminating nul byte.
+ * Hence the value 33 = (16 * 2) + 1 .
+ */
+#define HEXNAME_LENGTH 33
+
+/**
+ * Check wether or not the supplied string is a valid hexadecimal string
+ *
+ * @param hex Hexadecimal string to be checked
+ *
+ * @return 1 if hex is a valid hex string, 0 else
+ */
+int is_valid_hexname(const char *hex);
+
+/**
+ * Convert a hex string to a regular string, only if it is a valid hex
+ * string.  It does both is_valid_hexname() and hexname_to_name() at
+ * once.
+ *
+ * @param hex Hex string to be converted
+ * @param name Buffer of NAME_LENGTH bytes to store result of conversion
+ *
+ * @return 1 if hex is a valid hex string, 0 else
+ */
+int decode_hexname(const char *hex, char *name);
+
+/**
+ * Convert a hex string to a regular string.  Supplied output buffer must
+ * be wide enough to hold the result of the conversion.
+ *
+ * @param hex Hex string to be converted
+ * @param name Buffer to store result of conversion
+ */
+void hexname_to_name(const char *hex, char *name);
+
+/**
+ * Convert a regular string to a hex string.  Supplied output buffer must
+ * be wide enough to hold the result of the conversion.
+ *
+ * @param name Regular string to be converted
+ * @param hex Buffer to store result of conversion
+ */
+void name_to_hexname(const char *name, char *hex);
+
+#endif /* HEXNAME_H */
@@ -3,8 +3,11 @@
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 
 #include "historic.h"
+#include "varint.h"
+#include "crc32.h"
 
 void init_historic(struct historic *hist, size_t data_size,
                    unsigned max_records)
@@ -35,10 +38,38 @@ static unsigned round_length(unsigned length)
 }
 
 /*
- * Does malloc() buffers to fit the required length.  If pre-existing
- * buffers are wide enough, it just use them.  If not, it free() them
- * and malloc() them again.  We are not using realloc() to avoid
- * copying data in the new buffer.
+ * Records are stored along with their data in a single buffer, each
+ * slot being padded so that the next record is properly aligned.
+ */
+static size_t record_size(struct historic *hist)
+{
+	size_t size = sizeof(struct record) + hist->data_size;
+	size_t align = sizeof(struct record);
+
+	return (size + align - 1) / align * align;
+}
+
+static struct record *get_slot(struct historic *hist, unsigned i)
+{
+	return (struct record*)(hist->records + i * record_size(hist));
+}
+
+static unsigned slot_index(struct historic *hist, struct record *record)
+{
+	return ((char*)record - hist->records) / record_size(hist);
+}
+
+/* Return the i-th record, in chronological order */
+static struct record *nth_record(struct historic *hist, unsigned i)
+{
+	return get_slot(hist, (hist->first + i) % hist->length);
+}
+
+/*
+ * Does malloc() buffer to fit the required length.  If pre-existing
+ * buffer is wide enough, it just use it.  If not, it free() it and
+ * malloc() it again.  We are not using realloc() to avoid copying data
+ * in the new buffer.
  */
 static int alloc_historic(struct historic *hist, unsigned length)
 {
@@ -48,24 +79,13 @@ static int alloc_historic(struct historic *hist, unsigned length)
 	assert(length);
 
 	if (length > hist->length) {
+		char *records;
 
-		if (hist->records)
-			free(hist->records);
-		if (hist->data)
-			free(hist->data);
-
-		/* TODO: Call malloc() only once */
-
-		/* Grow records buffer */
-		hist->records = malloc(length * sizeof(*hist->records));
-		if (!hist->records)
-			return 0;
-
-		/* Grow data buffer */
-		hist->data = malloc(length * hist->data_size);
-		if (!hist->data)
-			return 0;
+		if (!(records = malloc(length * record_size(hist))))
+			return perror("malloc(records)"), 0;
 
+		free(hist->records);
+		hist->records = records;
 		hist->length = length;
 	}
 
@@ -74,9 +94,11 @@ static int alloc_historic(struct historic *hist, unsigned length)
 
 static void reset_historic(struct historic *hist)
 {
-	hist->first = NULL;
-	hist->last = NULL;
+	hist->first = 0;
 	hist->nrecords = 0;
+	hist->ntail = 0;
+	hist->tail_size = 0;
+	hist->is_partial = 0;
 }
 
 void create_historic(struct historic *hist)
@@ -87,202 +109,647 @@ void create_historic(struct historic *hist)
 	alloc_historic(hist, 0);
 }
 
-static int read_record(FILE *file, const char *path, time_t epoch, struct record *record, void *data,
-                       read_data_func_t read_data)
+/*
+ * Move records to a new buffer of the given length, unwrapping them so
+ * that the first record is at the beginning of the buffer.
+ */
+static int resize_historic(struct historic *hist, unsigned length)
 {
-	int ret;
+	unsigned n, wrapped;
+	size_t size;
+	char *records;
 
-	assert(data != NULL);
+	assert(length >= hist->nrecords);
 
-	errno = 0;
-	ret = fscanf(file, " %lu", &record->time);
-	if (ret == EOF && errno != 0)
-		return perror(path), 0;
-	else if (ret == EOF && ret == 0)
-		return fprintf(stderr, "%s: Cannot match record time\n", path), 0;
+	if (!(records = malloc(length * record_size(hist))))
+		return perror("malloc(records)"), 0;
+
+	size = record_size(hist);
+	n = hist->nrecords;
+	wrapped = 0;
+	if (hist->first + n > hist->length) {
+		wrapped = hist->first + n - hist->length;
+		n -= wrapped;
+	}
+
+	memcpy(records, get_slot(hist, hist->first), n * size);
+	memcpy(records + n * size, hist->records, wrapped * size);
+
+	free(hist->records);
+	hist->records = records;
+	hist->length = length;
+	hist->first = 0;
+
+	return 1;
+}
+
+/* Only fail when buffer need to grow and malloc() fails */
+static struct record *new_record(struct historic *hist)
+{
+	unsigned i;
+
+	assert(hist != NULL);
+	assert(hist->max_records > 0);
+	assert(hist->nrecords <= hist->max_records);
+
+	if (hist->nrecords == hist->max_records) {
+		/* Recycle first record as the last one */
+		i = (hist->first + hist->nrecords) % hist->length;
+		hist->first = (hist->first + 1) % hist->length;
+	} else {
+		if (hist->nrecords == hist->length)
+			if (!resize_historic(hist, round_length(hist->length)))
+				return NULL;
+
+		i = (hist->first + hist->nrecords) % hist->length;
+		hist->nrecords++;
+	}
+
+	return get_slot(hist, i);
+}
+
+/*
+ * Records are grouped in blocks of BLOCK_LENGTH records, starting
+ * from the oldest one, hence only the last block may not be full.
+ * Blocks are written from the newest to the oldest, so that appending
+ * records only changes the first blocks: the following ones are kept
+ * as is by read_historic().
+ *
+ * A block is made of its number of records, the size of its payload,
+ * the payload itself and the CRC-32 of the payload.  In the payload,
+ * the time and data of each record are delta encoded from the
+ * previous record, using zig-zag varints.
+ *
+ * Historics start with the number of records and the epoch, followed
+ * by an index holding the time of the first record of each block and
+ * the offset of the block from the end of the file.
+ */
+#define BLOCK_LENGTH 32
+
+#define CHECKSUM_SIZE 4
+#define MAX_PAYLOAD_SIZE (BLOCK_LENGTH * (MAX_VARINT_SIZE + MAX_ENCODED_SIZE))
+#define MAX_BLOCK_SIZE (2 * MAX_VARINT_SIZE + MAX_PAYLOAD_SIZE + CHECKSUM_SIZE)
+
+static unsigned index_length(unsigned nrecords)
+{
+	return (nrecords + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+}
+
+static unsigned block_length(unsigned nrecords, unsigned block)
+{
+	if ((block + 1) * BLOCK_LENGTH <= nrecords)
+		return BLOCK_LENGTH;
+	return nrecords - block * BLOCK_LENGTH;
+}
+
+static int alloc_index(struct historic *hist, unsigned nrecords)
+{
+	unsigned length = index_length(nrecords);
 
-	record->time += epoch;
+	if (length > hist->index_length) {
+		struct index_entry *index;
 
-	if (!read_data(file, path, data))
+		length = round_length(length);
+		index = realloc(hist->index, length * sizeof(*index));
+		if (!index)
+			return perror("realloc(index)"), 0;
+
+		hist->index = index;
+		hist->index_length = length;
+	}
+
+	return 1;
+}
+
+static int read_varint(struct scanner *sc, unsigned long *value)
+{
+	const unsigned char *buf;
+
+	buf = get_varint((unsigned char*)sc->pos, (unsigned char*)sc->end, value);
+	if (!buf) {
+		fprintf(stderr, "%s: Cannot match varint\n", sc->path);
 		return 0;
+	}
 
+	sc->pos = (char*)buf;
 	return 1;
 }
 
-static int read_historic_header(FILE *file, const char *path,
+static int read_historic_header(struct scanner *sc,
                                 unsigned *nrecords, time_t *epoch)
 {
-	int ret;
+	unsigned long value;
 
 	assert(nrecords != NULL);
 	assert(epoch != NULL);
 
-	errno = 0;
-	ret = fscanf(file, " %u records starting at %lu\n", nrecords, epoch);
-	if (ret == EOF && errno != 0)
-		return fprintf(stderr, "%s: %s\n", path, strerror(errno)), 0;
-	else if (ret == EOF || ret == 0)
-		return fprintf(stderr, "%s: Cannot match number of record\n", path), 0;
-	else if (ret == 1)
-		return fprintf(stderr, "%s: Cannot match epoch\n", path), 0;
+	if (!read_varint(sc, &value))
+		return 0;
+	*nrecords = value;
+
+	if (!read_varint(sc, &value))
+		return 0;
+	*epoch = value;
 
 	return 1;
 }
 
-/* Can never fail */
-static struct record *new_record(struct historic *hist)
+static int read_index(struct historic *hist, struct scanner *sc, unsigned nrecords)
 {
-	assert(hist != NULL);
-	assert(hist->max_records > 0);
-	assert(hist->nrecords <= hist->max_records);
+	unsigned long time, offset;
+	unsigned i;
 
-	if (hist->nrecords == hist->max_records) {
-		/* Recycle first record as the last one */
-		hist->last->next = hist->first;
-		hist->first->prev = hist->last;
-		hist->first = hist->first->next;
-		hist->last = hist->last->next;
-	} else {
-		struct record *rec;
+	if (!alloc_index(hist, nrecords))
+		return 0;
+
+	for (i = 0; i < index_length(nrecords); i++) {
+		if (!read_varint(sc, &time))
+			return 0;
+		if (!read_varint(sc, &offset))
+			return 0;
 
-		assert(hist->nrecords < hist->length);
+		hist->index[i].time = hist->epoch + unzigzag(time);
+		hist->index[i].offset = offset;
+	}
 
-		rec = &hist->records[hist->nrecords];
-		hist->nrecords++;
+	return 1;
+}
 
-		if (!hist->first) {
-			hist->first = rec;
-			hist->last = rec;
-		} else {
-			hist->last->next = rec;
-			rec->prev = hist->last;
-			hist->last = rec;
-		}
+/*
+ * Decode a block in the given consecutive slots, in chronological
+ * order.  Return a pointer to the byte following the block, NULL on
+ * failure.
+ */
+static const unsigned char *decode_block(
+	struct historic *hist, const char *path, unsigned length,
+	const unsigned char *buf, const unsigned char *end, unsigned slot)
+{
+	unsigned long nrecords, size, value;
+	const unsigned char *payload;
+	unsigned long checksum;
+	time_t time = hist->epoch;
+	void *prev = NULL;
+	unsigned i;
+
+	if (!(buf = get_varint(buf, end, &nrecords)))
+		goto fail;
+	if (!(buf = get_varint(buf, end, &size)))
+		goto fail;
+	if (nrecords != length || size + CHECKSUM_SIZE > (unsigned long)(end - buf))
+		goto fail;
+
+	payload = buf;
+	end = buf + size;
+
+	checksum = (unsigned long)end[0] | (unsigned long)end[1] << 8
+		| (unsigned long)end[2] << 16 | (unsigned long)end[3] << 24;
+	if (crc32(0, payload, size) != checksum) {
+		fprintf(stderr, "%s: Historic block checksum mismatch\n", path);
+		return NULL;
 	}
 
-	/* Those invariants should always hold */
-	hist->first->prev = NULL;
-	hist->last->next = NULL;
+	for (i = 0; i < length; i++) {
+		struct record *rec = get_slot(hist, slot + i);
+
+		if (!(buf = get_varint(buf, end, &value)))
+			goto fail;
+		rec->time = time += unzigzag(value);
 
-	return hist->last;
+		buf = hist->decode_data(buf, end, record_data(hist, rec), prev);
+		if (!buf)
+			goto fail;
+
+		prev = record_data(hist, rec);
+	}
+
+	if (buf != end)
+		goto fail;
+
+	return end + CHECKSUM_SIZE;
+
+fail:
+	fprintf(stderr, "%s: Invalid historic block\n", path);
+	return NULL;
 }
 
-int read_historic(struct historic *hist, FILE *file, const char *path,
-                  read_data_func_t read_data)
+static int read_block(struct historic *hist, struct scanner *sc,
+                      unsigned length, unsigned slot)
+{
+	const unsigned char *buf;
+
+	buf = decode_block(hist, sc->path, length, (unsigned char*)sc->pos,
+	                   (unsigned char*)sc->end, slot);
+	if (!buf)
+		return 0;
+
+	sc->pos = (char*)buf;
+	return 1;
+}
+
+/* Keep every bytes left in the scanner as the tail */
+static int read_tail(struct historic *hist, struct scanner *sc)
+{
+	size_t size = sc->end - sc->pos;
+
+	if (size > hist->tail_length) {
+		unsigned char *tail;
+
+		if (!(tail = realloc(hist->tail, size)))
+			return perror("realloc(tail)"), 0;
+
+		hist->tail = tail;
+		hist->tail_length = size;
+	}
+
+	memcpy(hist->tail, sc->pos, size);
+	hist->tail_size = size;
+	sc->pos = sc->end;
+
+	return 1;
+}
+
+static int read_records(struct historic *hist, struct scanner *sc)
 {
 	unsigned i;
 
+	if (!alloc_historic(hist, hist->nrecords))
+		return 0;
+
+	/* Blocks are written from the newest to the oldest... */
+	for (i = index_length(hist->nrecords); i > 0; i--)
+		if (!read_block(hist, sc, block_length(hist->nrecords, i - 1),
+		                (i - 1) * BLOCK_LENGTH))
+			return 0;
+
+	return 1;
+}
+
+/*
+ * Only the newest block is decoded: other blocks are kept as is in the
+ * tail.  They are written back verbatim by write_historic(), unless
+ * they have been loaded in the meantime.
+ */
+static int read_records_lazily(struct historic *hist, struct scanner *sc)
+{
+	unsigned nblocks = index_length(hist->nrecords);
+	unsigned length = block_length(hist->nrecords, nblocks - 1);
+
+	if (!alloc_historic(hist, length))
+		return 0;
+	if (!read_block(hist, sc, length, 0))
+		return 0;
+	if (!read_tail(hist, sc))
+		return 0;
+
+	hist->ntail = hist->nrecords - length;
+	hist->nrecords = length;
+
+	return 1;
+}
+
+int read_historic(struct historic *hist, struct scanner *sc,
+                  decode_data_func_t decode_data)
+{
 	assert(hist != NULL);
-	assert(file != NULL);
-	assert(path != NULL);
-	assert(read_data != NULL);
+	assert(sc != NULL);
+	assert(decode_data != NULL);
 
 	reset_historic(hist);
+	hist->decode_data = decode_data;
 
-	if (!read_historic_header(file, path, &hist->nrecords, &hist->epoch))
+	if (!read_historic_header(sc, &hist->nrecords, &hist->epoch))
 		return 0;
 
 	if (hist->nrecords == 0) {
-		fprintf(stderr, "%s: Empty historic forbidden\n", path);
+		fprintf(stderr, "%s: Empty historic forbidden\n", sc->path);
 		return 0;
 	}
 
-	if (!alloc_historic(hist, hist->nrecords))
+	if (!read_index(hist, sc, hist->nrecords))
 		return 0;
 
-	for (i = 0; i < hist->nrecords; i++) {
-		struct record *rec;
-		void *data;
+	/*
+	 * Undecoded records would make recycling records a lot harder, so
+	 * bounded historics are always fully loaded.
+	 */
+	if (hist->max_records != UINT_MAX)
+		return read_records(hist, sc);
+	else
+		return read_records_lazily(hist, sc);
+}
+
+/* Reverse "n" records starting at the given slot */
+static void reverse_records(struct historic *hist, unsigned slot, unsigned n)
+{
+	unsigned i, j;
+	struct record *tmp;
 
-		/* Records are written in reverse order... */
-		rec = &hist->records[hist->nrecords - i - 1];
-		data = record_data(hist, rec);
+	if (n < 2)
+		return;
 
-		/* Link record with the previous one and next one */
-		if (i > 0)
-			rec->next = rec + 1;
-		if (i < hist->nrecords - 1)
-			rec->prev = rec - 1;
+	assert(hist->nrecords < hist->length);
 
-		if (i != 0)
-			fscanf(file, " ,");
-		if (read_record(file, path, hist->epoch, rec, data, read_data) == 0)
+	tmp = get_slot(hist, hist->length - 1);
+	for (i = slot, j = slot + n - 1; i < j; i++, j--) {
+		memcpy(tmp, get_slot(hist, i), record_size(hist));
+		memcpy(get_slot(hist, i), get_slot(hist, j), record_size(hist));
+		memcpy(get_slot(hist, j), tmp, record_size(hist));
+	}
+}
+
+int read_historic_query(struct historic *hist, struct scanner *sc,
+                        decode_data_func_t decode_data, const struct historic_query *query)
+{
+	unsigned nrecords, block;
+	long offset;
+
+	assert(hist != NULL);
+	assert(sc != NULL);
+	assert(decode_data != NULL);
+	assert(query != NULL);
+
+	reset_historic(hist);
+	hist->decode_data = decode_data;
+	hist->is_partial = 1;
+
+	if (!read_historic_header(sc, &nrecords, &hist->epoch))
+		return 0;
+	if (!read_index(hist, sc, nrecords))
+		return 0;
+
+	/* Find the newest block starting before "end" */
+	block = index_length(nrecords);
+	if (query->end)
+		while (block > 0 && hist->index[block - 1].time > query->end)
+			block--;
+
+	if (block == 0)
+		return 1;
+
+	offset = hist->index[block - 1].offset;
+	if (offset > sc->end - sc->pos) {
+		fprintf(stderr, "%s: Invalid historic index\n", sc->path);
+		return 0;
+	}
+	sc->pos = sc->end - offset;
+
+	if (!alloc_historic(hist, 0))
+		return 0;
+
+	/*
+	 * Records are collected from the newest to the oldest, then put
+	 * back in chronological order.
+	 */
+	for (; block > 0; block--) {
+		unsigned i, length = block_length(nrecords, block - 1);
+		unsigned slot = hist->nrecords;
+
+		/* Keep one free slot for reverse_records() */
+		if (slot + length >= hist->length)
+			if (!resize_historic(hist, round_length(slot + length)))
+				return 0;
+
+		if (!read_block(hist, sc, length, slot))
 			return 0;
+		reverse_records(hist, slot, length);
+
+		for (i = 0; i < length; i++) {
+			struct record *rec = get_slot(hist, slot + i);
+
+			if (rec->time < query->start)
+				goto end;
+			if (query->end && rec->time > query->end)
+				continue;
+
+			if (rec != get_slot(hist, hist->nrecords))
+				memcpy(get_slot(hist, hist->nrecords), rec, record_size(hist));
+			hist->nrecords++;
+
+			if (query->max_records && hist->nrecords == query->max_records)
+				goto end;
+		}
 	}
 
-	hist->first = &hist->records[0];
-	hist->last = &hist->records[hist->nrecords - 1];
-	hist->last->next = NULL;
-	hist->first->prev = NULL;
+end:
+	reverse_records(hist, 0, hist->nrecords);
+	return 1;
+}
+
+int load_historic(struct historic *hist)
+{
+	const char *path = "historic";
+	const unsigned char *buf, *end;
+	unsigned i, n;
+
+	assert(hist != NULL);
+
+	if (!hist->ntail)
+		return 1;
+
+	/*
+	 * Unwrap loaded records at the beginning of the buffer, then move
+	 * them at the end to make room for the tail.
+	 */
+	n = hist->nrecords;
+	if (!resize_historic(hist, round_length(n + hist->ntail)))
+		return 0;
+
+	memmove(get_slot(hist, hist->ntail), get_slot(hist, 0), n * record_size(hist));
+
+	/* ...the tail is only made of full blocks, newest first */
+	buf = hist->tail;
+	end = hist->tail + hist->tail_size;
+	for (i = index_length(hist->ntail); i > 0; i--) {
+		buf = decode_block(hist, path, BLOCK_LENGTH, buf, end, (i - 1) * BLOCK_LENGTH);
+		if (!buf)
+			return 0;
+	}
+
+	hist->nrecords += hist->ntail;
+	hist->ntail = 0;
+	hist->tail_size = 0;
 
 	return 1;
 }
 
-static void write_record(FILE *file, const char *path, struct historic *hist, struct record *record,
-                         write_data_func_t write_data)
+/*
+ * Encode a block of records starting at the given position, return a
+ * pointer to the byte following the block.
+ */
+static unsigned char *encode_block(
+	struct historic *hist, unsigned char *buf, unsigned pos, unsigned length)
 {
-	fprintf(file, "%lu ", record->time - hist->epoch);
-	write_data(file, path, record_data(hist, record));
+	static unsigned char payload[MAX_PAYLOAD_SIZE];
+	unsigned char *p = payload;
+	unsigned long checksum;
+	time_t time = hist->epoch;
+	void *prev = NULL;
+	unsigned i;
+
+	for (i = 0; i < length; i++) {
+		struct record *rec = nth_record(hist, pos + i);
+
+		p = put_varint(p, zigzag(rec->time - time));
+		p = hist->encode_data(p, record_data(hist, rec), prev);
+
+		time = rec->time;
+		prev = record_data(hist, rec);
+	}
+
+	buf = put_varint(buf, length);
+	buf = put_varint(buf, p - payload);
+	memcpy(buf, payload, p - payload);
+	buf += p - payload;
+
+	checksum = crc32(0, payload, p - payload);
+	*buf++ = checksum & 0xff;
+	*buf++ = (checksum >> 8) & 0xff;
+	*buf++ = (checksum >> 16) & 0xff;
+	*buf++ = (checksum >> 24) & 0xff;
+
+	return buf;
 }
 
 int write_historic(struct historic *hist, FILE *file, const char *path,
-                   write_data_func_t write_data)
+                   encode_data_func_t encode_data)
 {
-	struct record *rec;
+	unsigned char header[MAX_VARINT_SIZE * 2];
+	unsigned char *buf, *end;
+	unsigned i, nrecords, first_block, nblocks;
+	size_t size;
 
 	assert(hist != NULL);
 	assert(file != NULL);
 	assert(path != NULL);
-	assert(write_data != NULL);
+	assert(encode_data != NULL);
+
+	if (hist->is_partial) {
+		fprintf(stderr, "%s: Cannot write a partially read historic\n", path);
+		return 0;
+	}
+
+	hist->encode_data = encode_data;
+
+	nrecords = hist->nrecords + hist->ntail;
+	if (!alloc_index(hist, nrecords))
+		return 0;
+
+	/* The tail is only made of full blocks */
+	first_block = hist->ntail / BLOCK_LENGTH;
+	nblocks = index_length(nrecords);
+
+	if (!(buf = malloc((nblocks - first_block) * MAX_BLOCK_SIZE + 1)))
+		return perror("malloc(blocks)"), 0;
+
+	/* Loaded blocks, newest first, offsets are from "buf" for now */
+	end = buf;
+	for (i = nblocks; i > first_block; i--) {
+		unsigned pos = (i - 1) * BLOCK_LENGTH - hist->ntail;
+
+		hist->index[i - 1].time = nth_record(hist, pos)->time;
+		hist->index[i - 1].offset = end - buf;
+		end = encode_block(hist, end, pos, block_length(nrecords, i - 1));
+	}
 
-	fprintf(file, "%u records starting at %lu\n", hist->nrecords, hist->epoch);
+	size = end - buf;
+	for (i = first_block; i < nblocks; i++)
+		hist->index[i].offset = size - hist->index[i].offset + hist->tail_size;
 
-	for (rec = hist->last; rec; rec = rec->prev) {
-		if (rec != hist->last)
-			fprintf(file, ", ");
+	end = put_varint(header, nrecords);
+	end = put_varint(end, hist->epoch);
+	fwrite(header, 1, end - header, file);
 
-		write_record(file, path, hist, rec, write_data);
+	for (i = 0; i < nblocks; i++) {
+		end = put_varint(header, zigzag(hist->index[i].time - hist->epoch));
+		end = put_varint(end, hist->index[i].offset);
+		fwrite(header, 1, end - header, file);
 	}
 
-	fputc('\n', file);
+	fwrite(buf, 1, size, file);
+	free(buf);
+
+	fwrite(hist->tail, 1, hist->tail_size, file);
+
+	if (ferror(file))
+		return perror(path), 0;
 
 	return 1;
 }
 
 void *record_data(struct historic *hist, struct record *record)
 {
-	return (char*)hist->data + (record - hist->records) * hist->data_size;
+	return record + 1;
 }
 
-void append_record(struct historic *hist, const void *data)
+struct record *first_record(struct historic *hist)
 {
-	struct record *rec;
-	time_t now = time(NULL);
+	if (!hist->nrecords)
+		return NULL;
+	return get_slot(hist, hist->first);
+}
 
-	assert(hist != NULL);
+struct record *last_record(struct historic *hist)
+{
+	if (!hist->nrecords)
+		return NULL;
+	return get_slot(hist, (hist->first + hist->nrecords - 1) % hist->length);
+}
 
-	rec = new_record(hist);
-	rec->time = now;
-	memcpy(record_data(hist, rec), data, hist->data_size);
+unsigned record_index(struct historic *hist, struct record *record)
+{
+	return (slot_index(hist, record) + hist->length - hist->first) % hist->length;
 }
 
-static void skip_records(FILE *file)
+struct record *prev_record(struct historic *hist, struct record *record)
 {
-	int c;
+	unsigned i = slot_index(hist, record);
 
-	do
-		c = fgetc(file);
-	while (c != EOF && c != '\n');
+	if (i == hist->first)
+		return NULL;
+	return get_slot(hist, (i + hist->length - 1) % hist->length);
 }
 
-int read_historic_summary(struct historic_summary *hs, FILE *file, const char *path)
+struct record *next_record(struct historic *hist, struct record *record)
 {
-	if (read_historic_header(file, path, &hs->nrecords, &hs->epoch) == 0)
+	unsigned i = slot_index(hist, record);
+
+	if (record == last_record(hist))
+		return NULL;
+	return get_slot(hist, (i + 1) % hist->length);
+}
+
+int append_record(struct historic *hist, const void *data)
+{
+	return append_record_at(hist, data, time(NULL));
+}
+
+int append_record_at(struct historic *hist, const void *data, time_t time)
+{
+	struct record *rec;
+
+	assert(hist != NULL);
+
+	/*
+	 * Records are written relative to epoch, hence it can't be after.
+	 * Undecoded records are relative to the current epoch, so they must
+	 * be loaded before changing it.
+	 */
+	if (time < hist->epoch) {
+		if (!load_historic(hist))
+			return 0;
+		hist->epoch = time;
+	}
+
+	if (!(rec = new_record(hist)))
 		return 0;
 
-        if (hs->nrecords == 0)
-	        return 1;
+	rec->time = time;
+	memcpy(record_data(hist, rec), data, hist->data_size);
 
-        skip_records(file);
-        return 1;
+	return 1;
+}
+
+int read_historic_summary(struct historic_summary *hs, struct scanner *sc)
+{
+	return read_historic_header(sc, &hs->nrecords, &hs->epoch);
 }
@@ -19,9 +19,9 @@
  *
  * Here is how to append a record to a file:
  *
- * 	read_historic(&hist, file, path, read_elo);
+ * 	read_historic(&hist, &sc, decode_elo);
  * 	append_record(&hist, &new_elo);
- * 	write_historic(&hist, file, path, write_elo);
+ * 	write_historic(&hist, file, path, encode_elo);
  *
  * This example does not check return values, a compliant
  * implementation should.
@@ -30,19 +30,49 @@
 #include <stdio.h>
 #include <time.h>
 
+#include "scanner.h"
+
 /**
  * @struct record
  *
  * To each record is associated data, wich can be retrieved using
  * record_data().  The record hold by itself the timestamp at wich
- * the associated data was recorded.  However data are stored in an
- * other buffer, hence record_data() to retrieve it.
+ * the associated data was recorded.  Data is stored right after the
+ * record, hence record_data() to retrieve it.
  */
 struct record {
 	time_t time;
-	struct record *prev, *next;
 };
 
+/**
+ * @struct index_entry
+ *
+ * Time of an indexed record, and its offset from the end of the file.
+ */
+struct index_entry {
+	time_t time;
+	long offset;
+};
+
+/**
+ * @def MAX_ENCODED_SIZE
+ *
+ * Maximum size of encoded record data.
+ */
+#define MAX_ENCODED_SIZE 64
+
+/*
+ * Record data are stored in binary form.  Data can be encoded relative
+ * to the data of the previous record, which is NULL for the first
+ * record of a block.  Encoders must not write more than
+ * MAX_ENCODED_SIZE bytes.  Both functions return a pointer to the byte
+ * following encoded data, decoders return NULL when data is invalid.
+ */
+typedef unsigned char *(*encode_data_func_t)(
+	unsigned char *buf, const void *data, const void *prev);
+typedef const unsigned char *(*decode_data_func_t)(
+	const unsigned char *buf, const unsigned char *end, void *data, const void *prev);
+
 /**
  * @struct historic
  *
@@ -53,17 +83,35 @@ struct historic {
 
 	unsigned nrecords;
 	unsigned max_records;
-	unsigned length;
-	struct record *records;
 
-	struct record *first, *last;
+	/*
+	 * Records and their data are stored in a single circular buffer
+	 * of "length" slots, the oldest record being at index "first".
+	 */
+	unsigned length;
+	unsigned first;
+	char *records;
 
 	size_t data_size;
-	void *data;
-};
 
-typedef int (*read_data_func_t)(FILE *, const char *, void *);
-typedef int (*write_data_func_t)(FILE *, const char *, void *);
+	/*
+	 * Records not decoded yet, as found in the file.  They are all
+	 * older than the first loaded record.
+	 */
+	unsigned ntail;
+	unsigned char *tail;
+	size_t tail_size, tail_length;
+
+	encode_data_func_t encode_data;
+	decode_data_func_t decode_data;
+
+	/* Sparse index of records, see write_historic() */
+	unsigned index_length;
+	struct index_entry *index;
+
+	/* Set when only some records have been read, see read_historic_query() */
+	int is_partial;
+};
 
 /**
  * Initialize an historic.
@@ -97,38 +145,88 @@ void init_historic(struct historic *hist, size_t data_size,
 void create_historic(struct historic *hist);
 
 /**
- * Fill an historic from the content of a file.
+ * Fill an historic from the content of a scanned file.
  *
  * init_history() *must* have been previously applied to the historic iff it is
  * the first time this function is applied to this history.
  *
  * It can reuse allocated buffers from a previous call to read_historic().
  *
+ * Unless the historic have a maximum number of records, only the last
+ * records are loaded.  Other records are kept undecoded and written
+ * back as is by write_historic(), so that appending a record does not
+ * require to decode the whole historic.  Use load_historic() before
+ * iterating over records.
+ *
+ * The historic must be the last thing in the file, and the whole file
+ * must have been read by open_scanner().
+ *
+ * @param hist Historic to be filled
+ * @param sc Scanner positioned at the beginning of the historic
+ * @param decode_data Function called to decode the data of each record
+ *
+ * @return 1 on success, 0 on failure
+ */
+int read_historic(struct historic *hist, struct scanner *sc,
+                  decode_data_func_t decode_data);
+
+/**
+ * @struct historic_query
+ *
+ * Select records to read with read_historic_query(): the last
+ * "max_records" records recorded between "start" and "end".  When
+ * "end" is 0, there is no upper bound.  When "max_records" is 0,
+ * there is no limit on the number of records.
+ */
+struct historic_query {
+	time_t start, end;
+	unsigned max_records;
+};
+
+/**
+ * Fill an historic with only the records selected by the given query.
+ *
+ * Historics are indexed, so that only selected records are actually
+ * read.  The resulting historic is read-only: it cannot be written
+ * with write_historic().
+ *
  * @param hist Historic to be filled
- * @param file Opened file to be read
- * @param path Used as a prefix for error message
- * @param read_data Function called each time a data should be read.  It must
- *        handle it's own errors and the result should be placed into data.
+ * @param sc Scanner positioned at the beginning of the historic
+ * @param decode_data Function called to decode the data of each record
+ * @param query Records to read
  *
  * @return 1 on success, 0 on failure
  */
-int read_historic(struct historic *hist, FILE *file, const char *path,
-                  read_data_func_t read_data);
+int read_historic_query(struct historic *hist, struct scanner *sc,
+                        decode_data_func_t decode_data, const struct historic_query *query);
+
+/**
+ * Load every records of an historic previously read by read_historic().
+ *
+ * @param hist Historic to be fully loaded
+ *
+ * @return 1 on success, 0 on failure
+ */
+int load_historic(struct historic *hist);
 
 /**
  * Write the given historic to the given file.
  *
- * On success, the historic can be read back with read_data().
+ * On success, the historic can be read back with read_historic().
+ *
+ * Records are written in binary form, by blocks indexed by time.
+ * Offsets stored in the index are relative to the end of the file,
+ * hence the historic must be the last thing written to the file.
  *
  * @param hist Historic to be written
  * @param file File to be written
  * @param path Used as a prefix for error messages
- * @param write_data Function called each time a data should be written.
+ * @param encode_data Function called to encode the data of each record
  *
  * @return 1 on success, 0 on failure
  */
 int write_historic(struct historic *hist, FILE *file, const char *path,
-                   write_data_func_t write_data);
+                   encode_data_func_t encode_data);
 
 /**
  * Return a pointer to the associated data of the given record.
@@ -140,13 +238,76 @@ int write_historic(struct historic *hist, FILE *file, const char *path,
  */
 void *record_data(struct historic *hist, struct record *record);
 
+/**
+ * Return the oldest record of the given historic.
+ *
+ * @param hist Historic to get the record from
+ *
+ * @return Oldest record, or NULL when the historic is empty
+ */
+struct record *first_record(struct historic *hist);
+
+/**
+ * Return the most recent record of the given historic.
+ *
+ * @param hist Historic to get the record from
+ *
+ * @return Most recent record, or NULL when the historic is empty
+ */
+struct record *last_record(struct historic *hist);
+
+/**
+ * Return the position of the given record, the oldest record being
+ * at position 0.
+ *
+ * @param hist Historic the given record belongs to
+ * @param record Record to get the position of
+ *
+ * @return Position of the record
+ */
+unsigned record_index(struct historic *hist, struct record *record);
+
+/**
+ * Return the record recorded just before the given one.
+ *
+ * @param hist Historic the given record belongs to
+ * @param record Record to get the previous one
+ *
+ * @return Previous record, or NULL for the first record
+ */
+struct record *prev_record(struct historic *hist, struct record *record);
+
+/**
+ * Return the record recorded just after the given one.
+ *
+ * @param hist Historic the given record belongs to
+ * @param record Record to get the next one
+ *
+ * @return Next record, or NULL for the last record
+ */
+struct record *next_record(struct historic *hist, struct record *record);
+
 /**
  * Add a record at the end of the given historic.
  *
  * @param hist Historic where the data must be added
  * @param data Data to be recorded
+ *
+ * @return 1 on success, 0 on failure
+ */
+int append_record(struct historic *hist, const void *data);
+
+/**
+ * Add a record recorded at the given time at the end of the given
+ * historic.  Time must not be before the last record time.
+ *
+ * @param hist Historic where the data must be added
+ * @param data Data to be recorded
+ * @param time Time at wich the data was recorded
+ *
+ * @return 1 on success, 0 on failure
  */
-void append_record(struct historic *hist, const void *data);
+int append_record_at(struct historic *hist, const void *data, time_t time);
 
 /**
  * @struct historic_summary
@@ -159,15 +320,13 @@ struct historic_summary {
 };
 
 /**
- * Fill the given historic summary with the content of the given file
+ * Fill the given historic summary with the content of the given scanner
  *
  * @param hs Historic summary to fill
- * @param file File to read the historic summary from
- * @param path Used as a prefix for error message
- * @param skip_data Function called to skip unused historic data
+ * @param sc Scanner positioned at the beginning of the historic
  *
  * @return 1 on success, 0 on failure
  */
-int read_historic_summary(struct historic_summary *hs, FILE *file, const char *path);
+int read_historic_summary(struct historic_summary *hs, struct scanner *sc);
 
 #endif /* HISTORIC_H */
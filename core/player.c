@@ -5,78 +5,21 @@
 #include <sys/stat.h>
 #include <string.h>
 #include <errno.h>
-#include <ctype.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "player.h"
+#include "dict.h"
+#include "commit.h"
+#include "varint.h"
 #include "config.h"
 #include "elo.h"
 
 /* Minimum time between two entries */
 #define HISTORY_TIMEFRAME_LENGTH 3600
 
-static int is_valid_hexpair(const char *hex)
-{
-	char c1, c2;
-
-	if (hex[0] == '\0' || hex[1] == '\0')
-		return 0;
-
-	c1 = hex[0];
-	c2 = hex[1];
-
-	if (!isxdigit(c1) || !isxdigit(c2))
-		return 0;
-
-	if (c1 == '0' && c2 == '0')
-		return 0;
-
-	return 1;
-}
-
-static int is_terminating_hexpair(const char *hex)
-{
-	if (hex[0] == '\0' || hex[1] == '\0')
-		return 0;
-
-	return hex[0] == '0' && hex[1] == '0' && hex[2] == '\0';
-}
-
-int is_valid_hexname(const char *hex)
-{
-	assert(hex != NULL);
-
-	while (is_valid_hexpair(hex))
-		hex += 2;
-
-	return is_terminating_hexpair(hex);
-}
-
-void hexname_to_name(const char *hex, char *name)
-{
-	assert(hex != NULL);
-	assert(name != NULL);
-	assert(hex != name);
-
-	for (; hex[0] != '0' || hex[1] != '0'; hex += 2, name++) {
-		char tmp[3] = { hex[0], hex[1], '\0' };
-		*name = strtol(tmp, NULL, 16);
-	}
-
-	*name = '\0';
-}
-
-void name_to_hexname(const char *name, char *hex)
-{
-	assert(name != NULL);
-	assert(hex != NULL);
-	assert(name != hex);
-
-	for (; *name; name++, hex += 2)
-		sprintf(hex, "%2x", *(unsigned char*)name);
-	strcpy(hex, "00");
-}
-
 void init_player(struct player *player)
 {
 	static const struct player PLAYER_ZERO;
@@ -85,14 +28,14 @@ void init_player(struct player *player)
 	init_historic(&player->hist, sizeof(struct player_record),  UINT_MAX);
 }
 
-static char *get_path(const char *name)
+char *get_player_path(const char *name)
 {
 	static char path[PATH_MAX];
 
 	assert(name != NULL);
 
-	if (snprintf(path, PATH_MAX, "%s/players/%s",
-	             config.root, name) >= PATH_MAX)
+	if (snprintf(path, PATH_MAX, "%s/players/%02x/%s",
+	             config.root, get_player_shard(name), name) >= PATH_MAX)
 		return NULL;
 	return path;
 }
@@ -135,59 +78,108 @@ void create_player(struct player *player, const char *name)
 	player->is_modified = IS_MODIFIED_CREATED;
 }
 
-static int read_player_record(FILE *file, const char *path, void *buf)
+void init_player_record(struct player_record *rec, int elo, unsigned rank)
 {
-	int ret;
-	struct player_record *rec = buf;
-
-	errno = 0;
-	ret = fscanf(file, " %d %u", &rec->elo, &rec->rank);
-	if (ret == EOF && errno != 0)
-		return perror(path), 0;
-	else if (ret == EOF || ret == 0)
-		return fprintf(stderr, "%s: Cannot match elo\n", path), 0;
-	else if (ret == 1)
-		return fprintf(stderr, "%s: Cannot match rank\n", path), 0;
+	rec->elo = elo;
+	rec->rank = rank;
 
-	return 1;
+	rec->tier = RAW_RECORD;
+	rec->min_elo = rec->max_elo = elo;
+	rec->min_rank = rec->max_rank = rank;
 }
 
-static int read_clan(FILE *file, const char *path, char *clan)
+/*
+ * Elo and rank are encoded relative to the previous record.  The lowest
+ * bit of the elo delta tells if the record is aggregated, in which
+ * case it is followed by its tier and the range of elos and ranks
+ * relative to the record values.
+ */
+static unsigned char *encode_player_record(
+	unsigned char *buf, const void *data, const void *prev_data)
 {
-	int ret;
+	const struct player_record *rec = data, *prev = prev_data;
+	long elo = 0, rank = 0;
+	int is_aggregated = rec->tier != RAW_RECORD;
 
-	errno = 0;
-	ret = fscanf(file, " %s\n", clan);
+	if (prev) {
+		elo = prev->elo;
+		rank = prev->rank;
+	}
 
-	if (ret == EOF && errno != 0) {
-		perror(path);
-		return 0;
-	} else if (ret == EOF || ret == 0) {
-		fprintf(stderr, "%s: Cannot match player clan\n", path);
-		return 0;
+	buf = put_varint(buf, zigzag(rec->elo - elo) << 1 | is_aggregated);
+	buf = put_varint(buf, zigzag((long)rec->rank - rank));
+
+	if (is_aggregated) {
+		*buf++ = rec->tier;
+		buf = put_varint(buf, zigzag(rec->min_elo - rec->elo));
+		buf = put_varint(buf, zigzag(rec->max_elo - rec->elo));
+		buf = put_varint(buf, zigzag((long)rec->min_rank - (long)rec->rank));
+		buf = put_varint(buf, zigzag((long)rec->max_rank - (long)rec->rank));
 	}
 
-	return 1;
+	return buf;
 }
 
-static int read_player_header(FILE *file, const char *path, struct player *player)
+static const unsigned char *decode_player_record(
+	const unsigned char *buf, const unsigned char *end, void *data, const void *prev_data)
 {
-	struct player_record rec;
+	struct player_record *rec = data;
+	const struct player_record *prev = prev_data;
+	unsigned long elo, rank, range[4];
+	unsigned i;
 
-	if (!read_clan(file, path, player->clan))
-		return 0;
-	if (!read_player_record(file, path, &rec))
-		return 0;
+	if (!(buf = get_varint(buf, end, &elo)))
+		return NULL;
+	if (!(buf = get_varint(buf, end, &rank)))
+		return NULL;
+
+	init_player_record(
+		rec, unzigzag(elo >> 1) + (prev ? prev->elo : 0),
+		unzigzag(rank) + (prev ? prev->rank : 0));
+
+	if (!(elo & 1))
+		return buf;
+
+	if (buf == end || (*buf != DAILY_RECORD && *buf != WEEKLY_RECORD))
+		return NULL;
+	rec->tier = *buf++;
 
-	player->elo = rec.elo;
-	player->rank = rec.rank;
+	for (i = 0; i < 4; i++)
+		if (!(buf = get_varint(buf, end, &range[i])))
+			return NULL;
+
+	rec->min_elo = rec->elo + unzigzag(range[0]);
+	rec->max_elo = rec->elo + unzigzag(range[1]);
+	rec->min_rank = rec->rank + unzigzag(range[2]);
+	rec->max_rank = rec->rank + unzigzag(range[3]);
+
+	return buf;
+}
+
+/*
+ * Player files start with the clan and the elo and rank of the player,
+ * both on their own line, followed by the binary historic.
+ */
+static int read_player_header(struct scanner *sc, char *clan, int *elo, unsigned *rank)
+{
+	if (!scan_hexname(sc, clan))
+		return fprintf(stderr, "%s: Cannot match player clan\n", sc->path), 0;
+	if (!scan_int(sc, elo))
+		return fprintf(stderr, "%s: Cannot match elo\n", sc->path), 0;
+	if (!scan_unsigned(sc, rank))
+		return fprintf(stderr, "%s: Cannot match rank\n", sc->path), 0;
+
+	/* Historic binary data follows */
+	if (!scan_newline(sc))
+		return fprintf(stderr, "%s: Cannot match end of line\n", sc->path), 0;
 
 	return 1;
 }
 
-enum read_player_ret read_player(struct player *player, const char *name)
+static enum read_player_ret read_player_file(
+	struct player *player, const char *name, const struct historic_query *query)
 {
-	FILE *file = NULL;
+	static struct scanner sc;
 	char *path;
 
 	assert(name != NULL);
@@ -203,38 +195,50 @@ enum read_player_ret read_player(struct player *player, const char *name)
 	 */
 	reset_player(player, name);
 
-	if (!(path = get_path(name)))
-		goto fail;
+	/* Spare a failed lookup to players that do not exist */
+	if (!may_be_player(name))
+		return PLAYER_NOT_FOUND;
+
+	if (!(path = get_player_path(name)))
+		return PLAYER_ERROR;
 
-	if (!(file = fopen(path, "r"))) {
+	if (!open_scanner(&sc, path)) {
 		if (errno == ENOENT)
 			return PLAYER_NOT_FOUND;
-
-		perror(path);
-		goto fail;
+		return PLAYER_ERROR;
 	}
 
-	if (!read_player_header(file, path, player))
-		goto fail;
-	if (!read_historic(&player->hist, file, path, read_player_record))
-		goto fail;
+	if (!read_player_header(&sc, player->clan, &player->elo, &player->rank))
+		return PLAYER_ERROR;
 
-	/* Historics cannot be empty */
-	assert(player->hist.nrecords > 0);
+	if (query) {
+		if (!read_historic_query(&player->hist, &sc, decode_player_record, query))
+			return PLAYER_ERROR;
+	} else {
+		if (!read_historic(&player->hist, &sc, decode_player_record))
+			return PLAYER_ERROR;
+
+		/* Historics cannot be empty */
+		assert(player->hist.nrecords > 0);
+	}
 
-	fclose(file);
 	return PLAYER_FOUND;
+}
 
-fail:
-	if (file)
-		fclose(file);
-	return PLAYER_ERROR;
+enum read_player_ret read_player(struct player *player, const char *name)
+{
+	return read_player_file(player, name, NULL);
 }
 
-static int write_player_record(FILE *file, const char *path, void *buf)
+enum read_player_ret read_player_query(
+	struct player *player, const char *name, const struct historic_query *query)
 {
-	struct player_record *rec = buf;
+	assert(query != NULL);
+	return read_player_file(player, name, query);
+}
 
+static int write_player_record(FILE *file, const char *path, struct player_record *rec)
+{
 	if (fprintf(file, "%d %u", rec->elo, rec->rank) < 0) {
 		perror(path);
 		return 0;
@@ -257,8 +261,7 @@ static int write_player_header(FILE *file, const char *path, struct player *play
 {
 	struct player_record rec;
 
-	rec.elo = player->elo;
-	rec.rank = player->rank;
+	init_player_record(&rec, player->elo, player->rank);
 
 	if (!write_clan(file, path, player->clan))
 		return 0;
@@ -271,30 +274,31 @@ static int write_player_header(FILE *file, const char *path, struct player *play
 
 int write_player(struct player *player)
 {
-	FILE *file = NULL;
+	static struct staged_file sf;
+	FILE *file;
 	char *path;
 
 	assert(player != NULL);
 	assert(player->name[0] != '\0');
 
-	if (!(path = get_path(player->name)))
-		goto fail;
+	/* New players are given an id before being written */
+	if (player->is_modified & IS_MODIFIED_CREATED)
+		if (register_player(player->name) == NO_ID)
+			return 0;
 
-	if (!(file = fopen(path, "w"))) {
-		perror(path);
-		goto fail;
-	}
+	if (!(path = get_player_path(player->name)))
+		return 0;
+	if (!(file = stage_file(&sf, path)))
+		return 0;
 
 	if (!write_player_header(file, path, player))
 		goto fail;
-	if (!write_historic(&player->hist, file, path, write_player_record))
+	if (!write_historic(&player->hist, file, path, encode_player_record))
 		goto fail;
 
-	fclose(file);
-	return 1;
+	return commit_file(&sf);
 fail:
-	if (file)
-		fclose(file);
+	discard_file(&sf);
 	return 0;
 }
 
@@ -307,17 +311,15 @@ void set_elo(struct player *player, int elo)
 	player->elo = elo;
 	player->is_modified |= IS_MODIFIED_ELO;
 
-	if (player->hist.last)
-		last = record_data(&player->hist, player->hist.last);
+	if (player->hist.nrecords)
+		last = record_data(&player->hist, last_record(&player->hist));
 
 	if (last && last->rank == UNRANKED) {
 		last->elo = elo;
 	} else {
 		struct player_record rec;
 
-		rec.elo = elo;
-		rec.rank = UNRANKED;
-
+		init_player_record(&rec, elo, UNRANKED);
 		append_record(&player->hist, &rec);
 	}
 }
@@ -331,73 +333,263 @@ void set_rank(struct player *player, unsigned rank)
 	player->rank = rank;
 	player->is_modified |= IS_MODIFIED_RANK;
 
-	rec = record_data(&player->hist, player->hist.last);
+	rec = record_data(&player->hist, last_record(&player->hist));
 	if (rec->rank == UNRANKED)
 		rec->rank = rank;
 }
 
-void set_clan(struct player *player, char *clan)
+#define DAY (24 * 60 * 60)
+#define WEEK (7 * DAY)
+
+/* Records older than that are aggregated daily... */
+#define RAW_RETENTION (7 * DAY)
+
+/* ...and records older than that are aggregated weekly */
+#define DAILY_RETENTION (91 * DAY)
+
+static enum record_tier record_tier(time_t now, time_t time)
 {
-	assert(player != NULL);
-	assert(clan != NULL);
-	assert(is_valid_hexname(clan));
+	if (time + DAILY_RETENTION < now)
+		return WEEKLY_RECORD;
+	else if (time + RAW_RETENTION < now)
+		return DAILY_RECORD;
+	else
+		return RAW_RECORD;
+}
 
-	strcpy(player->clan, clan);
-	player->is_modified |= IS_MODIFIED_CLAN;
+static time_t tier_period(enum record_tier tier)
+{
+	return tier == WEEKLY_RECORD ? WEEK : DAY;
 }
 
-static void init_player_summary(struct player_summary *ps)
+/* Elo and rank of raw records can be changed without updating ranges */
+static struct player_record normalize_record(const struct player_record *rec)
 {
-	strcpy(ps->clan, "00");
-	ps->elo = INVALID_ELO;
-	ps->rank = UNRANKED;
+	struct player_record ret = *rec;
+
+	if (rec->tier == RAW_RECORD)
+		init_player_record(&ret, rec->elo, rec->rank);
+
+	return ret;
 }
 
-static int read_player_summary_header(
-	FILE *file, const char *path, struct player_summary *ps)
+static void merge_record(struct player_record *into, const struct player_record *rec)
 {
-	struct player_record rec;
+	if (rec->min_elo < into->min_elo)
+		into->min_elo = rec->min_elo;
+	if (rec->max_elo > into->max_elo)
+		into->max_elo = rec->max_elo;
+
+	if (rec->min_rank != UNRANKED &&
+	    (into->min_rank == UNRANKED || rec->min_rank < into->min_rank))
+		into->min_rank = rec->min_rank;
+	if (rec->max_rank > into->max_rank)
+		into->max_rank = rec->max_rank;
+
+	into->elo = rec->elo;
+	into->rank = rec->rank;
+}
 
-	if (!read_clan(file, path, ps->clan))
-		return 0;
-	if (!read_player_record(file, path, &rec))
+int compact_player(struct player *player, time_t now)
+{
+	static struct historic compacted;
+	struct historic tmp;
+	struct record *rec, *last = NULL;
+	int is_modified = 0;
+
+	assert(player != NULL);
+
+	if (!compacted.data_size)
+		init_historic(&compacted, sizeof(struct player_record), UINT_MAX);
+
+	/* Only the last record is read by default */
+	if (!load_historic(&player->hist))
 		return 0;
 
-	ps->elo = rec.elo;
-	ps->rank = rec.rank;
+	create_historic(&compacted);
+	compacted.epoch = player->hist.epoch;
 
+	for (rec = first_record(&player->hist); rec; rec = next_record(&player->hist, rec)) {
+		struct player_record data;
+		enum record_tier tier;
+
+		data = normalize_record(record_data(&player->hist, rec));
+		tier = record_tier(now, rec->time);
+
+		if (tier != RAW_RECORD && last) {
+			struct player_record *prev = record_data(&compacted, last);
+			time_t period = tier_period(tier);
+
+			if (prev->tier == tier && last->time / period == rec->time / period) {
+				merge_record(prev, &data);
+				last->time = rec->time;
+				is_modified = 1;
+				continue;
+			}
+		}
+
+		if (tier > data.tier) {
+			data.tier = tier;
+			is_modified = 1;
+		}
+
+		if (!append_record_at(&compacted, &data, rec->time))
+			return 0;
+		last = last_record(&compacted);
+	}
+
+	if (!is_modified)
+		return 1;
+
+	tmp = player->hist;
+	player->hist = compacted;
+	compacted = tmp;
+
+	player->is_modified |= IS_MODIFIED_HISTORIC;
 	return 1;
 }
 
+void set_clan(struct player *player, char *clan)
+{
+	assert(player != NULL);
+	assert(clan != NULL);
+	assert(is_valid_hexname(clan));
+
+	strcpy(player->clan, clan);
+	player->is_modified |= IS_MODIFIED_CLAN;
+}
+
 enum read_player_ret read_player_summary(struct player_summary *ps, const char *name)
 {
-	FILE *file = NULL;
+	static struct scanner sc;
 	char *path;
 
-	init_player_summary(ps);
-	strcpy(ps->name, name);
-
 	reset_player_summary(ps, name);
 
-	if (!(path = get_path(name)))
-		goto fail;
-	if (!(file = fopen(path, "r"))) {
+	if (!may_be_player(name))
+		return PLAYER_NOT_FOUND;
+
+	if (!(path = get_player_path(name)))
+		return PLAYER_ERROR;
+
+	if (!open_scanner(&sc, path)) {
 		if (errno == ENOENT)
 			return PLAYER_NOT_FOUND;
-		perror(path);
-		goto fail;
+		return PLAYER_ERROR;
 	}
 
-	if (!read_player_summary_header(file, path, ps))
-		goto fail;
-	if (!read_historic_summary(&ps->hist, file, path))
-		goto fail;
+	if (!read_player_header(&sc, ps->clan, &ps->elo, &ps->rank))
+		return PLAYER_ERROR;
+	if (!read_historic_summary(&ps->hist, &sc))
+		return PLAYER_ERROR;
 
-	fclose(file);
 	return PLAYER_FOUND;
+}
 
-fail:
-	if (file)
-		fclose(file);
-	return PLAYER_ERROR;
+char *get_shard_path(unsigned shard)
+{
+	static char path[32];
+
+	assert(shard < NSHARDS);
+
+	snprintf(path, sizeof(path), "players/%02x", shard);
+	return path;
+}
+
+unsigned get_player_shard(const char *name)
+{
+	assert(name != NULL);
+
+	return hash_name(name) % NSHARDS;
+}
+
+static int walk_shard(unsigned shard, walk_player_func_t func, void *data)
+{
+	static char path[PATH_MAX];
+	struct dirent *dp;
+	DIR *dir;
+	int ret = 1;
+
+	if (snprintf(path, PATH_MAX, "%s/%s",
+	             config.root, get_shard_path(shard)) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", config.root);
+		return 0;
+	}
+
+	if (!(dir = opendir(path)))
+		return perror(path), 0;
+
+	while ((dp = readdir(dir))) {
+		if (!is_valid_hexname(dp->d_name))
+			continue;
+		if (!func(dp->d_name, data))
+			ret = 0;
+	}
+
+	closedir(dir);
+	return ret;
+}
+
+int walk_players(walk_player_func_t func, void *data)
+{
+	unsigned shard;
+	int ret = 1;
+
+	assert(func != NULL);
+
+	for (shard = 0; shard < NSHARDS; shard++)
+		if (!walk_shard(shard, func, data))
+			ret = 0;
+
+	return ret;
+}
+
+int walk_players_in_parallel(walk_player_func_t func, void *data)
+{
+	long nworkers;
+	unsigned i, shard;
+	int status, ret = 1;
+
+	assert(func != NULL);
+
+	nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers < 1)
+		nworkers = 1;
+	if (nworkers > NSHARDS)
+		nworkers = NSHARDS;
+
+	/* Flush now, or buffered output would be written by every worker */
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < nworkers; i++) {
+		pid_t pid = fork();
+
+		if (pid == -1) {
+			perror("fork()");
+			ret = 0;
+			break;
+		} else if (pid == 0) {
+			int success = 1;
+
+			for (shard = i; shard < NSHARDS; shard += nworkers)
+				if (!walk_shard(shard, func, data))
+					success = 0;
+			if (!sync_commits())
+				success = 0;
+
+			exit(success ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+
+	while (wait(&status) != -1)
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+			ret = 0;
+
+	if (errno != ECHILD) {
+		perror("wait()");
+		ret = 0;
+	}
+
+	return ret;
 }
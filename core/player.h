@@ -6,61 +6,41 @@
 
 #include "network.h"
 #include "historic.h"
+#include "hexname.h"
 
 /**
- * @def NAME_LENGTH
+ * @enum record_tier
  *
- * Teeworlds names cannot have more than 16 characters, including terminating
- * nul byte.  Name under this form are standard, regular string of whatever
- * encoding.
+ * Recent records are kept as is, older ones are aggregated daily, and
+ * even older ones weekly.  See compact_player().
  */
-#define NAME_LENGTH 17
-
-/**
- * @def HEXNAME_LENGTH
- *
- * Hex string represent a regular string on a different form, with only
- * hexadecimal characters (0-9, a-f).  A pair of two following characters
- * define a byte of the represented string.
- *
- * They are used to convert any string to a valid filename.  In our case only
- * teeworlds name will be converted to hex string, hence a hex string is twice
- * as long as a regular string, plus one extra byte for the terminating nul byte.
- * Hence the value 33 = (16 * 2) + 1 .
- */
-#define HEXNAME_LENGTH 33
+enum record_tier {
+	RAW_RECORD,
+	DAILY_RECORD,
+	WEEKLY_RECORD
+};
 
-/**
- * Check wether or not the supplied string is a valid hexadecimal string
- *
- * @param hex Hexadecimal string to be checked
- *
- * @return 1 if hex is a valid hex string, 0 else
- */
-int is_valid_hexname(const char *hex);
+struct player_record {
+	int elo;
+	unsigned rank;
 
-/**
- * Convert a hex string to a regular string.  Supplied output buffer must
- * be wide enough to hold the result of the conversion.
- *
- * @param hex Hex string to be converted
- * @param name Buffer to store result of conversion
- */
-void hexname_to_name(const char *hex, char *name);
+	/*
+	 * Aggregated records hold the last elo and rank of the period
+	 * they cover, along with the range of values over the period.
+	 */
+	enum record_tier tier;
+	int min_elo, max_elo;
+	unsigned min_rank, max_rank;
+};
 
 /**
- * Convert a regular string to a hex string.  Supplied output buffer must
- * be wide enough to hold the result of the conversion.
+ * Fill a raw player record.
  *
- * @param name Regular string to be converted
- * @param hex Buffer to store result of conversion
+ * @param rec Record to fill
+ * @param elo Elo points of the record
+ * @param rank Rank of the record
  */
-void name_to_hexname(const char *name, char *hex);
-
-struct player_record {
-	int elo;
-	unsigned rank;
-};
+void init_player_record(struct player_record *rec, int elo, unsigned rank);
 
 /**
  * @struct player
@@ -100,10 +80,11 @@ static const int INVALID_ELO  = INT_MIN;
 static const unsigned UNRANKED = 0;
 
 enum {
-	IS_MODIFIED_CREATED = (1 << 0),
-	IS_MODIFIED_CLAN    = (1 << 1),
-	IS_MODIFIED_ELO     = (1 << 2),
-	IS_MODIFIED_RANK    = (1 << 3)
+	IS_MODIFIED_CREATED  = (1 << 0),
+	IS_MODIFIED_CLAN     = (1 << 1),
+	IS_MODIFIED_ELO      = (1 << 2),
+	IS_MODIFIED_RANK     = (1 << 3),
+	IS_MODIFIED_HISTORIC = (1 << 4)
 };
 
 /**
@@ -139,6 +120,9 @@ void create_player(struct player *player, const char *name);
  * If anything, the returned player is still printable, as the
  * function may have read some data before failure.
  *
+ * Only the last record of the player historic is loaded, call
+ * load_historic() before iterating over its records.
+ *
  * @param player Player to read
  * @param name Name of the player to read
  *
@@ -147,6 +131,20 @@ void create_player(struct player *player, const char *name);
  */
 enum read_player_ret read_player(struct player *player, const char *name);
 
+/**
+ * Same as read_player(), but only records selected by the given query
+ * are read.  The resulting player cannot be written.
+ *
+ * @param player Player to read
+ * @param name Name of the player to read
+ * @param query Records to read, see read_historic_query()
+ *
+ * @return PLAYER_FOUND on success, PLAYER_NOT_FOUND when player does
+ *         not exist, PLAYER_ERROR when an error occured.
+ */
+enum read_player_ret read_player_query(
+	struct player *player, const char *name, const struct historic_query *query);
+
 /**
  * Write a player to the disk.
  *
@@ -187,6 +185,20 @@ void set_rank(struct player *player, unsigned rank);
  */
 void set_clan(struct player *player, char *clan);
 
+/**
+ * Aggregate records of the given player historic: records older than
+ * a week are aggregated daily, and records older than three months are
+ * aggregated weekly.  The whole historic is loaded.
+ *
+ * IS_MODIFIED_HISTORIC is set when the historic changed.
+ *
+ * @param player Player to compact
+ * @param now Current time
+ *
+ * @return 1 on success, 0 on failure
+ */
+int compact_player(struct player *player, time_t now);
+
 
 /**
  * @struct player_summary
@@ -219,4 +231,74 @@ struct player_summary {
  */
 enum read_player_ret read_player_summary(struct player_summary *ps, const char *name);
 
+/**
+ * @def NSHARDS
+ *
+ * Player files are spread over NSHARDS subdirectories of "players",
+ * named after their index in hexadecimal, so that no directory grows
+ * too big.  The shard of a player is given by a hash of its name,
+ * because names prefixes are far from evenly distributed.
+ */
+#define NSHARDS 256
+
+/**
+ * Get the path of the given shard, relative to the database root.
+ *
+ * @param shard Shard index, lower than NSHARDS
+ *
+ * @return A static buffer holding the shard path
+ */
+char *get_shard_path(unsigned shard);
+
+/**
+ * Get the shard the given player file is stored in.
+ *
+ * @param name Player name
+ *
+ * @return Shard index, lower than NSHARDS
+ */
+unsigned get_player_shard(const char *name);
+
+/**
+ * Get the path of the given player file.
+ *
+ * @param name Player name
+ *
+ * @return A static buffer holding the path, NULL if it is too long
+ */
+char *get_player_path(const char *name);
+
+/**
+ * Function called for each player by walk_players().  Returning 0
+ * marks the walk as failed, but does not stop it.
+ */
+typedef int (*walk_player_func_t)(const char *name, void *data);
+
+/**
+ * Call the given function for every player in the database, one shard
+ * after the other.
+ *
+ * @param func Function called with the name of each player
+ * @param data Passed as is to "func"
+ *
+ * @return 1 on success, 0 if a shard could not be walked or if "func"
+ *         failed at least once
+ */
+int walk_players(walk_player_func_t func, void *data);
+
+/**
+ * Same as walk_players(), but shards are walked by one worker process
+ * per CPU, each worker taking one shard every "nworkers" shards.
+ *
+ * Since "func" is run by child processes, it cannot hand anything back
+ * through "data": it is only suitable for per player updates.  Workers
+ * call sync_commits() before exiting.
+ *
+ * @param func Function called with the name of each player
+ * @param data Passed as is to "func"
+ *
+ * @return 1 on success, 0 if any worker failed
+ */
+int walk_players_in_parallel(walk_player_func_t func, void *data);
+
 #endif /* PLAYER_H */
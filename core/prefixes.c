@@ -0,0 +1,390 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "prefixes.h"
+#include "commit.h"
+
+#define KEY_LENGTH (NAME_LENGTH - 1)
+
+/* Lowercase the name in a buffer of KEY_LENGTH bytes, return its length */
+static size_t get_key(const char *name, char *key)
+{
+	size_t i;
+
+	memset(key, 0, KEY_LENGTH);
+	for (i = 0; i < KEY_LENGTH && name[i]; i++)
+		key[i] = tolower((unsigned char)name[i]);
+
+	return i;
+}
+
+void init_prefixes_builder(struct prefixes_builder *builder)
+{
+	assert(builder != NULL);
+
+	builder->entries = NULL;
+	builder->length = 0;
+}
+
+int add_prefix(struct prefixes_builder *builder, const char *name, unsigned rank)
+{
+	static const size_t STEP = 64 * 1024;
+	struct prefix_entry *entry;
+	char raw[NAME_LENGTH];
+
+	assert(builder != NULL);
+	assert(name != NULL);
+
+	if (builder->length % STEP == 0) {
+		void *tmp;
+
+		tmp = realloc(builder->entries,
+		              (builder->length + STEP) * sizeof(*builder->entries));
+		if (!tmp)
+			return perror("realloc(prefixes)"), 0;
+		builder->entries = tmp;
+	}
+
+	memset(raw, 0, sizeof(raw));
+	hexname_to_name(name, raw);
+
+	entry = &builder->entries[builder->length];
+	get_key(raw, entry->key);
+	memcpy(entry->name, raw, sizeof(entry->name));
+	entry->rank = rank;
+
+	builder->length++;
+	return 1;
+}
+
+static int cmp_entries(const void *p1, const void *p2)
+{
+	const struct prefix_entry *a = p1, *b = p2;
+	int ret;
+
+	if ((ret = memcmp(a->key, b->key, KEY_LENGTH)))
+		return ret;
+	if (a->rank != b->rank)
+		return a->rank < b->rank ? -1 : 1;
+	return 0;
+}
+
+/* Keep the best ranked entries of the given range in the given top */
+static void fill_top(
+	struct prefix_top *top, const struct prefix_entry *entries,
+	size_t start, size_t end)
+{
+	unsigned n = 0, i;
+	size_t pos;
+
+	for (pos = start; pos < end; pos++) {
+		uint32_t rank = entries[pos].rank;
+
+		if (n == PREFIX_TOP_LENGTH && rank >= entries[top->entries[n - 1]].rank)
+			continue;
+
+		i = n < PREFIX_TOP_LENGTH ? n++ : n - 1;
+		for (; i > 0 && entries[top->entries[i - 1]].rank > rank; i--)
+			top->entries[i] = top->entries[i - 1];
+		top->entries[i] = pos;
+	}
+
+	top->length = n;
+}
+
+/* Entries in [start, end) sharing their first "length" bytes with start */
+static size_t same_prefix(
+	const struct prefix_entry *entries, size_t start, size_t end, size_t length)
+{
+	size_t pos;
+
+	for (pos = start; pos < end; pos++)
+		if (memcmp(entries[pos].key, entries[start].key, length))
+			break;
+
+	return pos;
+}
+
+static struct prefix_top *add_top(
+	struct prefix_top **tops, uint32_t *ntops, const char *key, size_t length)
+{
+	static const size_t STEP = 1024;
+	struct prefix_top *top;
+
+	if (*ntops % STEP == 0) {
+		void *tmp;
+
+		if (!(tmp = realloc(*tops, (*ntops + STEP) * sizeof(**tops))))
+			return perror("realloc(tops)"), NULL;
+		*tops = tmp;
+	}
+
+	top = &(*tops)[(*ntops)++];
+	memset(top, 0, sizeof(*top));
+	memcpy(top->key, key, length);
+	return top;
+}
+
+/*
+ * Every one byte prefix is followed by the two bytes prefixes starting
+ * with it, so that tops are sorted like their key.  Names of a single
+ * byte have no two bytes prefix.
+ */
+static int build_tops(
+	const struct prefix_entry *entries, size_t length,
+	struct prefix_top **tops, uint32_t *ntops)
+{
+	struct prefix_top *top;
+	size_t i, j, k, l;
+
+	*tops = NULL;
+	*ntops = 0;
+
+	for (i = 0; i < length; i = j) {
+		j = same_prefix(entries, i, length, 1);
+		if (!(top = add_top(tops, ntops, entries[i].key, 1)))
+			return 0;
+		fill_top(top, entries, i, j);
+
+		for (k = i; k < j; k = l) {
+			l = same_prefix(entries, k, j, 2);
+			if (!entries[k].key[1])
+				continue;
+
+			if (!(top = add_top(tops, ntops, entries[k].key, 2)))
+				return 0;
+			fill_top(top, entries, k, l);
+		}
+	}
+
+	return 1;
+}
+
+int write_prefixes(struct prefixes_builder *builder, const char *path)
+{
+	struct staged_file sf;
+	struct prefix_top *tops = NULL;
+	uint32_t length, ntops;
+	FILE *file = NULL;
+
+	assert(builder != NULL);
+	assert(path != NULL);
+
+	if (builder->length)
+		qsort(builder->entries, builder->length,
+		      sizeof(*builder->entries), cmp_entries);
+
+	if (!build_tops(builder->entries, builder->length, &tops, &ntops))
+		goto out;
+	if (!(file = stage_file(&sf, path)))
+		goto out;
+
+	length = builder->length;
+	fwrite(&length, sizeof(length), 1, file);
+	if (length)
+		fwrite(builder->entries, sizeof(*builder->entries), length, file);
+
+	fwrite(&ntops, sizeof(ntops), 1, file);
+	if (ntops)
+		fwrite(tops, sizeof(*tops), ntops, file);
+
+out:
+	free(tops);
+	free(builder->entries);
+	init_prefixes_builder(builder);
+	return file && commit_file(&sf);
+}
+
+/* Tops follow entries, when there is anything after them */
+static int map_tops(struct prefixes *prefixes, const char *path)
+{
+	size_t offset;
+
+	offset = sizeof(uint32_t) + prefixes->length * sizeof(struct prefix_entry);
+	prefixes->ntops = 0;
+	prefixes->tops = NULL;
+
+	if (offset == prefixes->size)
+		return 1;
+
+	if (prefixes->size - offset < sizeof(uint32_t))
+		goto truncated;
+
+	memcpy(&prefixes->ntops, prefixes->data + offset, sizeof(prefixes->ntops));
+	offset += sizeof(uint32_t);
+
+	if ((prefixes->size - offset) / sizeof(struct prefix_top) < prefixes->ntops)
+		goto truncated;
+
+	prefixes->tops = (struct prefix_top*)(prefixes->data + offset);
+	return 1;
+
+truncated:
+	fprintf(stderr, "%s: Truncated prefixes index\n", path);
+	return 0;
+}
+
+int map_prefixes(struct prefixes *prefixes, const char *path)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	assert(prefixes != NULL);
+	assert(path != NULL);
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		if (errno != ENOENT)
+			perror(path);
+		return 0;
+	}
+
+	if (fstat(fd, &st) == -1) {
+		perror(path);
+		close(fd);
+		return 0;
+	}
+
+	if ((size_t)st.st_size < sizeof(uint32_t)) {
+		fprintf(stderr, "%s: Truncated prefixes index\n", path);
+		close(fd);
+		return 0;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return perror(path), 0;
+
+	prefixes->data = map;
+	prefixes->size = st.st_size;
+
+	memcpy(&prefixes->length, prefixes->data, sizeof(prefixes->length));
+	if ((prefixes->size - sizeof(uint32_t)) / sizeof(struct prefix_entry) < prefixes->length) {
+		fprintf(stderr, "%s: Truncated prefixes index\n", path);
+		unmap_prefixes(prefixes);
+		return 0;
+	}
+
+	prefixes->entries = (struct prefix_entry*)(prefixes->data + sizeof(uint32_t));
+	if (!map_tops(prefixes, path)) {
+		unmap_prefixes(prefixes);
+		return 0;
+	}
+
+	return 1;
+}
+
+void unmap_prefixes(struct prefixes *prefixes)
+{
+	assert(prefixes != NULL);
+
+	if (prefixes->data)
+		munmap(prefixes->data, prefixes->size);
+
+	prefixes->data = NULL;
+	prefixes->size = 0;
+	prefixes->length = 0;
+	prefixes->entries = NULL;
+	prefixes->ntops = 0;
+	prefixes->tops = NULL;
+}
+
+/* Results of a short prefix, from the tops of the index */
+static unsigned find_top(
+	const struct prefixes *prefixes, const char *key,
+	const struct prefix_entry **results, unsigned max)
+{
+	const struct prefix_top *top;
+	size_t lo, hi, mid;
+	unsigned n, i;
+	int ret;
+
+	lo = 0;
+	hi = prefixes->ntops;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		top = &prefixes->tops[mid];
+
+		if ((ret = memcmp(top->key, key, PREFIX_TOP_KEY_LENGTH)) == 0)
+			break;
+		else if (ret < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* Every prefix of an entry has its top */
+	if (lo == hi)
+		return 0;
+
+	n = top->length < max ? top->length : max;
+	for (i = 0; i < n; i++) {
+		if (top->entries[i] >= prefixes->length)
+			return 0;
+		results[i] = &prefixes->entries[top->entries[i]];
+	}
+
+	return n;
+}
+
+unsigned find_prefix(
+	const struct prefixes *prefixes, const char *prefix,
+	const struct prefix_entry **results, unsigned max)
+{
+	const struct prefix_entry *entry, *end;
+	char key[KEY_LENGTH];
+	size_t length, lo, hi, mid;
+	unsigned n = 0, i;
+
+	assert(prefixes != NULL);
+	assert(prefix != NULL);
+	assert(results != NULL);
+
+	if (strlen(prefix) > KEY_LENGTH || !max)
+		return 0;
+	length = get_key(prefix, key);
+
+	if (prefixes->tops && length && length <= PREFIX_TOP_KEY_LENGTH &&
+	    max <= PREFIX_TOP_LENGTH)
+		return find_top(prefixes, key, results, max);
+
+	/* First entry not lower than the prefix */
+	lo = 0;
+	hi = prefixes->length;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (memcmp(prefixes->entries[mid].key, key, length) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/*
+	 * Matching entries follow each other, keep the best ranked ones,
+	 * sorted by inserting each of them at its place.
+	 */
+	end = prefixes->entries + prefixes->length;
+	for (entry = prefixes->entries + lo; entry < end; entry++) {
+		if (memcmp(entry->key, key, length) != 0)
+			break;
+		if (n == max && entry->rank >= results[n - 1]->rank)
+			continue;
+
+		i = n < max ? n++ : n - 1;
+		for (; i > 0 && results[i - 1]->rank > entry->rank; i--)
+			results[i] = results[i - 1];
+		results[i] = entry;
+	}
+
+	return n;
+}
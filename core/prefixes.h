@@ -0,0 +1,136 @@
+#ifndef PREFIXES_H
+#define PREFIXES_H
+
+/**
+ * @file prefixes.h
+ *
+ * The prefixes index of a generation lists every ranked player, sorted
+ * by lowercased name, so that players whose name starts with a given
+ * prefix are next to each other and found with a binary search.  It is
+ * meant for suggestions while typing, and only the best ranked players
+ * of the range are returned.
+ *
+ * The file starts with the number of entries as an uint32_t, followed
+ * by the entries themselves, as stored in struct prefix_entry.
+ *
+ * Prefixes of one or two bytes match a large part of the index, so
+ * their best ranked players are found once when the index is written.
+ * They follow the entries, as the number of such prefixes as an
+ * uint32_t and then the prefixes, as stored in struct prefix_top,
+ * sorted by key.  Indexes written before do not have them, and are
+ * still read.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hexname.h"
+
+struct prefix_entry {
+	/* Lowercased and raw names, padded with nul bytes */
+	char key[NAME_LENGTH - 1];
+	char name[NAME_LENGTH - 1];
+	uint32_t rank;
+};
+
+/**
+ * @def PREFIX_TOP_LENGTH
+ *
+ * Number of best ranked players stored for short prefixes.
+ */
+#define PREFIX_TOP_LENGTH 10
+#define PREFIX_TOP_KEY_LENGTH 2
+
+struct prefix_top {
+	/* Lowercased prefix, padded with nul bytes */
+	char key[PREFIX_TOP_KEY_LENGTH];
+	uint16_t length;
+
+	/* Position of entries, by increasing rank */
+	uint32_t entries[PREFIX_TOP_LENGTH];
+};
+
+struct prefixes_builder {
+	struct prefix_entry *entries;
+	size_t length;
+};
+
+struct prefixes {
+	unsigned char *data;
+	size_t size;
+
+	uint32_t length;
+	const struct prefix_entry *entries;
+
+	/* NULL for indexes without them */
+	uint32_t ntops;
+	const struct prefix_top *tops;
+};
+
+/**
+ * Initialize an empty builder.  No memory is allocated until the first
+ * name is added.
+ *
+ * @param builder Builder to initialize
+ */
+void init_prefixes_builder(struct prefixes_builder *builder);
+
+/**
+ * Add the given player to the index.
+ *
+ * @param builder Builder
+ * @param name Player name, as an hexname
+ * @param rank Player rank
+ *
+ * @return 1 on success, 0 on failure
+ */
+int add_prefix(struct prefixes_builder *builder, const char *name, unsigned rank);
+
+/**
+ * Write the index built so far, and free the builder.
+ *
+ * @param builder Builder
+ * @param path Path of the index
+ *
+ * @return 1 on success, 0 on failure
+ */
+int write_prefixes(struct prefixes_builder *builder, const char *path);
+
+/**
+ * Map the index stored in the given file.
+ *
+ * If the file does not exist, nothing is printed and errno is set to
+ * ENOENT, so that the caller can handle that case.
+ *
+ * @param prefixes Index to initialize
+ * @param path Path of the index
+ *
+ * @return 1 on success, 0 on failure
+ */
+int map_prefixes(struct prefixes *prefixes, const char *path);
+
+/**
+ * Unmap the given index.
+ *
+ * @param prefixes Index to unmap
+ */
+void unmap_prefixes(struct prefixes *prefixes);
+
+/**
+ * Find the best ranked players whose name starts with the given prefix.
+ * The prefix is lowercased the same way names are.  Results of short
+ * prefixes are read as they are, when no more than PREFIX_TOP_LENGTH
+ * are asked for.
+ *
+ * @param prefixes Index
+ * @param prefix Prefix, as a raw name
+ * @param results Array of max entries, filled by increasing rank
+ * @param max Maximum number of results
+ *
+ * @return Number of results
+ */
+unsigned find_prefix(
+	const struct prefixes *prefixes, const char *prefix,
+	const struct prefix_entry **results, unsigned max);
+
+#endif /* PREFIXES_H */
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "ranks.h"
+#include "dict.h"
+#include "commit.h"
+
+void set_rank_entry(struct rank_entry *entry, unsigned id, int elo, const char *clan)
+{
+	char name[NAME_LENGTH];
+
+	assert(entry != NULL);
+	assert(clan != NULL);
+
+	entry->id = id;
+	entry->elo = elo;
+
+	memset(name, 0, sizeof(name));
+	hexname_to_name(clan, name);
+	memcpy(entry->clan, name, sizeof(entry->clan));
+}
+
+int get_rank_entry(const struct rank_entry *entry, unsigned rank, struct player_summary *ps)
+{
+	char name[NAME_LENGTH];
+
+	assert(entry != NULL);
+	assert(ps != NULL);
+
+	if (!get_player_name(entry->id, ps->name))
+		return 0;
+
+	memcpy(name, entry->clan, sizeof(entry->clan));
+	name[sizeof(entry->clan)] = '\0';
+	name_to_hexname(name, ps->clan);
+
+	ps->elo = entry->elo;
+	ps->rank = rank;
+	ps->hist.epoch = 0;
+	ps->hist.nrecords = 0;
+
+	return 1;
+}
+
+int write_ranks(const char *path, const struct rank_entry *entries, unsigned length)
+{
+	struct staged_file sf;
+	uint32_t value;
+	FILE *file;
+
+	assert(path != NULL);
+	assert(entries != NULL || length == 0);
+
+	if (!(file = stage_file(&sf, path)))
+		return 0;
+
+	value = length;
+	fwrite(&value, sizeof(value), 1, file);
+	if (length)
+		fwrite(entries, sizeof(*entries), length, file);
+
+	return commit_file(&sf);
+}
+
+int read_ranks_length(const char *path, unsigned *length)
+{
+	uint32_t value;
+	FILE *file;
+
+	assert(path != NULL);
+	assert(length != NULL);
+
+	if (!(file = fopen(path, "r")))
+		return perror(path), 0;
+
+	if (fread(&value, sizeof(value), 1, file) != 1) {
+		fprintf(stderr, "%s: No header\n", path);
+		fclose(file);
+		return 0;
+	}
+
+	fclose(file);
+	*length = value;
+	return 1;
+}
@@ -0,0 +1,73 @@
+#ifndef RANKS_H
+#define RANKS_H
+
+/**
+ * @file ranks.h
+ *
+ * The ranks file of a generation holds the number of ranked players,
+ * as an uint32_t, followed by an entry for each player, from the first
+ * to the last.  Entries have a fixed size so that the nth player can
+ * be found by seeking, and they hold everything needed to list players
+ * without reading player files, which may be more recent than the
+ * generation.
+ */
+
+#include <stdint.h>
+
+#include "player.h"
+
+/* Players listed on each rank page */
+#define PLAYERS_PER_PAGE 100
+
+struct rank_entry {
+	uint32_t id;
+	int32_t elo;
+
+	/* Raw clan name, padded with nul bytes */
+	char clan[NAME_LENGTH - 1];
+};
+
+/**
+ * Fill a rank entry.
+ *
+ * @param entry Entry to fill
+ * @param id Player id
+ * @param elo Player elo
+ * @param clan Player clan, as an hexname
+ */
+void set_rank_entry(struct rank_entry *entry, unsigned id, int elo, const char *clan);
+
+/**
+ * Fill a player summary from the given rank entry.  Historic summary
+ * is left empty.
+ *
+ * @param entry Rank entry
+ * @param rank Rank of the entry
+ * @param ps Player summary to fill
+ *
+ * @return 1 on success, 0 on failure
+ */
+int get_rank_entry(const struct rank_entry *entry, unsigned rank, struct player_summary *ps);
+
+/**
+ * Write the ranks file in the given generation.
+ *
+ * @param path Path of the ranks file
+ * @param entries Entries sorted by rank
+ * @param length Number of entries
+ *
+ * @return 1 on success, 0 on failure
+ */
+int write_ranks(const char *path, const struct rank_entry *entries, unsigned length);
+
+/**
+ * Read the number of ranked players in the given ranks file.
+ *
+ * @param path Path of the ranks file
+ * @param length Number of ranked players
+ *
+ * @return 1 on success, 0 on failure
+ */
+int read_ranks_length(const char *path, unsigned *length);
+
+#endif /* RANKS_H */
@@ -0,0 +1,26 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "rating.h"
+#include "elo.h"
+
+const struct rating_engine *RATING_ENGINES[] = {
+	&ELO_ENGINE,
+	&ELO_K16_ENGINE,
+	&ELO_K32_ENGINE,
+	NULL
+};
+
+const struct rating_engine *get_rating_engine(const char *name)
+{
+	const struct rating_engine **engine;
+
+	assert(name != NULL);
+
+	for (engine = RATING_ENGINES; *engine; engine++)
+		if (!strcmp((*engine)->name, name))
+			return *engine;
+
+	return NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef RATING_H
+#define RATING_H
+
+/**
+ * @file rating.h
+ *
+ * A rating engine rate players given the outcome of their games.
+ *
+ * Each engine define its own rating data, hence ratings are opaque
+ * buffers of "rating_size" bytes.  Elo only needs a single integer
+ * but Glicko-2 like engines would also need a rating deviation and a
+ * volatility for instance.
+ *
+ * A game is given to engines as contiguous arrays: one pointer to each
+ * player's rating, and each player's score delta during the game.  An
+ * engine must not change the rating of unrankable players, but they
+ * still are part of the game.
+ */
+
+#include <stddef.h>
+
+struct rating_engine;
+
+typedef void (*init_rating_func_t)(
+	const struct rating_engine *engine, void *rating);
+typedef double (*expected_score_func_t)(
+	const struct rating_engine *engine,
+	const void *player, const void *opponent);
+typedef void (*rate_game_func_t)(
+	const struct rating_engine *engine, unsigned length,
+	void *ratings[], const long deltas[], const int rankable[]);
+
+struct rating_engine {
+	const char *name;
+
+	size_t rating_size;
+
+	/* Set the rating of a new player */
+	init_rating_func_t init_rating;
+
+	/* Chance for player to score more than opponent, between 0 and 1 */
+	expected_score_func_t expected_score;
+
+	/* Update ratings of every rankable players of a game */
+	rate_game_func_t rate_game;
+
+	/* Engine specific data */
+	void *data;
+};
+
+/**
+ * Every available rating engines, NULL terminated.
+ */
+extern const struct rating_engine *RATING_ENGINES[];
+
+/**
+ * Find the rating engine with the given name.
+ *
+ * @param name Name of the engine
+ *
+ * @return A valid pointer to the engine if found, NULL otherwise
+ */
+const struct rating_engine *get_rating_engine(const char *name);
+
+#endif /* RATING_H */
@@ -0,0 +1,364 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "scanner.h"
+#include "hexname.h"
+
+/* Make sure at least "size" bytes can be stored in the buffer */
+static int grow_buffer(struct scanner *sc, size_t size)
+{
+	const size_t STEP = 4096;
+	char *buf;
+
+	/* Keep room for the terminating NUL byte */
+	size++;
+
+	if (size <= sc->length)
+		return 1;
+
+	size = size - (size % STEP) + STEP;
+	if (!(buf = realloc(sc->buf, size)))
+		return perror("realloc(scanner)"), 0;
+
+	sc->pos = buf + (sc->pos - sc->buf);
+	sc->end = buf + (sc->end - sc->buf);
+	sc->buf = buf;
+	sc->length = size;
+
+	return 1;
+}
+
+static void reset_scanner(struct scanner *sc, int fd, const char *path)
+{
+	sc->path = path;
+	sc->fd = fd;
+	sc->eof = 0;
+	sc->pos = sc->buf;
+	sc->end = sc->buf;
+}
+
+/*
+ * Read the whole file.  Asking for one more byte than the file size
+ * let us know we reached the end of the file with a single read(),
+ * unless the file grew in the meantime.
+ */
+int open_scanner(struct scanner *sc, const char *path)
+{
+	struct stat st;
+	ssize_t ret;
+	int fd;
+
+	assert(sc != NULL);
+	assert(path != NULL);
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		if (errno != ENOENT)
+			perror(path);
+		return 0;
+	}
+
+	reset_scanner(sc, fd, path);
+
+	if (fstat(fd, &st) == -1) {
+		perror(path);
+		goto fail;
+	}
+
+	do {
+		size_t used = sc->end - sc->buf;
+
+		if (!grow_buffer(sc, used + st.st_size + 1))
+			goto fail;
+
+		ret = read(fd, sc->end, sc->length - used - 1);
+		if (ret == -1) {
+			perror(path);
+			goto fail;
+		}
+
+		sc->end += ret;
+	} while (ret && sc->end == sc->buf + sc->length - 1);
+
+	*sc->end = '\0';
+	sc->eof = 1;
+	sc->fd = -1;
+	close(fd);
+
+	return 1;
+
+fail:
+	close(fd);
+	sc->fd = -1;
+	return 0;
+}
+
+void open_stream_scanner(struct scanner *sc, int fd, const char *path)
+{
+	assert(sc != NULL);
+	assert(path != NULL);
+
+	reset_scanner(sc, fd, path);
+	if (!grow_buffer(sc, 0))
+		sc->eof = 1;
+	else
+		*sc->end = '\0';
+}
+
+/*
+ * Read more data after what is left to be scanned.  Return 0 when no
+ * more data can be read.
+ */
+static int refill(struct scanner *sc)
+{
+	size_t left;
+	ssize_t ret;
+
+	if (sc->eof)
+		return 0;
+
+	left = sc->end - sc->pos;
+	memmove(sc->buf, sc->pos, left);
+	sc->pos = sc->buf;
+	sc->end = sc->buf + left;
+
+	if (!grow_buffer(sc, left + 1))
+		goto eof;
+
+	do
+		ret = read(sc->fd, sc->end, sc->length - left - 1);
+	while (ret == -1 && errno == EINTR);
+
+	if (ret == -1)
+		perror(sc->path);
+	if (ret <= 0)
+		goto eof;
+
+	sc->end += ret;
+	*sc->end = '\0';
+	return 1;
+
+eof:
+	sc->eof = 1;
+	return 0;
+}
+
+static int is_space(char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static int skip_spaces(struct scanner *sc)
+{
+	do {
+		while (sc->pos < sc->end && is_space(*sc->pos))
+			sc->pos++;
+		if (sc->pos < sc->end)
+			return 1;
+	} while (refill(sc));
+
+	return 0;
+}
+
+/* Skip white spaces and return the length of the following token */
+static size_t next_token(struct scanner *sc)
+{
+	size_t len = 0;
+
+	if (!skip_spaces(sc))
+		return 0;
+
+	do {
+		while (sc->pos + len < sc->end && !is_space(sc->pos[len]))
+			len++;
+		if (sc->pos + len < sc->end)
+			break;
+	} while (refill(sc));
+
+	return len;
+}
+
+int scan_eof(struct scanner *sc)
+{
+	assert(sc != NULL);
+	return !skip_spaces(sc);
+}
+
+int scan_newline(struct scanner *sc)
+{
+	assert(sc != NULL);
+
+	do {
+		while (sc->pos < sc->end && *sc->pos != '\n' && is_space(*sc->pos))
+			sc->pos++;
+		if (sc->pos < sc->end)
+			break;
+	} while (refill(sc));
+
+	if (sc->pos == sc->end || *sc->pos != '\n')
+		return 0;
+
+	sc->pos++;
+	return 1;
+}
+
+int scan_string(struct scanner *sc, const char *str)
+{
+	size_t len;
+
+	assert(sc != NULL);
+	assert(str != NULL);
+
+	len = strlen(str);
+	if (!skip_spaces(sc))
+		return 0;
+
+	while ((size_t)(sc->end - sc->pos) < len)
+		if (!refill(sc))
+			return 0;
+
+	if (memcmp(sc->pos, str, len) != 0)
+		return 0;
+
+	sc->pos += len;
+	return 1;
+}
+
+/* Parse digits of the given token, fail on overflow or invalid digits */
+static int parse_digits(const char *str, size_t len, unsigned long max,
+                        unsigned long *value)
+{
+	unsigned long n = 0;
+	size_t i;
+
+	if (len == 0)
+		return 0;
+
+	for (i = 0; i < len; i++) {
+		unsigned digit = str[i] - '0';
+
+		if (digit > 9)
+			return 0;
+		if (n > (max - digit) / 10)
+			return 0;
+		n = n * 10 + digit;
+	}
+
+	*value = n;
+	return 1;
+}
+
+static int scan_signed(struct scanner *sc, long min, long max, long *value)
+{
+	unsigned long n;
+	size_t len;
+	const char *str;
+	int negative = 0;
+
+	len = next_token(sc);
+	str = sc->pos;
+
+	if (len && (*str == '-' || *str == '+')) {
+		negative = *str == '-';
+		str++;
+		len--;
+	}
+
+	if (negative) {
+		if (!parse_digits(str, len, -(unsigned long)min, &n))
+			return 0;
+		*value = n == -(unsigned long)min ? min : -(long)n;
+	} else {
+		if (!parse_digits(str, len, max, &n))
+			return 0;
+		*value = n;
+	}
+
+	sc->pos = (char*)str + len;
+	return 1;
+}
+
+static int scan_unsigned_max(struct scanner *sc, unsigned long max, unsigned long *value)
+{
+	size_t len;
+
+	len = next_token(sc);
+	if (!parse_digits(sc->pos, len, max, value))
+		return 0;
+
+	sc->pos += len;
+	return 1;
+}
+
+int scan_long(struct scanner *sc, long *value)
+{
+	assert(sc != NULL);
+	assert(value != NULL);
+
+	return scan_signed(sc, LONG_MIN, LONG_MAX, value);
+}
+
+int scan_int(struct scanner *sc, int *value)
+{
+	long n;
+
+	assert(sc != NULL);
+	assert(value != NULL);
+
+	if (!scan_signed(sc, INT_MIN, INT_MAX, &n))
+		return 0;
+
+	*value = n;
+	return 1;
+}
+
+int scan_ulong(struct scanner *sc, unsigned long *value)
+{
+	assert(sc != NULL);
+	assert(value != NULL);
+
+	return scan_unsigned_max(sc, ULONG_MAX, value);
+}
+
+int scan_unsigned(struct scanner *sc, unsigned *value)
+{
+	unsigned long n;
+
+	assert(sc != NULL);
+	assert(value != NULL);
+
+	if (!scan_unsigned_max(sc, UINT_MAX, &n))
+		return 0;
+
+	*value = n;
+	return 1;
+}
+
+int scan_hexname(struct scanner *sc, char *hexname)
+{
+	char buf[HEXNAME_LENGTH];
+	size_t len;
+
+	assert(sc != NULL);
+	assert(hexname != NULL);
+
+	len = next_token(sc);
+	if (len == 0 || len >= HEXNAME_LENGTH)
+		return 0;
+
+	memcpy(buf, sc->pos, len);
+	buf[len] = '\0';
+
+	if (!is_valid_hexname(buf))
+		return 0;
+
+	memcpy(hexname, buf, len + 1);
+	sc->pos += len;
+	return 1;
+}
@@ -0,0 +1,121 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+/**
+ * @file scanner.h
+ *
+ * Parse database files without the stdio scanf() family.
+ *
+ * Files are read in a single read() into a buffer owned by the
+ * scanner, which is then parsed in place.  The buffer is reused by the
+ * next open_scanner() call on the same scanner, so a static scanner
+ * does not allocate anything once it has grown big enough.
+ *
+ * Like scanf(), every scan_*() function skips leading white spaces.
+ * Unlike scanf(), a token must be entirely matched: "12ab" is not
+ * matched by scan_int().
+ *
+ *	static struct scanner sc;
+ *
+ *	if (!open_scanner(&sc, path))
+ *		return 0;
+ *	if (!scan_int(&sc, &elo))
+ *		return fprintf(stderr, "%s: Cannot match elo\n", path), 0;
+ */
+
+#include <stddef.h>
+
+/**
+ * @struct scanner
+ *
+ * Unparsed data is between "pos" and "end".  A NUL byte is always
+ * stored at "end".
+ */
+struct scanner {
+	const char *path;
+	int fd;
+	int eof;
+
+	char *buf;
+	size_t length;
+
+	char *pos, *end;
+};
+
+/**
+ * Read the whole file in the scanner buffer.
+ *
+ * If the file does not exist, nothing is printed and errno is set to
+ * ENOENT, so that the caller can handle that case.
+ *
+ * @param sc Scanner, zeroed before its first use
+ * @param path Path of the file to read, also used in error messages
+ *
+ * @return 1 on success, 0 on failure
+ */
+int open_scanner(struct scanner *sc, const char *path);
+
+/**
+ * Scan data from the given file descriptor as it comes, typically
+ * stdin.  More data is read only when a token is not yet complete.
+ *
+ * @param sc Scanner, zeroed before its first use
+ * @param fd File descriptor to read from
+ * @param path Used in error messages
+ */
+void open_stream_scanner(struct scanner *sc, int fd, const char *path);
+
+/**
+ * Skip white spaces and check if there is nothing else to scan.
+ *
+ * @param sc Scanner
+ *
+ * @return 1 if everything have been scanned, 0 otherwise
+ */
+int scan_eof(struct scanner *sc);
+
+/**
+ * Skip white spaces other than newlines, and match a newline.
+ *
+ * Useful when binary data follows the newline.
+ *
+ * @param sc Scanner
+ *
+ * @return 1 on success, 0 on failure
+ */
+int scan_newline(struct scanner *sc);
+
+/**
+ * Match the given string exactly.
+ *
+ * @param sc Scanner
+ * @param str String to match
+ *
+ * @return 1 on success, 0 on failure
+ */
+int scan_string(struct scanner *sc, const char *str);
+
+/**
+ * Scan a decimal integer.  Out of range values are not matched.
+ *
+ * @param sc Scanner
+ * @param value Scanned value
+ *
+ * @return 1 on success, 0 on failure
+ */
+int scan_long(struct scanner *sc, long *value);
+int scan_int(struct scanner *sc, int *value);
+int scan_ulong(struct scanner *sc, unsigned long *value);
+int scan_unsigned(struct scanner *sc, unsigned *value);
+
+/**
+ * Scan a valid hexname, see is_valid_hexname().
+ *
+ * @param sc Scanner
+ * @param hexname Buffer of HEXNAME_LENGTH bytes to store the hexname
+ *
+ * @return 1 on success, 0 on failure
+ */
+int scan_hexname(struct scanner *sc, char *hexname);
+
+#endif /* SCANNER_H */
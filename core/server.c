@@ -8,6 +8,8 @@
 
 #include "server.h"
 #include "config.h"
+#include "scanner.h"
+#include "commit.h"
 
 static char *get_path(const char *sname)
 {
@@ -22,90 +24,73 @@ static char *get_path(const char *sname)
 	return path;
 }
 
-static int read_server_meta(FILE *file, const char *path, struct server_state *state)
+static int read_server_meta(struct scanner *sc, struct server_state *state)
 {
-	int ret;
+	unsigned long last_seen, expire;
 
-	assert(file != NULL);
-	assert(path != NULL);
+	assert(sc != NULL);
 	assert(state != NULL);
 
-	errno = 0;
-	ret = fscanf(file, "last seen: %ju\nexpire: %ju\n",
-	             &state->last_seen, &state->expire);
-
-	if (ret == EOF && errno != 0) {
-		perror(path);
+	if (!scan_string(sc, "last seen:") || !scan_ulong(sc, &last_seen)) {
+		fprintf(stderr, "%s: Can't match 'last seen' field\n", sc->path);
 		return 0;
-	} else if (ret == EOF || ret == 0) {
-		fprintf(stderr, "%s: Can't match 'last seen' field\n", path);
-		return 0;
-	} else if (ret == 1) {
-		fprintf(stderr, "%s: Can't match 'expire' field\n", path);
+	}
+	if (!scan_string(sc, "expire:") || !scan_ulong(sc, &expire)) {
+		fprintf(stderr, "%s: Can't match 'expire' field\n", sc->path);
 		return 0;
 	}
 
+	state->last_seen = last_seen;
+	state->expire = expire;
+
 	return 1;
 }
 
 int read_server_state(struct server_state *state, char *sname)
 {
-	FILE *file = NULL;
+	static struct scanner sc;
 	char *path;
 	unsigned i;
-	int ret;
 
 	assert(state != NULL);
 	assert(sname != NULL);
 
 	if (!(path = get_path(sname)))
-		goto fail;
-	if (!(file = fopen(path, "r"))) {
-		perror(path);
-		goto fail;
+		return 0;
+	if (!open_scanner(&sc, path)) {
+		if (errno == ENOENT)
+			perror(path);
+		return 0;
 	}
 
-	if (!read_server_meta(file, path, state))
-		goto fail;
-
-	errno = 0;
-	ret = fscanf(file, " %d", &state->num_clients);
+	if (!read_server_meta(&sc, state))
+		return 0;
 
-	if (ret == EOF && errno != 0) {
-		perror(path);
-		goto fail;
-	} else if (ret == EOF || ret == 0) {
+	if (!scan_int(&sc, &state->num_clients)) {
 		fprintf(stderr, "%s: Cannot match clients number\n", path);
-		goto fail;
+		return 0;
+	}
+	if (state->num_clients < 0 || state->num_clients > MAX_CLIENTS) {
+		fprintf(stderr, "%s: Invalid clients number\n", path);
+		return 0;
 	}
 
 	for (i = 0; i < state->num_clients; i++) {
 		struct client *client = &state->clients[i];
 
-		errno = 0;
-		ret = fscanf(file, " %s %s %ld",
-		             client->name, client->clan, &client->score);
-
-		if (ret == EOF && errno != 0) {
-			perror(path);
-			goto fail;
-		} else if (ret != 3) {
-			fprintf(stderr, "%s: Only %d over %d clients matched\n",
-			        path, ret, state->num_clients);
-			goto fail;
+		if (!scan_hexname(&sc, client->name) ||
+		    !scan_hexname(&sc, client->clan) ||
+		    !scan_long(&sc, &client->score)) {
+			fprintf(stderr, "%s: Only %u over %d clients matched\n",
+			        path, i, state->num_clients);
+			return 0;
 		}
 	}
 
 	/* Assume for now that only CTF games are ranked */
 	state->gametype = "CTF";
 
-	fclose(file);
 	return 1;
-
-fail:
-	if (file)
-		fclose(file);
-	return 0;
 }
 
 static int write_server_meta(FILE *file, const char *path, struct server_state *state)
@@ -128,18 +113,17 @@ static int write_server_meta(FILE *file, const char *path, struct server_state *
 
 int write_server_state(struct server_state *state, const char *sname)
 {
-	FILE *file = NULL;
+	static struct staged_file sf;
+	FILE *file;
 	char *path;
 	unsigned i;
 
 	assert(state != NULL);
 
 	if (!(path = get_path(sname)))
-		goto fail;
-	if (!(file = fopen(path, "w"))) {
-		perror(path);
-		goto fail;
-	}
+		return 0;
+	if (!(file = stage_file(&sf, path)))
+		return 0;
 
 	if (!write_server_meta(file, path, state))
 		goto fail;
@@ -159,12 +143,10 @@ int write_server_state(struct server_state *state, const char *sname)
 		}
 	}
 
-	fclose(file);
-	return 1;
+	return commit_file(&sf);
 
 fail:
-	if (file)
-		fclose(file);
+	discard_file(&sf);
 	return 0;
 }
 
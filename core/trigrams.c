@@ -0,0 +1,350 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "trigrams.h"
+#include "varint.h"
+#include "commit.h"
+
+/* Lowercase the name and list its distinct trigrams */
+static unsigned get_trigrams(const char *name, uint32_t *trigrams)
+{
+	unsigned char buf[NAME_LENGTH];
+	unsigned i, j, n = 0;
+	size_t length;
+	uint32_t trigram;
+
+	length = strlen(name);
+	if (length >= NAME_LENGTH)
+		length = NAME_LENGTH - 1;
+
+	for (i = 0; i < length; i++)
+		buf[i] = tolower((unsigned char)name[i]);
+
+	for (i = 0; i + 3 <= length; i++) {
+		trigram = (uint32_t)buf[i] << 16 | (uint32_t)buf[i + 1] << 8 | buf[i + 2];
+
+		for (j = 0; j < n && trigrams[j] != trigram; j++)
+			;
+		if (j == n)
+			trigrams[n++] = trigram;
+	}
+
+	return n;
+}
+
+void init_trigrams_builder(struct trigrams_builder *builder)
+{
+	assert(builder != NULL);
+
+	builder->postings = NULL;
+	builder->length = 0;
+}
+
+int add_trigrams(struct trigrams_builder *builder, const char *name, unsigned rank)
+{
+	static const size_t STEP = 1024 * 1024;
+	uint32_t trigrams[MAX_TRIGRAMS];
+	char raw[NAME_LENGTH];
+	unsigned i, n;
+
+	assert(builder != NULL);
+	assert(name != NULL);
+
+	hexname_to_name(name, raw);
+	n = get_trigrams(raw, trigrams);
+
+	for (i = 0; i < n; i++) {
+		if (builder->length % STEP == 0) {
+			void *tmp;
+
+			tmp = realloc(builder->postings,
+			              (builder->length + STEP) * sizeof(*builder->postings));
+			if (!tmp)
+				return perror("realloc(trigrams)"), 0;
+			builder->postings = tmp;
+		}
+
+		builder->postings[builder->length].trigram = trigrams[i];
+		builder->postings[builder->length].rank = rank;
+		builder->length++;
+	}
+
+	return 1;
+}
+
+static int cmp_postings(const void *p1, const void *p2)
+{
+	const struct trigram_posting *a = p1, *b = p2;
+
+	if (a->trigram != b->trigram)
+		return a->trigram < b->trigram ? -1 : 1;
+	if (a->rank != b->rank)
+		return a->rank < b->rank ? -1 : 1;
+	return 0;
+}
+
+static void free_builder(struct trigrams_builder *builder)
+{
+	free(builder->postings);
+	init_trigrams_builder(builder);
+}
+
+/*
+ * Postings are sorted by trigram then by rank, so that each list is
+ * written in one go.  Since trigrams are distinct for a given name,
+ * ranks of a list are strictly increasing.
+ */
+int write_trigrams(struct trigrams_builder *builder, const char *path)
+{
+	const struct trigram_posting *p, *end;
+	unsigned char buf[MAX_VARINT_SIZE];
+	struct trigram_entry entry;
+	struct staged_file sf;
+	uint32_t length, offset, prev;
+	FILE *file;
+	size_t i;
+
+	assert(builder != NULL);
+	assert(path != NULL);
+
+	if (builder->length)
+		qsort(builder->postings, builder->length,
+		      sizeof(*builder->postings), cmp_postings);
+
+	length = 0;
+	for (i = 0; i < builder->length; i++)
+		if (i == 0 || builder->postings[i].trigram != builder->postings[i - 1].trigram)
+			length++;
+
+	if (!(file = stage_file(&sf, path))) {
+		free_builder(builder);
+		return 0;
+	}
+
+	fwrite(&length, sizeof(length), 1, file);
+
+	/* First the table, the offset of each list being known in advance */
+	offset = 0;
+	p = builder->postings;
+	end = builder->postings + builder->length;
+
+	while (p < end) {
+		entry.trigram = p->trigram;
+		entry.offset = offset;
+		entry.length = 0;
+
+		for (prev = 0; p < end && p->trigram == entry.trigram; p++) {
+			offset += put_varint(buf, p->rank - prev) - buf;
+			prev = p->rank;
+			entry.length++;
+		}
+
+		fwrite(&entry, sizeof(entry), 1, file);
+	}
+
+	/* Then the lists */
+	p = builder->postings;
+	while (p < end) {
+		uint32_t trigram = p->trigram;
+
+		for (prev = 0; p < end && p->trigram == trigram; p++) {
+			fwrite(buf, put_varint(buf, p->rank - prev) - buf, 1, file);
+			prev = p->rank;
+		}
+	}
+
+	free_builder(builder);
+	return commit_file(&sf);
+}
+
+int map_trigrams(struct trigrams *trigrams, const char *path)
+{
+	struct stat st;
+	size_t table_size;
+	void *map;
+	int fd;
+
+	assert(trigrams != NULL);
+	assert(path != NULL);
+
+	if ((fd = open(path, O_RDONLY)) == -1) {
+		if (errno != ENOENT)
+			perror(path);
+		return 0;
+	}
+
+	if (fstat(fd, &st) == -1) {
+		perror(path);
+		close(fd);
+		return 0;
+	}
+
+	if ((size_t)st.st_size < sizeof(uint32_t)) {
+		fprintf(stderr, "%s: Truncated trigrams index\n", path);
+		close(fd);
+		return 0;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return perror(path), 0;
+
+	trigrams->data = map;
+	trigrams->size = st.st_size;
+
+	memcpy(&trigrams->length, trigrams->data, sizeof(trigrams->length));
+	table_size = (size_t)trigrams->length * sizeof(struct trigram_entry);
+
+	if (trigrams->size - sizeof(uint32_t) < table_size) {
+		fprintf(stderr, "%s: Truncated trigrams index\n", path);
+		unmap_trigrams(trigrams);
+		return 0;
+	}
+
+	trigrams->entries = (struct trigram_entry*)(trigrams->data + sizeof(uint32_t));
+	trigrams->lists = trigrams->data + sizeof(uint32_t) + table_size;
+	return 1;
+}
+
+void unmap_trigrams(struct trigrams *trigrams)
+{
+	assert(trigrams != NULL);
+
+	if (trigrams->data)
+		munmap(trigrams->data, trigrams->size);
+
+	trigrams->data = NULL;
+	trigrams->size = 0;
+	trigrams->length = 0;
+	trigrams->entries = NULL;
+	trigrams->lists = NULL;
+}
+
+/* Decode the next rank of the list, return 0 if there is none */
+static int advance(struct trigram_list *list)
+{
+	unsigned long delta;
+
+	if (!list->remaining)
+		return 0;
+
+	if (!(list->ptr = get_varint(list->ptr, list->end, &delta))) {
+		list->remaining = 0;
+		return 0;
+	}
+
+	list->rank += delta;
+	list->remaining--;
+	return 1;
+}
+
+static int cmp_trigram(const void *key, const void *elem)
+{
+	uint32_t trigram = *(const uint32_t*)key;
+	const struct trigram_entry *entry = elem;
+
+	if (trigram != entry->trigram)
+		return trigram < entry->trigram ? -1 : 1;
+	return 0;
+}
+
+static int cmp_lists(const void *p1, const void *p2)
+{
+	const struct trigram_list *a = p1, *b = p2;
+
+	if (a->remaining != b->remaining)
+		return a->remaining < b->remaining ? -1 : 1;
+	return 0;
+}
+
+int init_trigrams_query(
+	const struct trigrams *trigrams, const char *query, struct trigrams_query *tq)
+{
+	uint32_t keys[MAX_TRIGRAMS];
+	const struct trigram_entry *entry;
+	const unsigned char *end;
+	unsigned i, n;
+
+	assert(trigrams != NULL);
+	assert(query != NULL);
+	assert(tq != NULL);
+
+	tq->nlists = 0;
+	end = trigrams->data + trigrams->size;
+
+	if (!(n = get_trigrams(query, keys)))
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		struct trigram_list *list = &tq->lists[i];
+
+		entry = bsearch(&keys[i], trigrams->entries, trigrams->length,
+		                sizeof(*trigrams->entries), cmp_trigram);
+		if (!entry || entry->offset >= (size_t)(end - trigrams->lists))
+			return 0;
+
+		list->ptr = trigrams->lists + entry->offset;
+		list->end = end;
+		list->rank = 0;
+		list->remaining = entry->length;
+
+		if (!advance(list))
+			return 0;
+	}
+
+	/* The shortest list drives the intersection */
+	qsort(tq->lists, n, sizeof(*tq->lists), cmp_lists);
+	tq->nlists = n;
+	return 1;
+}
+
+int next_candidate(struct trigrams_query *tq, unsigned *rank)
+{
+	struct trigram_list *list;
+	unsigned long target;
+	unsigned i;
+
+	assert(tq != NULL);
+	assert(rank != NULL);
+
+	if (!tq->nlists)
+		return 0;
+
+	/* Move every list up to the same rank */
+	target = tq->lists[0].rank;
+	i = 0;
+	while (i < tq->nlists) {
+		list = &tq->lists[i];
+
+		while (list->rank < target)
+			if (!advance(list))
+				goto end;
+
+		if (list->rank > target) {
+			target = list->rank;
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+
+	*rank = target;
+
+	if (!advance(&tq->lists[0]))
+		tq->nlists = 0;
+	return 1;
+
+end:
+	tq->nlists = 0;
+	return 0;
+}
@@ -0,0 +1,141 @@
+#ifndef TRIGRAMS_H
+#define TRIGRAMS_H
+
+/**
+ * @file trigrams.h
+ *
+ * The trigrams index of a generation lists, for each sequence of three
+ * bytes found in lowercased player names, the rank of every player
+ * whose name contains it.  A name contains a query only if it contains
+ * every trigram of the query, hence candidates for a query are found
+ * by intersecting a few lists instead of reading every name.  They
+ * still have to be checked, since trigrams may be in a different order.
+ *
+ * The file starts with the number of trigrams as an uint32_t, followed
+ * by a table sorted by trigram.  Each entry holds the trigram, the
+ * offset of its list from the end of the table, and its length, each
+ * as an uint32_t.  Lists hold increasing ranks as varints, each rank
+ * but the first being stored as the difference with the previous one.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hexname.h"
+
+/**
+ * @def MAX_TRIGRAMS
+ *
+ * Maximum number of trigrams in a name or in a query.
+ */
+#define MAX_TRIGRAMS (NAME_LENGTH - 3)
+
+struct trigram_entry {
+	uint32_t trigram;
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct trigrams_builder {
+	struct trigram_posting {
+		uint32_t trigram;
+		uint32_t rank;
+	} *postings;
+
+	size_t length;
+};
+
+struct trigrams {
+	unsigned char *data;
+	size_t size;
+
+	uint32_t length;
+	const struct trigram_entry *entries;
+	const unsigned char *lists;
+};
+
+struct trigrams_query {
+	unsigned nlists;
+
+	struct trigram_list {
+		const unsigned char *ptr, *end;
+		unsigned long rank;
+		uint32_t remaining;
+	} lists[MAX_TRIGRAMS];
+};
+
+/**
+ * Initialize an empty builder.  No memory is allocated until the first
+ * name is added.
+ *
+ * @param builder Builder to initialize
+ */
+void init_trigrams_builder(struct trigrams_builder *builder);
+
+/**
+ * Add the trigrams of the given player.  Players must be added by
+ * increasing rank.
+ *
+ * @param builder Builder
+ * @param name Player name, as an hexname
+ * @param rank Player rank
+ *
+ * @return 1 on success, 0 on failure
+ */
+int add_trigrams(struct trigrams_builder *builder, const char *name, unsigned rank);
+
+/**
+ * Write the index built so far, and free the builder.
+ *
+ * @param builder Builder
+ * @param path Path of the index
+ *
+ * @return 1 on success, 0 on failure
+ */
+int write_trigrams(struct trigrams_builder *builder, const char *path);
+
+/**
+ * Map the index stored in the given file.
+ *
+ * If the file does not exist, nothing is printed and errno is set to
+ * ENOENT, so that the caller can handle that case.
+ *
+ * @param trigrams Index to initialize
+ * @param path Path of the index
+ *
+ * @return 1 on success, 0 on failure
+ */
+int map_trigrams(struct trigrams *trigrams, const char *path);
+
+/**
+ * Unmap the given index.
+ *
+ * @param trigrams Index to unmap
+ */
+void unmap_trigrams(struct trigrams *trigrams);
+
+/**
+ * Start looking for the ranks of players whose name may contain the
+ * given query.  The query must be at least three bytes long, and it is
+ * lowercased the same way names are.
+ *
+ * @param trigrams Index
+ * @param query Query, as a raw name
+ * @param tq Query state to initialize
+ *
+ * @return 1 if there may be candidates, 0 otherwise
+ */
+int init_trigrams_query(
+	const struct trigrams *trigrams, const char *query, struct trigrams_query *tq);
+
+/**
+ * Get the next candidate, by increasing rank.
+ *
+ * @param tq Query state
+ * @param rank Rank of the candidate
+ *
+ * @return 1 if a candidate was found, 0 when there is no more of them
+ */
+int next_candidate(struct trigrams_query *tq, unsigned *rank);
+
+#endif /* TRIGRAMS_H */
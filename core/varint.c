@@ -0,0 +1,42 @@
+#include <stddef.h>
+
+#include "varint.h"
+
+unsigned char *put_varint(unsigned char *buf, unsigned long value)
+{
+	while (value >= 0x80) {
+		*buf++ = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+
+	*buf++ = value;
+	return buf;
+}
+
+const unsigned char *get_varint(
+	const unsigned char *buf, const unsigned char *end, unsigned long *value)
+{
+	unsigned long ret = 0;
+	unsigned shift;
+
+	for (shift = 0; buf < end && shift < MAX_VARINT_SIZE * 7; shift += 7) {
+		ret |= (unsigned long)(*buf & 0x7f) << shift;
+
+		if (!(*buf++ & 0x80)) {
+			*value = ret;
+			return buf;
+		}
+	}
+
+	return NULL;
+}
+
+unsigned long zigzag(long value)
+{
+	return ((unsigned long)value << 1) ^ (unsigned long)-(value < 0);
+}
+
+long unzigzag(unsigned long value)
+{
+	return (long)(value >> 1) ^ -(long)(value & 1);
+}
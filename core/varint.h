@@ -0,0 +1,64 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+/**
+ * @file varint.h
+ *
+ * Variable length encoding of integers: 7 bits per byte, least
+ * significant bits first, the highest bit of each byte being set when
+ * more bytes follow.  Small values take a single byte.
+ *
+ * Signed values are zig-zag encoded first, so that small negative
+ * values are small too: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+ */
+
+/**
+ * @def MAX_VARINT_SIZE
+ *
+ * Maximum size of an encoded unsigned long.
+ */
+#define MAX_VARINT_SIZE 10
+
+/**
+ * Encode the given value.  Buffer must be at least MAX_VARINT_SIZE
+ * bytes long.
+ *
+ * @param buf Buffer to write the encoded value to
+ * @param value Value to encode
+ *
+ * @return Pointer to the byte following the encoded value
+ */
+unsigned char *put_varint(unsigned char *buf, unsigned long value);
+
+/**
+ * Decode a value.
+ *
+ * @param buf Buffer to read the encoded value from
+ * @param end End of the buffer
+ * @param value Decoded value
+ *
+ * @return Pointer to the byte following the encoded value, NULL when
+ *         the buffer does not hold a valid varint
+ */
+const unsigned char *get_varint(
+	const unsigned char *buf, const unsigned char *end, unsigned long *value);
+
+/**
+ * Zig-zag encode a signed value.
+ *
+ * @param value Value to encode
+ *
+ * @return Encoded value
+ */
+unsigned long zigzag(long value);
+
+/**
+ * Zig-zag decode a value.
+ *
+ * @param value Value to decode
+ *
+ * @return Decoded signed value
+ */
+long unzigzag(unsigned long value);
+
+#endif /* VARINT_H */
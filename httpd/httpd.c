@@ -0,0 +1,756 @@
+/*
+ * Serve pages and static assets over HTTP, for small deployments that
+ * do not need a web server in front of teerank.  Pages are rendered
+ * with the same routes as teerank.cgi, and files in the assets
+ * directory are served as they are.
+ *
+ * One worker process per CPU is forked, all of them accepting
+ * connections from the same listening socket.  Each worker serves its
+ * connections with an epoll event loop, connections being kept alive
+ * as HTTP/1.1 allows.  Workers are processes and not threads, because
+ * pages are rendered one at a time with process wide state.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+
+#include "config.h"
+#include "cgi.h"
+
+#define DEFAULT_PORT "8000"
+#define DEFAULT_ASSETS "assets"
+
+#define MAX_REQUEST_SIZE 8192
+#define MAX_EVENTS 64
+
+/* Idle connections are closed after that many seconds */
+#define KEEP_ALIVE_TIMEOUT 10
+
+struct connection {
+	int fd;
+	uint32_t events;
+	time_t last_activity;
+
+	/*
+	 * Set once no more requests are to be answered, either because
+	 * the last response closes the connection, or because the client
+	 * has nothing more to send.
+	 */
+	int is_closing, has_eof;
+
+	char in[MAX_REQUEST_SIZE];
+	size_t inlen;
+
+	char *out;
+	size_t outlen, outpos, outsize;
+
+	struct connection *prev, *next;
+};
+
+struct request {
+	int is_head;
+	int keep_alive;
+
+	char *path;
+	char *query;
+
+	int has_host;
+
+	char *if_none_match;
+	char *if_modified_since;
+	char *accept_encoding;
+};
+
+static const char *port = DEFAULT_PORT;
+static const char *assets = DEFAULT_ASSETS;
+
+/*
+ * Name and port used in links, never taken from the request.  When a
+ * server name is given, requests for any other host are rejected.
+ */
+static char *server_name = "localhost";
+static const char *server_port;
+static int check_host;
+
+static int epfd;
+static struct connection *connections;
+
+static int reserve(struct connection *conn, size_t size)
+{
+	size_t newsize;
+	char *tmp;
+
+	if (conn->outlen + size <= conn->outsize)
+		return 1;
+
+	newsize = conn->outsize ? conn->outsize : 4096;
+	while (newsize < conn->outlen + size)
+		newsize *= 2;
+
+	if (!(tmp = realloc(conn->out, newsize)))
+		return perror("realloc(out)"), 0;
+
+	conn->out = tmp;
+	conn->outsize = newsize;
+	return 1;
+}
+
+static int append(struct connection *conn, const void *data, size_t size)
+{
+	if (!reserve(conn, size))
+		return 0;
+
+	memcpy(conn->out + conn->outlen, data, size);
+	conn->outlen += size;
+	return 1;
+}
+
+/*
+ * Append the status line and headers of a response.  "headers" holds
+ * extra headers, each of them ending with CRLF.
+ */
+static int append_headers(
+	struct connection *conn, const char *status, const char *headers,
+	size_t length, int keep_alive)
+{
+	char buf[512];
+	int ret;
+
+	/* A 304 must not have a Content-Length, unless it is the full one */
+	if (!strncmp(status, "304", 3))
+		ret = snprintf(
+			buf, sizeof(buf),
+			"HTTP/1.1 %s\r\n"
+			"Connection: %s\r\n",
+			status, keep_alive ? "keep-alive" : "close");
+	else
+		ret = snprintf(
+			buf, sizeof(buf),
+			"HTTP/1.1 %s\r\n"
+			"Content-Length: %lu\r\n"
+			"Connection: %s\r\n",
+			status, (unsigned long)length, keep_alive ? "keep-alive" : "close");
+
+	assert((size_t)ret < sizeof(buf));
+
+	if (!keep_alive)
+		conn->is_closing = 1;
+
+	return append(conn, buf, ret)
+		&& append(conn, headers, strlen(headers))
+		&& append(conn, "\r\n", 2);
+}
+
+static void send_error(struct connection *conn, const char *status)
+{
+	char body[128];
+	int length;
+
+	length = snprintf(body, sizeof(body), "<h1>%s</h1>\n", status);
+	if (append_headers(conn, status, "Content-Type: text/html\r\n", length, 0))
+		append(conn, body, length);
+}
+
+static char *skip_spaces(char *str)
+{
+	while (*str == ' ' || *str == '\t')
+		str++;
+	return str;
+}
+
+/* Split "name[:port]", a port inside brackets being part of an IPv6 */
+static char *split_port(char *host)
+{
+	char *colon;
+
+	if ((colon = strrchr(host, ':')) && !strchr(colon, ']')) {
+		*colon = '\0';
+		return colon + 1;
+	}
+
+	return NULL;
+}
+
+static int is_valid_host(char *host)
+{
+	if (!check_host)
+		return 1;
+
+	split_port(host);
+	return !strcasecmp(host, server_name);
+}
+
+/*
+ * Parse the given header, nul terminated and without the final empty
+ * line.  Return NULL on success, or the status to answer with.
+ */
+static const char *parse_request(char *buf, struct request *req)
+{
+	char *line, *next, *method, *target, *version, *value;
+
+	req->has_host = 0;
+	req->if_none_match = NULL;
+	req->if_modified_since = NULL;
+	req->accept_encoding = NULL;
+
+	/* Request line */
+	line = buf;
+	if ((next = strstr(line, "\r\n"))) {
+		*next = '\0';
+		next += 2;
+	}
+
+	method = strtok(line, " ");
+	target = strtok(NULL, " ");
+	version = strtok(NULL, " ");
+
+	if (!method || !target || !version || strtok(NULL, " "))
+		return "400 Bad Request";
+
+	if (!strcmp(method, "GET"))
+		req->is_head = 0;
+	else if (!strcmp(method, "HEAD"))
+		req->is_head = 1;
+	else
+		return "501 Not Implemented";
+
+	if (!strcmp(version, "HTTP/1.1"))
+		req->keep_alive = 1;
+	else if (!strcmp(version, "HTTP/1.0"))
+		req->keep_alive = 0;
+	else
+		return "505 HTTP Version Not Supported";
+
+	if (*target != '/')
+		return "400 Bad Request";
+
+	req->path = target;
+	if ((req->query = strchr(target, '?')))
+		*req->query++ = '\0';
+	else
+		req->query = "";
+
+	/* Headers, only the few we care about */
+	while ((line = next)) {
+		if ((next = strstr(line, "\r\n"))) {
+			*next = '\0';
+			next += 2;
+		}
+
+		if (!(value = strchr(line, ':')))
+			return "400 Bad Request";
+		*value++ = '\0';
+		value = skip_spaces(value);
+
+		if (!strcasecmp(line, "Host")) {
+			if (!is_valid_host(value))
+				return "400 Bad Request";
+			req->has_host = 1;
+		} else if (!strcasecmp(line, "Connection")) {
+			if (!strcasecmp(value, "close"))
+				req->keep_alive = 0;
+			else if (!strcasecmp(value, "keep-alive"))
+				req->keep_alive = 1;
+		} else if (!strcasecmp(line, "If-None-Match")) {
+			req->if_none_match = value;
+		} else if (!strcasecmp(line, "If-Modified-Since")) {
+			req->if_modified_since = value;
+		} else if (!strcasecmp(line, "Accept-Encoding")) {
+			req->accept_encoding = value;
+		}
+	}
+
+	if (!strcmp(version, "HTTP/1.1") && !req->has_host)
+		return "400 Bad Request";
+
+	return NULL;
+}
+
+static const char *get_request_param(const char *name, void *data)
+{
+	struct request *req = data;
+
+	if (!strcmp(name, "DOCUMENT_URI"))
+		return req->path;
+	else if (!strcmp(name, "QUERY_STRING"))
+		return req->query;
+	else if (!strcmp(name, "SERVER_NAME"))
+		return server_name;
+	else if (!strcmp(name, "SERVER_PORT"))
+		return server_port;
+	else if (!strcmp(name, "HTTP_IF_NONE_MATCH"))
+		return req->if_none_match;
+	else if (!strcmp(name, "HTTP_IF_MODIFIED_SINCE"))
+		return req->if_modified_since;
+	else if (!strcmp(name, "HTTP_ACCEPT_ENCODING"))
+		return req->accept_encoding;
+
+	return NULL;
+}
+
+static void send_page(struct connection *conn, struct request *req)
+{
+	char status[64], headers[MAX_HEADERS_LENGTH];
+	struct response res;
+	int length;
+
+	render_page(&res, get_request_param, req);
+
+	snprintf(status, sizeof(status), "%d %s", res.status, reason_phrase(res.status));
+	length = snprintf(headers, sizeof(headers), "Content-Type: %s\r\n", res.content_type);
+	format_page_headers(&res, headers + length, sizeof(headers) - length, "\r\n");
+
+	if (append_headers(conn, status, headers, res.length, req->keep_alive) && !req->is_head)
+		append(conn, res.body, res.length);
+}
+
+static const char *get_content_type(const char *path)
+{
+	static const struct {
+		const char *ext, *type;
+	} types[] = {
+		{ ".html", "text/html" },
+		{ ".css", "text/css" },
+		{ ".txt", "text/plain" },
+		{ ".xml", "text/xml" },
+		{ ".js", "application/javascript" },
+		{ ".png", "image/png" },
+		{ ".svg", "image/svg+xml" },
+		{ ".ico", "image/x-icon" },
+		{ NULL }
+	};
+
+	const char *ext;
+	unsigned i;
+
+	if ((ext = strrchr(path, '.')))
+		for (i = 0; types[i].ext; i++)
+			if (!strcmp(ext, types[i].ext))
+				return types[i].type;
+
+	return "application/octet-stream";
+}
+
+/*
+ * Serve the asset matching the requested path, if any.  Hidden files
+ * and parent directories are never served.
+ */
+static int send_asset(struct connection *conn, struct request *req)
+{
+	char path[PATH_MAX], headers[128];
+	struct stat st;
+	ssize_t ret;
+	size_t size;
+	int fd;
+
+	if (strstr(req->path, "/."))
+		return 0;
+
+	if (snprintf(path, PATH_MAX, "%s%s", assets, req->path) >= PATH_MAX)
+		return 0;
+	if ((fd = open(path, O_RDONLY)) == -1)
+		return 0;
+
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return 0;
+	}
+
+	snprintf(headers, sizeof(headers), "Content-Type: %s\r\n",
+	         get_content_type(path));
+
+	if (!append_headers(conn, "200 OK", headers, st.st_size, req->keep_alive))
+		goto out;
+	if (req->is_head || !reserve(conn, st.st_size))
+		goto out;
+
+	for (size = 0; size < (size_t)st.st_size; size += ret) {
+		ret = read(fd, conn->out + conn->outlen + size, st.st_size - size);
+		if (ret == -1 && errno == EINTR)
+			ret = 0;
+		else if (ret <= 0)
+			break;
+	}
+
+	/* Headers are sent already, the connection can't be used anymore */
+	if (size < (size_t)st.st_size) {
+		perror(path);
+		conn->is_closing = 1;
+	}
+	conn->outlen += size;
+
+out:
+	close(fd);
+	return 1;
+}
+
+static void handle_request(struct connection *conn, char *buf)
+{
+	struct request req;
+	const char *status;
+
+	if ((status = parse_request(buf, &req))) {
+		send_error(conn, status);
+		return;
+	}
+
+	verbose("%s %s%s%s\n", req.is_head ? "HEAD" : "GET", req.path,
+	        *req.query ? "?" : "", req.query);
+
+	if (!strcmp(req.path, "/"))
+		append_headers(conn, "302 Found", "Location: /pages/1.html\r\n",
+		               0, req.keep_alive);
+	else if (!send_asset(conn, &req))
+		send_page(conn, &req);
+}
+
+static char *find_header_end(char *buf, size_t length)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= length; i++)
+		if (!memcmp(buf + i, "\r\n\r\n", 4))
+			return buf + i;
+
+	return NULL;
+}
+
+/* Answer every complete request received so far */
+static void process_input(struct connection *conn)
+{
+	size_t length;
+	char *end;
+
+	while (!conn->is_closing && (end = find_header_end(conn->in, conn->inlen))) {
+		*end = '\0';
+		length = end - conn->in + 4;
+
+		handle_request(conn, conn->in);
+
+		memmove(conn->in, conn->in + length, conn->inlen - length);
+		conn->inlen -= length;
+	}
+
+	if (!conn->is_closing && conn->inlen == MAX_REQUEST_SIZE)
+		send_error(conn, "431 Request Header Fields Too Large");
+	else if (!conn->is_closing && conn->has_eof && conn->inlen)
+		send_error(conn, "400 Bad Request");
+}
+
+static int watch(struct connection *conn, uint32_t events)
+{
+	struct epoll_event ev;
+
+	if (conn->events == events)
+		return 1;
+
+	ev.events = events;
+	ev.data.ptr = conn;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev) == -1)
+		return perror("epoll_ctl(mod)"), 0;
+
+	conn->events = events;
+	return 1;
+}
+
+/*
+ * Send pending output.  Input is not read until output is fully sent,
+ * so that a client can't make us buffer an unbounded amount of
+ * responses.  Return 0 when the connection must be closed.
+ */
+static int flush_output(struct connection *conn)
+{
+	ssize_t ret;
+
+	while (conn->outpos < conn->outlen) {
+		ret = write(conn->fd, conn->out + conn->outpos, conn->outlen - conn->outpos);
+		if (ret == -1 && errno == EINTR)
+			continue;
+		else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return watch(conn, EPOLLOUT);
+		else if (ret == -1)
+			return 0;
+
+		conn->outpos += ret;
+		conn->last_activity = time(NULL);
+	}
+
+	conn->outpos = conn->outlen = 0;
+
+	if (conn->is_closing || conn->has_eof)
+		return 0;
+
+	return watch(conn, EPOLLIN);
+}
+
+static void close_connection(struct connection *conn)
+{
+	epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+	close(conn->fd);
+
+	if (conn->prev)
+		conn->prev->next = conn->next;
+	else
+		connections = conn->next;
+	if (conn->next)
+		conn->next->prev = conn->prev;
+
+	free(conn->out);
+	free(conn);
+}
+
+static void handle_connection(struct connection *conn, uint32_t events)
+{
+	ssize_t ret;
+
+	if (events & EPOLLERR) {
+		close_connection(conn);
+		return;
+	}
+
+	if (events & (EPOLLIN | EPOLLHUP)) {
+		ret = read(conn->fd, conn->in + conn->inlen, MAX_REQUEST_SIZE - conn->inlen);
+
+		if (ret == -1 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		else if (ret == -1) {
+			close_connection(conn);
+			return;
+		}
+
+		/* Answer what has been received, then close */
+		if (ret == 0)
+			conn->has_eof = 1;
+
+		conn->inlen += ret;
+		conn->last_activity = time(NULL);
+	}
+
+	process_input(conn);
+
+	if (!flush_output(conn))
+		close_connection(conn);
+}
+
+static void accept_connections(int listen_fd)
+{
+	struct connection *conn;
+	struct epoll_event ev;
+	int fd;
+
+	while ((fd = accept(listen_fd, NULL, NULL)) != -1 || errno == EINTR) {
+		if (fd == -1)
+			continue;
+
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
+			perror("fcntl(O_NONBLOCK)");
+			close(fd);
+			continue;
+		}
+
+		if (!(conn = calloc(1, sizeof(*conn)))) {
+			perror("calloc(connection)");
+			close(fd);
+			continue;
+		}
+
+		conn->fd = fd;
+		conn->events = EPOLLIN;
+		conn->last_activity = time(NULL);
+
+		ev.events = conn->events;
+		ev.data.ptr = conn;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			perror("epoll_ctl(add)");
+			close(fd);
+			free(conn);
+			continue;
+		}
+
+		conn->next = connections;
+		if (connections)
+			connections->prev = conn;
+		connections = conn;
+	}
+
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED)
+		perror("accept()");
+}
+
+static void close_idle_connections(time_t now)
+{
+	struct connection *conn, *next;
+
+	for (conn = connections; conn; conn = next) {
+		next = conn->next;
+		if (now - conn->last_activity > KEEP_ALIVE_TIMEOUT)
+			close_connection(conn);
+	}
+}
+
+static void worker(int listen_fd)
+{
+	struct epoll_event events[MAX_EVENTS], ev;
+	time_t now, last_sweep = 0;
+	int n, i;
+
+	if ((epfd = epoll_create1(0)) == -1) {
+		perror("epoll_create1()");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Only wake up one worker per incoming connection */
+	ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) == -1) {
+		perror("epoll_ctl(listen)");
+		exit(EXIT_FAILURE);
+	}
+
+	for (;;) {
+		if ((n = epoll_wait(epfd, events, MAX_EVENTS, 1000)) == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait()");
+			exit(EXIT_FAILURE);
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr)
+				handle_connection(events[i].data.ptr, events[i].events);
+			else
+				accept_connections(listen_fd);
+		}
+
+		if ((now = time(NULL)) != last_sweep) {
+			close_idle_connections(now);
+			last_sweep = now;
+		}
+	}
+}
+
+static int listen_on(const char *port)
+{
+	struct sockaddr_in addr;
+	char *end;
+	long num;
+	int fd, one = 1;
+
+	num = strtol(port, &end, 10);
+	if (*port == '\0' || *end != '\0' || num <= 0 || num > 65535) {
+		fprintf(stderr, "%s: Invalid port\n", port);
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(num);
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) == -1)
+		return perror("socket()"), -1;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == -1)
+		goto fail;
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+		goto fail;
+	if (listen(fd, SOMAXCONN) == -1)
+		goto fail;
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1)
+		goto fail;
+
+	return fd;
+
+fail:
+	perror(port);
+	close(fd);
+	return -1;
+}
+
+static pid_t start_worker(int listen_fd)
+{
+	pid_t pid;
+
+	if ((pid = fork()) == -1)
+		perror("fork()");
+	else if (pid == 0)
+		worker(listen_fd);
+
+	return pid;
+}
+
+int main(int argc, char **argv)
+{
+	long nworkers, i;
+	int listen_fd, status;
+	pid_t pid;
+
+	load_config(1);
+
+	if (argc > 4) {
+		fprintf(stderr, "usage: %s [<port> [<assets> [<server name>[:<port>]]]]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		port = argv[1];
+	if (argc > 2)
+		assets = argv[2];
+
+	/* Links use the port we listen on, unless a server name is given */
+	server_port = port;
+	if (argc > 3) {
+		server_name = argv[3];
+		if (!(server_port = split_port(server_name)))
+			server_port = "80";
+		check_host = 1;
+	}
+
+	if ((listen_fd = listen_on(port)) == -1)
+		return EXIT_FAILURE;
+
+	/* A client closing a connection must not kill us */
+	signal(SIGPIPE, SIG_IGN);
+
+	nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers < 1)
+		nworkers = 1;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < nworkers; i++)
+		if (start_worker(listen_fd) == -1)
+			return EXIT_FAILURE;
+
+	verbose("Listening on port %s with %ld workers\n", port, nworkers);
+
+	/* Replace workers that die, without spinning if they keep dying */
+	while ((pid = wait(&status)) != -1 || errno == EINTR) {
+		if (pid == -1)
+			continue;
+
+		fprintf(stderr, "Worker %ld died, restarting it\n", (long)pid);
+		sleep(1);
+		start_worker(listen_fd);
+	}
+
+	perror("wait()");
+	return EXIT_FAILURE;
+}
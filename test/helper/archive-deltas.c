@@ -0,0 +1,36 @@
+/*
+ * Stand in for teerank-update-servers: archive deltas read on stdin as
+ * one update cycle, and print them for teerank-update-players.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "config.h"
+#include "delta.h"
+#include "archive.h"
+
+int main(int argc, char **argv)
+{
+	struct delta delta;
+	time_t now;
+
+	load_config(1);
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s <deltas\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	now = time(NULL);
+	if (!archive_cycle(now))
+		return EXIT_FAILURE;
+
+	while (scan_delta(&delta)) {
+		if (!archive_delta(&delta, now))
+			return EXIT_FAILURE;
+		print_delta(&delta);
+	}
+
+	return EXIT_SUCCESS;
+}
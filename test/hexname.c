@@ -0,0 +1,166 @@
+/*
+ * Check hexname conversions against a plain byte per byte reference:
+ * every byte value at every position is encoded and decoded back, and
+ * every pair of characters at every position of a hex string is
+ * decoded.  Built as test/hexname and test/hexname-table, so that both
+ * SSE2 and lookup tables conversions are checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hexname.h"
+
+static unsigned long failures;
+
+static void fail(const char *what, const char *str)
+{
+	size_t i;
+
+	if (failures++ >= 10)
+		return;
+
+	fprintf(stderr, "%s:", what);
+	for (i = 0; str[i]; i++)
+		fprintf(stderr, " %02x", (unsigned char)str[i]);
+	fprintf(stderr, "\n");
+}
+
+static int digit_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Longest name that can be encoded, without its nul byte */
+#define MAX_LENGTH ((HEXNAME_LENGTH - 1) / 2 - 1)
+
+static void reference_encode(const char *name, char *hex)
+{
+	size_t i;
+
+	for (i = 0; i < MAX_LENGTH && name[i]; i++)
+		sprintf(hex + 2 * i, "%02x", (unsigned char)name[i]);
+	strcpy(hex + 2 * i, "00");
+}
+
+static int reference_decode(const char *hex, char *name)
+{
+	size_t len = strlen(hex), i;
+
+	if (len < 2 || len > HEXNAME_LENGTH - 1 || len % 2)
+		return 0;
+
+	for (i = 0; i < len; i += 2) {
+		int hi = digit_value(hex[i]), lo = digit_value(hex[i + 1]);
+
+		if (hi == -1 || lo == -1)
+			return 0;
+
+		/* Only the last byte is a nul byte */
+		name[i / 2] = hi << 4 | lo;
+		if ((name[i / 2] == '\0') != (i == len - 2))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void check_name(const char *name)
+{
+	char hex[HEXNAME_LENGTH], expected_hex[HEXNAME_LENGTH];
+	char decoded[NAME_LENGTH];
+
+	reference_encode(name, expected_hex);
+	name_to_hexname(name, hex);
+
+	if (strcmp(hex, expected_hex) != 0)
+		fail("Wrong encoding", name);
+	else if (!decode_hexname(hex, decoded) || !is_valid_hexname(hex))
+		fail("Encoded name cannot be decoded", name);
+	else if (strncmp(decoded, name, MAX_LENGTH) != 0)
+		fail("Wrong round trip", name);
+}
+
+static void check_hexname(const char *hex)
+{
+	char name[NAME_LENGTH], expected_name[NAME_LENGTH];
+	int valid, expected_valid;
+
+	expected_valid = reference_decode(hex, expected_name);
+	valid = decode_hexname(hex, name);
+
+	if (valid != is_valid_hexname(hex))
+		fail("decode_hexname() and is_valid_hexname() disagree", hex);
+	else if (valid != expected_valid)
+		fail(valid ? "Invalid hexname decoded" : "Valid hexname not decoded", hex);
+	else if (valid && strcmp(name, expected_name) != 0)
+		fail("Wrong decoding", hex);
+}
+
+/* Every byte at every position of names of every length */
+static void check_names(void)
+{
+	char name[NAME_LENGTH + 1];
+	unsigned len, pos, c;
+
+	for (len = 0; len <= NAME_LENGTH; len++) {
+		for (pos = 0; pos < len || (len == 0 && pos == 0); pos++) {
+			for (c = 1; c < 256; c++) {
+				memset(name, 'a', len);
+				name[len] = '\0';
+				if (len)
+					name[pos] = c;
+				check_name(name);
+			}
+		}
+	}
+}
+
+/* Every pair of characters at every position of hex strings */
+static void check_hexnames(void)
+{
+	char hex[HEXNAME_LENGTH + 2];
+	unsigned len, pos, a, b;
+
+	for (len = 2; len <= HEXNAME_LENGTH + 1; len++) {
+		for (pos = 0; pos + 1 < len; pos += 2) {
+			for (a = 1; a < 256; a++) {
+				for (b = 1; b < 256; b++) {
+					memset(hex, '6', len - 2);
+					strcpy(hex + len - 2, "00");
+					hex[pos] = a;
+					hex[pos + 1] = b;
+					check_hexname(hex);
+				}
+			}
+		}
+	}
+
+	check_hexname("");
+	check_hexname("0");
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	check_names();
+	check_hexnames();
+
+	if (failures) {
+		fprintf(stderr, "%lu failures\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Rate players with teerank-update-players, then again from scratch with
+# teerank-replay: elos must be the same.  There are more than 1024
+# players so that arrays of players are grown in the middle of games.
+#
+
+set -e
+
+export TEERANK_ROOT="$(mktemp -d)"
+trap 'rm -rf "$TEERANK_ROOT"' EXIT
+
+# Print games of 10 players, every player is in one game of each cycle
+games() {
+	awk -v nplayers=1500 -v cycle="$1" 'BEGIN {
+		for (i = 0; i < 256; i++)
+			ord[sprintf("%c", i)] = i;
+
+		for (g = 0; g < nplayers / 10; g++) {
+			print 10, 300;
+			for (j = 0; j < 10; j++) {
+				i = (g * 10 + j + cycle * 7 * j) % nplayers;
+				name = "player" i;
+				hex = "";
+				for (k = 1; k <= length(name); k++)
+					hex = hex sprintf("%02x", ord[substr(name, k, 1)]);
+				print hex "00", "00", (i * 7) % 23, (i * 13 + g + cycle) % 11;
+			}
+		}
+	}'
+}
+
+# Clan and elo of every player
+dump() {
+	find "$TEERANK_ROOT/players" -type f | sort | while read -r path; do
+		printf '%s %s %s\n' "${path##*/}" "$(sed -n 1p "$path")" \
+			"$(sed -n 2p "$path" | cut -d' ' -f1)"
+	done
+}
+
+teerank-init
+for cycle in 0 1 2; do
+	games $cycle | archive-deltas | teerank-update-players >/dev/null
+done
+dump >"$TEERANK_ROOT/expected"
+
+teerank-replay
+dump >"$TEERANK_ROOT/got"
+
+test "$(wc -l <"$TEERANK_ROOT/got")" -eq 1500
+cmp "$TEERANK_ROOT/expected" "$TEERANK_ROOT/got"
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# Request pages with malformed names: each must get a 404 page, and never
+# crash the process, as it may be serving other requests as well.
+#
+
+set -e
+
+export TEERANK_ROOT="$(mktemp -d)"
+trap 'rm -rf "$TEERANK_ROOT"' EXIT
+
+teerank-init
+
+check() {
+	ret=0
+	PATH_INFO="$1" teerank.cgi >"$TEERANK_ROOT/page" 2>/dev/null || ret=$?
+	if [ "$ret" -gt 128 ]; then
+		echo "$1: Killed by signal $((ret - 128))" >&2
+		exit 1
+	fi
+
+	got="$(sed -n 's/^Status: //p' "$TEERANK_ROOT/page" | tr -d '\r')"
+	if [ "$got" != "404 Not Found" ]; then
+		echo "$1: Got status '$got', expected '404 Not Found'" >&2
+		exit 1
+	fi
+}
+
+# Filenames made only of dots have no basename
+for dir in players clans pages; do
+	check "/$dir/..."
+	check "/$dir/.."
+done
+
+check "/players/.html"
+check "/players/zz.html"
+check "/clans/.html"
+check "/unknown/page.html"
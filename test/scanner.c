@@ -0,0 +1,317 @@
+/*
+ * Read sample server, clan, player and version files and write them
+ * back: bytes must be the same.  Then scan deltas from stdin when they
+ * do not fit in a single read(), so that a token is split between two
+ * reads, and print them back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "scanner.h"
+#include "server.h"
+#include "clan.h"
+#include "player.h"
+#include "dict.h"
+#include "delta.h"
+
+/* Stream scanners first read() that much */
+#define FIRST_READ 4095
+
+static char root[] = "/tmp/teerank-test-XXXXXX";
+
+static char *get_path(const char *fmt, const char *name)
+{
+	static char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/", config.root);
+	snprintf(path + strlen(path), sizeof(path) - strlen(path), fmt, name);
+	return path;
+}
+
+static int write_file(const char *path, const char *buf, size_t size)
+{
+	FILE *file;
+
+	if (!(file = fopen(path, "w")))
+		return perror(path), 0;
+	if (fwrite(buf, 1, size, file) != size) {
+		perror(path);
+		fclose(file);
+		return 0;
+	}
+
+	return fclose(file) == 0;
+}
+
+/* Malloc()ed content of the given file */
+static char *read_file(const char *path, size_t *size)
+{
+	static struct scanner sc;
+	char *buf;
+
+	if (!open_scanner(&sc, path))
+		return perror(path), NULL;
+
+	*size = sc.end - sc.pos;
+	if (!(buf = malloc(*size + 1)))
+		return perror("malloc(file)"), NULL;
+
+	memcpy(buf, sc.pos, *size + 1);
+	return buf;
+}
+
+static int check_file(const char *path, const char *expected, size_t size)
+{
+	size_t got_size;
+	char *got;
+	int ret;
+
+	if (!(got = read_file(path, &got_size)))
+		return 0;
+
+	ret = got_size == size && memcmp(got, expected, size) == 0;
+	if (!ret)
+		fprintf(stderr, "%s: Not the same after being read and written\n", path);
+
+	free(got);
+	return ret;
+}
+
+static char *hexname(const char *name)
+{
+	static char hex[4][HEXNAME_LENGTH];
+	static unsigned i;
+
+	i = (i + 1) % 4;
+	name_to_hexname(name, hex[i]);
+	return hex[i];
+}
+
+static int test_server(void)
+{
+	static struct server_state state;
+	char sname[] = "127.0.0.1:8303";
+	char buf[1024];
+	char *path;
+
+	snprintf(buf, sizeof(buf),
+	         "last seen: 1500000000\n"
+	         "expire: 1500000600\n"
+	         "3\n"
+	         "%s 00 12\n"
+	         "%s %s -3\n"
+	         "%s 00 0\n",
+	         hexname("nameless tee"),
+	         hexname("brainless tee"), hexname("clan"),
+	         hexname("(1)nameless tee"));
+
+	path = get_path("servers/%s", sname);
+	if (!write_file(path, buf, strlen(buf)))
+		return 0;
+
+	if (!read_server_state(&state, sname))
+		return 0;
+	if (!write_server_state(&state, sname))
+		return 0;
+
+	return check_file(path, buf, strlen(buf));
+}
+
+static int test_clan(void)
+{
+	static const char *names[] = { "foo", "bar", "baz", "qux" };
+	struct clan clan = { 0 };
+	char buf[1024] = "";
+	char *path;
+	unsigned i, id;
+	int ret;
+
+	/* Members are out of order, to make sure order is kept */
+	for (i = 0; i < 4; i++) {
+		if ((id = register_player(hexname(names[3 - i]))) == NO_ID)
+			return 0;
+	}
+	for (i = 0; i < 4; i++) {
+		id = get_player_id(hexname(names[i]));
+		sprintf(buf + strlen(buf), "%u\n", id);
+	}
+
+	path = get_path("clans/%s", hexname("clan"));
+	if (!write_file(path, buf, strlen(buf)))
+		return 0;
+
+	if (!read_clan(&clan, hexname("clan")))
+		return 0;
+	ret = write_clan(&clan);
+	free_clan(&clan);
+
+	return ret && check_file(path, buf, strlen(buf));
+}
+
+/*
+ * The historic of the player is long enough to be made of several
+ * blocks, records following the one of the new player.  The player is
+ * written back both with only the last record loaded, and with the
+ * whole historic loaded.
+ */
+static int test_player(void)
+{
+	static struct player player;
+	struct player_record rec;
+	char *name, *path, *buf;
+	time_t t = time(NULL);
+	size_t size;
+	unsigned i;
+	int ret = 0;
+
+	name = hexname("nameless tee");
+	init_player(&player);
+	create_player(&player, name);
+	strcpy(player.clan, hexname("clan"));
+
+	for (i = 0; i < 1000; i++) {
+		init_player_record(&rec, 1500 + i % 37 - (int)(i % 11) * 3, 1 + i % 13);
+		if (!append_record_at(&player.hist, &rec, t + (i + 1) * 300))
+			return 0;
+	}
+	player.elo = rec.elo;
+	player.rank = rec.rank;
+
+	if (!write_player(&player))
+		return 0;
+
+	path = get_player_path(name);
+	if (!(buf = read_file(path, &size)))
+		return 0;
+
+	if (read_player(&player, name) != PLAYER_FOUND)
+		goto out;
+	if (!write_player(&player) || !check_file(path, buf, size))
+		goto out;
+
+	if (read_player(&player, name) != PLAYER_FOUND)
+		goto out;
+	if (!load_historic(&player.hist))
+		goto out;
+	if (!write_player(&player) || !check_file(path, buf, size))
+		goto out;
+
+	ret = 1;
+out:
+	free(buf);
+	return ret;
+}
+
+/* Version files are written by teerank-init only, the same way */
+static int test_version(void)
+{
+	static struct scanner sc;
+	char buf[64];
+	char *path;
+	unsigned version;
+
+	path = get_path("%s", "version");
+	if (!open_scanner(&sc, path))
+		return perror(path), 0;
+	if (!scan_unsigned(&sc, &version) || !scan_eof(&sc))
+		return fprintf(stderr, "%s: Cannot match version\n", path), 0;
+
+	snprintf(buf, sizeof(buf), "%u", version);
+	return check_file(path, buf, strlen(buf));
+}
+
+/*
+ * Deltas are written in a pipe before being read, so that the first
+ * read() is full and ends in the middle of a player name.
+ */
+static int test_stream(void)
+{
+	static struct delta delta;
+	static char buf[8192];
+	size_t len = 0, start;
+	char name[NAME_LENGTH];
+	unsigned i, j;
+	int fds[2];
+	char *path;
+	FILE *out;
+
+	for (i = 0; len < FIRST_READ + 1024; i++) {
+		len += sprintf(buf + len, "%u %d\n", MAX_PLAYERS, 300);
+		for (j = 0; j < MAX_PLAYERS; j++) {
+			/*
+			 * Names get longer with every delta, starting
+			 * from a length that puts a name over FIRST_READ.
+			 */
+			sprintf(name, "%.*s%u", (int)((i + 3) % 12), "abcdefghijkl", j);
+			len += sprintf(buf + len, "%s %s %d %d\n",
+			               hexname(name), j % 3 ? "00" : hexname("clan"),
+			               (int)(i * j % 50), (int)(j % 7) - 3);
+		}
+	}
+
+	/* Player names are the first token of their line */
+	for (start = FIRST_READ; !isspace((unsigned char)buf[start - 1]); start--)
+		;
+	if (start == FIRST_READ || buf[start - 1] != '\n' ||
+	    isspace((unsigned char)buf[FIRST_READ])) {
+		fprintf(stderr, "No player name spans the first read()\n");
+		return 0;
+	}
+
+	if (pipe(fds) == -1)
+		return perror("pipe()"), 0;
+	if (write(fds[1], buf, len) != (ssize_t)len)
+		return perror("write(pipe)"), 0;
+	close(fds[1]);
+
+	if (dup2(fds[0], STDIN_FILENO) == -1)
+		return perror("dup2(stdin)"), 0;
+	close(fds[0]);
+
+	path = get_path("%s", "deltas");
+	if (!(out = freopen(path, "w", stdout)))
+		return perror(path), 0;
+
+	while (scan_delta(&delta))
+		print_delta(&delta);
+	if (fclose(out) != 0)
+		return perror(path), 0;
+
+	return check_file(path, buf, len);
+}
+
+int main(int argc, char **argv)
+{
+	char cmd[PATH_MAX];
+	int ret;
+
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (!mkdtemp(root))
+		return perror(root), EXIT_FAILURE;
+	setenv("TEERANK_ROOT", root, 1);
+
+	snprintf(cmd, sizeof(cmd), "teerank-init && test -f %s/version", root);
+	if (system(cmd) != 0)
+		return EXIT_FAILURE;
+	load_config(1);
+
+	ret = test_server() && test_clan() && test_player() &&
+		test_version() && test_stream();
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if (system(cmd) != 0)
+		ret = 0;
+
+	return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -65,8 +65,7 @@ static int read_old_player(struct player *player, char *name)
 
         create_historic(&player->hist);
 
-        rec.elo = player->elo;
-        rec.rank = player->rank;
+        init_player_record(&rec, player->elo, player->rank);
         append_record(&player->hist, &rec);
 
         return 1;
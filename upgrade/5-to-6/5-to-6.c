@@ -0,0 +1,27 @@
+/*
+ * Database version 6 is still in development.  This program convert a
+ * version 5 database to the current development format, which differs
+ * in the way player historics are stored, where players are given an
+ * id used in ranks and clan files, and where player files are sharded
+ * in subdirectories.
+ */
+
+#include <stdlib.h>
+
+#include "5-to-6.h"
+#include "config.h"
+#include "commit.h"
+
+int main(int argc, char *argv[])
+{
+	load_config(0);
+
+	upgrade_players();
+	upgrade_ranks();
+	upgrade_clans();
+
+	if (!sync_commits())
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
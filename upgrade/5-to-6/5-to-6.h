@@ -0,0 +1,8 @@
+#ifndef HEADER_GUARD_5_TO_6
+#define HEADER_GUARD_5_TO_6
+
+void upgrade_players(void);
+void upgrade_ranks(void);
+void upgrade_clans(void);
+
+#endif /* HEADER_GUARD_5_TO_6 */
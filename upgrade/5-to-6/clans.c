@@ -0,0 +1,102 @@
+/*
+ * Version 5 clan files list the name of each member, one per line.
+ * Names are now replaced by player ids.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+
+#include "5-to-6.h"
+#include "config.h"
+#include "player.h"
+#include "dict.h"
+
+static void upgrade(const char *old, const char *new)
+{
+	FILE *fold = NULL, *fnew = NULL;
+	char name[HEXNAME_LENGTH];
+	unsigned id;
+	int ret;
+
+	if (!(fold = fopen(old, "r"))) {
+		perror(old);
+		goto fail;
+	}
+	if (!(fnew = fopen(new, "w"))) {
+		perror(new);
+		goto fail;
+	}
+
+	while ((ret = fscanf(fold, " %32s", name)) == 1) {
+		if (!is_valid_hexname(name)) {
+			fprintf(stderr, "%s: %s: Not a valid player name\n", old, name);
+			goto fail;
+		}
+
+		if ((id = register_player(name)) == NO_ID)
+			goto fail;
+		fprintf(fnew, "%u\n", id);
+	}
+
+	if (ferror(fold)) {
+		perror(old);
+		goto fail;
+	}
+	if (ferror(fnew)) {
+		perror(new);
+		goto fail;
+	}
+
+	fclose(fold);
+	fclose(fnew);
+
+	if (rename(new, old) == -1) {
+		fprintf(stderr, "rename(%s, %s): %s\n", new, old, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	return;
+
+fail:
+	if (fold)
+		fclose(fold);
+	if (fnew)
+		fclose(fnew);
+	exit(EXIT_FAILURE);
+}
+
+void upgrade_clans(void)
+{
+	static char path[PATH_MAX], old[PATH_MAX], new[PATH_MAX];
+	struct dirent *dp;
+	DIR *dir;
+
+	if (snprintf(path, PATH_MAX, "%s/clans", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!(dir = opendir(path))) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	while ((dp = readdir(dir))) {
+		if (!is_valid_hexname(dp->d_name))
+			continue;
+
+		if (snprintf(old, PATH_MAX, "%s/%s", path, dp->d_name) >= PATH_MAX ||
+		    snprintf(new, PATH_MAX, "%s/.%s.6", path, dp->d_name) >= PATH_MAX) {
+			fprintf(stderr, "%s: Too long\n", config.root);
+			exit(EXIT_FAILURE);
+		}
+
+		upgrade(old, new);
+	}
+
+	closedir(dir);
+}
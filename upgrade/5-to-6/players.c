@@ -0,0 +1,243 @@
+/*
+ * Version 5 player files are made of the clan, the current elo and
+ * rank, and the historic as text, records being in reverse order.
+ * They are all stored in the "players" directory.
+ *
+ * That directory is first moved aside, so that shards can be created
+ * without clashing with player files: the shard "00" is also the name
+ * of the player with an empty name.  Then each player is read with the
+ * version 5 format, written back with the current one in its shard,
+ * and its old file is removed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "5-to-6.h"
+#include "config.h"
+#include "player.h"
+#include "historic.h"
+#include "dict.h"
+
+struct old_record {
+	unsigned long time;
+	struct player_record data;
+};
+
+static struct old_record *records;
+static unsigned length;
+
+static struct old_record *get_old_record(unsigned i)
+{
+	if (i == length) {
+		struct old_record *tmp;
+
+		length = length ? length * 2 : 1024;
+		if (!(tmp = realloc(records, length * sizeof(*tmp)))) {
+			perror("realloc(records)");
+			exit(EXIT_FAILURE);
+		}
+		records = tmp;
+	}
+
+	return &records[i];
+}
+
+static int read_old_historic(struct historic *hist, FILE *file, const char *path)
+{
+	unsigned long epoch;
+	unsigned i, nrecords;
+	int ret;
+
+	errno = 0;
+	ret = fscanf(file, " %u records starting at %lu", &nrecords, &epoch);
+	if (ret == EOF && errno != 0)
+		return perror(path), 0;
+	else if (ret != 2)
+		return fprintf(stderr, "%s: Cannot match historic header\n", path), 0;
+
+	if (nrecords == 0)
+		return fprintf(stderr, "%s: Empty historic forbidden\n", path), 0;
+
+	for (i = 0; i < nrecords; i++) {
+		struct old_record *rec = get_old_record(i);
+
+		if (i != 0)
+			fscanf(file, " ,");
+
+		errno = 0;
+		ret = fscanf(file, " %lu %d %u",
+		             &rec->time, &rec->data.elo, &rec->data.rank);
+		if (ret == EOF && errno != 0)
+			return perror(path), 0;
+		else if (ret != 3)
+			return fprintf(stderr, "%s: Cannot match record %u\n", path, i), 0;
+
+		init_player_record(&rec->data, rec->data.elo, rec->data.rank);
+	}
+
+	create_historic(hist);
+	hist->epoch = epoch;
+
+	/* Records were written in reverse order */
+	for (i = nrecords; i > 0; i--) {
+		struct old_record *rec = &records[i - 1];
+
+		if (!append_record_at(hist, &rec->data, epoch + rec->time))
+			return 0;
+	}
+
+	return 1;
+}
+
+#define OLD_PLAYERS_DIR "players.5"
+
+static char *get_path(const char *dir, const char *name)
+{
+	static char path[PATH_MAX];
+
+	if (snprintf(path, PATH_MAX, "%s/%s/%s",
+	             config.root, dir, name) >= PATH_MAX) {
+		fprintf(stderr, "%s: Path too long\n", config.root);
+		return NULL;
+	}
+
+	return path;
+}
+
+static int read_old_player(struct player *player, char *name)
+{
+	char *path;
+	FILE *file = NULL;
+	int ret;
+
+	assert(name != NULL);
+	assert(player != NULL);
+	assert(is_valid_hexname(name));
+
+	if (!(path = get_path(OLD_PLAYERS_DIR, name)))
+		goto fail;
+
+	if (!(file = fopen(path, "r"))) {
+		perror(path);
+		goto fail;
+	}
+
+	errno = 0;
+	ret = fscanf(file, "%s %d %u",
+	             player->clan, &player->elo, &player->rank);
+	if (ret == EOF && errno != 0) {
+		perror(path);
+		goto fail;
+	} else if (ret == EOF || ret == 0) {
+		fprintf(stderr, "%s: Cannot match player clan\n", path);
+		goto fail;
+	} else if (ret == 1) {
+		fprintf(stderr, "%s: Cannot match player elo\n", path);
+		goto fail;
+	} else if (ret == 2) {
+		fprintf(stderr, "%s: Cannot match player rank\n", path);
+		goto fail;
+	}
+
+	if (!read_old_historic(&player->hist, file, path))
+		goto fail;
+
+	fclose(file);
+
+	strcpy(player->name, name);
+
+	return 1;
+
+fail:
+	if (file)
+		fclose(file);
+	return 0;
+}
+
+static void make_dir(const char *path)
+{
+	if (mkdir(path, 0777) == -1) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void move_old_players(void)
+{
+	static char old[PATH_MAX];
+	char *path;
+	unsigned shard;
+
+	if (!(path = get_path(OLD_PLAYERS_DIR, "")))
+		exit(EXIT_FAILURE);
+	strcpy(old, path);
+
+	if (!(path = get_path("players", "")))
+		exit(EXIT_FAILURE);
+	if (rename(path, old) == -1) {
+		fprintf(stderr, "rename(%s, %s): %s\n", path, old, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	make_dir(path);
+	for (shard = 0; shard < NSHARDS; shard++) {
+		if (!(path = get_path(get_shard_path(shard), "")))
+			exit(EXIT_FAILURE);
+		make_dir(path);
+	}
+}
+
+void upgrade_players(void)
+{
+	DIR *dir;
+	struct dirent *dp;
+	struct player player;
+	char *path;
+
+	move_old_players();
+
+	if (!(path = get_path(OLD_PLAYERS_DIR, "")))
+		exit(EXIT_FAILURE);
+	if (!(dir = opendir(path))) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	init_player(&player);
+	while ((dp = readdir(dir))) {
+		if (!is_valid_hexname(dp->d_name))
+			continue;
+
+		if (!read_old_player(&player, dp->d_name))
+			exit(EXIT_FAILURE);
+		if (!write_player(&player))
+			exit(EXIT_FAILURE);
+		if (register_player(player.name) == NO_ID)
+			exit(EXIT_FAILURE);
+
+		if (!(path = get_path(OLD_PLAYERS_DIR, player.name)))
+			exit(EXIT_FAILURE);
+		if (unlink(path) == -1) {
+			perror(path);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	closedir(dir);
+
+	if (!(path = get_path(OLD_PLAYERS_DIR, "")))
+		exit(EXIT_FAILURE);
+	if (rmdir(path) == -1) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+}
@@ -0,0 +1,110 @@
+/*
+ * Version 5 ranks file is made of the number of players followed by the
+ * name of each player, padded to HEXNAME_LENGTH.  Ranks are now stored
+ * in generations, as entries holding the id, the elo and the clan of
+ * each player, see ranks.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "5-to-6.h"
+#include "config.h"
+#include "player.h"
+#include "dict.h"
+#include "ranks.h"
+#include "generation.h"
+
+static struct rank_entry *read_old_ranks(const char *old, unsigned *nplayers)
+{
+	static struct player_summary ps;
+	struct rank_entry *entries = NULL;
+	char name[HEXNAME_LENGTH];
+	FILE *file;
+	unsigned i, id;
+	int ret;
+
+	if (!(file = fopen(old, "r"))) {
+		perror(old);
+		goto fail;
+	}
+
+	errno = 0;
+	ret = fscanf(file, "%u players", nplayers);
+	if (ret == EOF && errno != 0) {
+		perror(old);
+		goto fail;
+	} else if (ret != 1) {
+		fprintf(stderr, "%s: Cannot match number of players\n", old);
+		goto fail;
+	}
+
+	if (*nplayers && !(entries = calloc(*nplayers, sizeof(*entries)))) {
+		perror("calloc(entries)");
+		goto fail;
+	}
+
+	for (i = 0; i < *nplayers; i++) {
+		if (fscanf(file, " %32s", name) != 1) {
+			fprintf(stderr, "%s: Cannot match player %u\n", old, i);
+			goto fail;
+		}
+
+		if ((id = register_player(name)) == NO_ID)
+			goto fail;
+		if (read_player_summary(&ps, name) != PLAYER_FOUND) {
+			fprintf(stderr, "%s: %s: Cannot read player\n", old, name);
+			goto fail;
+		}
+
+		set_rank_entry(&entries[i], id, ps.elo, ps.clan);
+	}
+
+	fclose(file);
+	return entries;
+
+fail:
+	if (file)
+		fclose(file);
+	exit(EXIT_FAILURE);
+}
+
+void upgrade_ranks(void)
+{
+	static char old[PATH_MAX];
+	struct rank_entry *entries;
+	struct generation gen;
+	unsigned nplayers;
+	char *path;
+
+	if (snprintf(old, PATH_MAX, "%s/ranks", config.root) >= PATH_MAX) {
+		fprintf(stderr, "%s: Too long\n", config.root);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Ranks have never been computed */
+	if (access(old, F_OK) == -1 && errno == ENOENT)
+		return;
+
+	entries = read_old_ranks(old, &nplayers);
+
+	if (!create_generation(&gen))
+		exit(EXIT_FAILURE);
+	if (!(path = generation_file(&gen, "ranks")))
+		exit(EXIT_FAILURE);
+	if (!write_ranks(path, entries, nplayers))
+		exit(EXIT_FAILURE);
+	if (!publish_generation(&gen))
+		exit(EXIT_FAILURE);
+
+	if (unlink(old) == -1) {
+		perror(old);
+		exit(EXIT_FAILURE);
+	}
+
+	free(entries);
+}